@@ -28,15 +28,102 @@
 * These functions shall be implemented in the server application to define access to used device objects.
 * It is the responsibility of the user application to manage the returned value according to the result of the request.
 * If the function is not implemented in the user code, the returned value will be NOK 
+* \defgroup CRC16 CRC16 functions
+* These functions compute the CRC16 of a frame byte by byte, while it is received
 ***************************************************************************/
 
 // Include files //////////////////////////////////////////////////////////////
 #include "Modbus_RTU.h"
 #include"Arduino.h"
+#include <string.h>
+#include <stdint.h>
 
 // Macros /////////////////////////////////////////////////////////////////////
 #define GET_WORD(p)     ((((unsigned short)(*(p))& 0x0ff) << 8) | (*((p)+1)& 0x0ff))
 #define PUT_WORD(p, x)  {*(p) = ((x) >> 8) & 0x0ff; *((p)+1) = (x) & 0x0ff;}
+#define IN_TABLE(t, a, n) (((a) >= (t).Addr) && ((unsigned long)(a) + (n) <= (unsigned long)(t).Addr + (t).Nb))
+
+// Word used to pack bits on little-endian 32/64-bit targets (bits are packed byte by byte on AVR)
+#if !defined(__AVR__) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define MDB_BITWORD unsigned long
+#endif
+
+// Register blocks are converted from/to big-endian with byte swaps on little-endian 32/64-bit targets
+// (8 registers at a time with SSE2 on x86_64 or NEON on aarch64)
+#if defined(__GNUC__) && !defined(__AVR__) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define MDB_REG_SWAP
+#if defined(__x86_64__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+#endif
+
+// Registers are protected by a sequence lock when the server and the application may run in different threads
+#if defined(__GNUC__) && !defined(__AVR__)
+#define MDB_SEQLOCK
+#endif
+
+#if (MDB_CRC_SLICING != 0)
+#if (MDB_CRC_SLICING != 4) && (MDB_CRC_SLICING != 8)
+#error "MDB_CRC_SLICING shall be 0, 4 or 8"
+#endif
+
+// CRC16 (reflected polynomial 0xA001) of Nb bits shifted out of Crc
+constexpr unsigned short Modbus_CRCBits(unsigned short Crc, int Nb)
+{
+  return ((Nb == 0) ? Crc : Modbus_CRCBits((Crc & 1) ? ((Crc >> 1) ^ 0xA001) : (Crc >> 1), Nb - 1));
+}
+
+// CRC tables : Table[k][n] is the CRC16 of byte n followed by k zero bytes
+template <unsigned short... N>
+struct Modbus_CRCTable
+{
+  static const unsigned short Table[MDB_CRC_SLICING][256];
+};
+
+template <unsigned short... N>
+const unsigned short Modbus_CRCTable<N...>::Table[MDB_CRC_SLICING][256] =
+{
+  { Modbus_CRCBits(N, 8)... },
+  { Modbus_CRCBits(N, 16)... },
+  { Modbus_CRCBits(N, 24)... },
+  { Modbus_CRCBits(N, 32)... },
+#if (MDB_CRC_SLICING == 8)
+  { Modbus_CRCBits(N, 40)... },
+  { Modbus_CRCBits(N, 48)... },
+  { Modbus_CRCBits(N, 56)... },
+  { Modbus_CRCBits(N, 64)... },
+#endif
+};
+
+// Builds the list of table indexes 0..255
+template <unsigned short Count, unsigned short... N>
+struct Modbus_CRCIndex : Modbus_CRCIndex<Count - 1, Count - 1, N...> {};
+
+template <unsigned short... N>
+struct Modbus_CRCIndex<0, N...>
+{
+  typedef Modbus_CRCTable<N...> Tables;
+};
+
+static const unsigned short (&Modbus_CRC_table)[MDB_CRC_SLICING][256] = Modbus_CRCIndex<256>::Tables::Table;
+#endif
+
+// Blocks of 64 bytes or more are folded with carry-less multiplications when the CPU supports it
+#if (MDB_CRC_SLICING != 0) && defined(__GNUC__) && (defined(__x86_64__) || (defined(__aarch64__) && defined(__linux__)))
+#define MDB_CRC_CLMUL
+#define MDB_CRC_CLMUL_MIN 64      ///< Min number of bytes folded with carry-less multiplications
+#if defined(__x86_64__)
+#include <immintrin.h>
+#else
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#ifndef HWCAP_PMULL
+#define HWCAP_PMULL (1 << 4)
+#endif
+#endif
+#endif
  
 //=============================================================================
 // Public functions
@@ -55,6 +142,19 @@ Modbus_RTU::Modbus_RTU(int Param)
   // Initialize baudrate to 19200 Bauds and parity to Even
   Mdb_Baudrate = MDB_BAUD_19200;
   Mdb_Parity = MDB_PARITY_EVEN;
+
+  // No data model defined : all objects are accessed through callback functions
+  Mdb_Model.Coils.data = 0;
+  Mdb_Model.Inputs.data = 0;
+  Mdb_Model.HoldingRegisters.Nb = 0;
+  Mdb_Model.InputRegisters.Nb = 0;
+  Mdb_Model.Cache.Nb = 0;
+  Mdb_Model.Sequence = 0;
+  Mdb_Model.NoCRC16 = false;
+  Server_SetHandlers(0, 0);
+
+  // Single unit server
+  Mdb_Units = 0;
 }
 
 // Callback functions /////////////////////////////////////////////////////// 
@@ -148,6 +248,148 @@ t_status Modbus_CB_GetInputRegister(unsigned short Param1, int* Param2)
   return(Status);
 }
 
+t_status Modbus_CB_GetCoils(unsigned short Param1, int Param2, unsigned char* Param3) __attribute__((weak));
+/**************************************************************************//**
+*   \brief      This function provides the states of a block of consecutive coils
+*
+*               The default implementation calls Modbus_CB_GetCoil for each coil.
+*               It should be implemented by the application to serve a whole block at once.
+*   \ingroup    Callbacks
+*   \param[in]  Param1 Address of the first coil to be read
+*   \param[in]  Param2 Number of consecutive coils to read
+*   \param[out]  Param3 Pointer to an array which will receive the states of the coils
+*               (8 coils per byte, LSB first, unused bits of the last byte set to 0)
+*   \return     Shall be OK if operation is accepted for all coils
+*   \return     Shall be NOK if operation is not accepted
+******************************************************************************/
+t_status Modbus_CB_GetCoils(unsigned short Param1, int Param2, unsigned char* Param3)
+{
+  t_status Status = OK;
+  int Value;
+  int IndCoil;
+
+  for (IndCoil = 0; (Status == OK) && (IndCoil < Param2); IndCoil++)
+  {
+    if ((IndCoil & 7) == 0)
+    {
+      Param3[IndCoil >> 3] = 0;
+    }
+    Status = Modbus_CB_GetCoil(Param1 + IndCoil, &Value);
+    Param3[IndCoil >> 3] |= (Value != 0) << (IndCoil & 7);
+  }
+  return(Status);
+}
+
+t_status Modbus_CB_GetInputs(unsigned short Param1, int Param2, unsigned char* Param3) __attribute__((weak));
+/**************************************************************************//**
+*   \brief      This function provides the states of a block of consecutive inputs
+*
+*               The default implementation calls Modbus_CB_GetInput for each input.
+*               It should be implemented by the application to serve a whole block at once.
+*   \ingroup    Callbacks
+*   \param[in]  Param1 Address of the first input to be read
+*   \param[in]  Param2 Number of consecutive inputs to read
+*   \param[out]  Param3 Pointer to an array which will receive the states of the inputs
+*               (8 inputs per byte, LSB first, unused bits of the last byte set to 0)
+*   \return     Shall be OK if operation is accepted for all inputs
+*   \return     Shall be NOK if operation is not accepted
+******************************************************************************/
+t_status Modbus_CB_GetInputs(unsigned short Param1, int Param2, unsigned char* Param3)
+{
+  t_status Status = OK;
+  int Value;
+  int IndInput;
+
+  for (IndInput = 0; (Status == OK) && (IndInput < Param2); IndInput++)
+  {
+    if ((IndInput & 7) == 0)
+    {
+      Param3[IndInput >> 3] = 0;
+    }
+    Status = Modbus_CB_GetInput(Param1 + IndInput, &Value);
+    Param3[IndInput >> 3] |= (Value != 0) << (IndInput & 7);
+  }
+  return(Status);
+}
+
+t_status Modbus_CB_GetRegisters(unsigned short Param1, int Param2, unsigned short* Param3) __attribute__((weak));
+/**************************************************************************//**
+*   \brief      This function provides the values of a block of consecutive registers
+*
+*               The default implementation calls Modbus_CB_GetRegister for each register.
+*               It should be implemented by the application to serve a whole block at once.
+*   \ingroup    Callbacks
+*   \param[in]  Param1 Address of the first register to be read
+*   \param[in]  Param2 Number of consecutive registers to read
+*   \param[out]  Param3 Pointer to an array which will receive the values of the registers
+*   \return     Shall be OK if operation is accepted for all registers
+*   \return     Shall be NOK if operation is not accepted
+******************************************************************************/
+t_status Modbus_CB_GetRegisters(unsigned short Param1, int Param2, unsigned short* Param3)
+{
+  t_status Status = OK;
+  int Value;
+
+  while ((Status == OK) && (Param2-- > 0))
+  {
+    Status = Modbus_CB_GetRegister(Param1++, &Value);
+    *Param3++ = (unsigned short)Value;
+  }
+  return(Status);
+}
+
+t_status Modbus_CB_GetInputRegisters(unsigned short Param1, int Param2, unsigned short* Param3) __attribute__((weak));
+/**************************************************************************//**
+*   \brief      This function provides the values of a block of consecutive input registers
+*
+*               The default implementation calls Modbus_CB_GetInputRegister for each input register.
+*               It should be implemented by the application to serve a whole block at once.
+*   \ingroup    Callbacks
+*   \param[in]  Param1 Address of the first input register to be read
+*   \param[in]  Param2 Number of consecutive input registers to read
+*   \param[out]  Param3 Pointer to an array which will receive the values of the input registers
+*   \return     Shall be OK if operation is accepted for all input registers
+*   \return     Shall be NOK if operation is not accepted
+******************************************************************************/
+t_status Modbus_CB_GetInputRegisters(unsigned short Param1, int Param2, unsigned short* Param3)
+{
+  t_status Status = OK;
+  int Value;
+
+  while ((Status == OK) && (Param2-- > 0))
+  {
+    Status = Modbus_CB_GetInputRegister(Param1++, &Value);
+    *Param3++ = (unsigned short)Value;
+  }
+  return(Status);
+}
+
+t_status Modbus_CB_SetRegisters(unsigned short Param1, int Param2, unsigned short* Param3) __attribute__((weak));
+/**************************************************************************//**
+*   \brief      This function writes values in a block of consecutive registers
+*
+*               The default implementation calls Modbus_CB_SetRegister for each register.
+*               It should be implemented by the application to write a whole block at once.
+*   \ingroup    Callbacks
+*   \param[in]  Param1 Address of the first register to write
+*   \param[in]  Param2 Number of consecutive registers to write
+*   \param[in]  Param3 Pointer to an array which contains the values to write
+*   \return     Shall be OK if operation is accepted for all registers
+*   \return     Shall be NOK if operation is not accepted
+******************************************************************************/
+t_status Modbus_CB_SetRegisters(unsigned short Param1, int Param2, unsigned short* Param3)
+{
+  t_status Status = OK;
+  int Value;
+
+  while ((Status == OK) && (Param2-- > 0))
+  {
+    Value = *Param3++;
+    Status = Modbus_CB_SetRegister(Param1++, &Value);
+  }
+  return(Status);
+}
+
 t_status Modbus_CB_GetException(int* Param1) __attribute__((weak));
 /**************************************************************************//**
 *   \brief      This function provides the value of the Modbus exception register
@@ -162,6 +404,53 @@ t_status Modbus_CB_GetException(int* Param1)
   return(Status);
 }
 
+// Default handler table : objects are accessed through the callback functions
+static t_status Modbus_DefaultGetCoils(void* Context, unsigned short Addr, int Nb, unsigned char* Values)
+{
+  return (Modbus_CB_GetCoils(Addr, Nb, Values));
+}
+
+static t_status Modbus_DefaultSetCoil(void* Context, unsigned short Addr, int* Value)
+{
+  return (Modbus_CB_SetCoil(Addr, Value));
+}
+
+static t_status Modbus_DefaultGetInputs(void* Context, unsigned short Addr, int Nb, unsigned char* Values)
+{
+  return (Modbus_CB_GetInputs(Addr, Nb, Values));
+}
+
+static t_status Modbus_DefaultGetRegisters(void* Context, unsigned short Addr, int Nb, unsigned short* Values)
+{
+  return (Modbus_CB_GetRegisters(Addr, Nb, Values));
+}
+
+static t_status Modbus_DefaultSetRegisters(void* Context, unsigned short Addr, int Nb, unsigned short* Values)
+{
+  return (Modbus_CB_SetRegisters(Addr, Nb, Values));
+}
+
+static t_status Modbus_DefaultGetInputRegisters(void* Context, unsigned short Addr, int Nb, unsigned short* Values)
+{
+  return (Modbus_CB_GetInputRegisters(Addr, Nb, Values));
+}
+
+static t_status Modbus_DefaultGetException(void* Context, int* Value)
+{
+  return (Modbus_CB_GetException(Value));
+}
+
+static const Modbus_Handlers Modbus_DefaultHandlers =
+{
+  Modbus_DefaultGetCoils,
+  Modbus_DefaultSetCoil,
+  Modbus_DefaultGetInputs,
+  Modbus_DefaultGetRegisters,
+  Modbus_DefaultSetRegisters,
+  Modbus_DefaultGetInputRegisters,
+  Modbus_DefaultGetException
+};
+
 // Class Interface : Device ///////////////////////////////////////////////////
 /**************************************************************************//**
 *   \brief      This function sets the type of Modbus RTU instance : Server or Client
@@ -211,11 +500,11 @@ t_status Modbus_RTU::SetBaudrate(t_baud Param)
   t_status Status;
 
   // Check if Param value is part of the baudrate list
-  if ((Param != MDB_BAUD_1200) || 
-      (Param != MDB_BAUD_2400) || 
-      (Param != MDB_BAUD_4800) || 
-      (Param != MDB_BAUD_9600) || 
-      (Param != MDB_BAUD_19200)|| 
+  if ((Param != MDB_BAUD_1200) && 
+      (Param != MDB_BAUD_2400) && 
+      (Param != MDB_BAUD_4800) && 
+      (Param != MDB_BAUD_9600) && 
+      (Param != MDB_BAUD_19200)&& 
       (Param != MDB_BAUD_38400))
   {
     Status = NOK;
@@ -253,8 +542,8 @@ t_status Modbus_RTU::SetParity(t_parity Param)
   t_status Status;
 
   // Check if Param value is part of the Parity list
-  if ((Param != MDB_PARITY_EVEN) || 
-      (Param != MDB_PARITY_ODD) || 
+  if ((Param != MDB_PARITY_EVEN) && 
+      (Param != MDB_PARITY_ODD) && 
       (Param != MDB_PARITY_NONE))
   {
     Status = NOK;
@@ -288,7 +577,7 @@ t_status Modbus_RTU::GetParity(t_parity* Param)
 *   \return     OK if CRC16 is available
 *   \return     NOK if CRC16 is not available (i.e. msg is empty)
 ******************************************************************************/
-t_status Modbus_RTU::GetCRC16(Modbus_Frame* msg, unsigned short* Value)
+t_status Modbus_RTU::GetCRC16(Modbus_View* msg, unsigned short* Value)
 {
   return (Modbus_CRC16 (msg, Value));
 }
@@ -332,6 +621,67 @@ t_status Modbus_RTU::GetFrameTimeout(unsigned long* Value)
   return (Status);
 }
 
+/**************************************************************************//**
+*   \brief      This function provides the maximum silence between 2 characters of a frame 
+*               (should be equivalent to 1,5 char)
+*   \ingroup Device  
+*   \param[out] Value Pointer to a variable which will receive the time in s
+*   \return     OK if time is available
+*   \return     NOK if time is not available
+******************************************************************************/
+t_status Modbus_RTU::GetCharTimeout(unsigned long* Value)
+{
+  t_status Status = OK;
+
+  // Timeout value (second)= (1,5 * 11) / Baudrate (see GetFrameTimeout)
+  *Value = 0;
+  switch (Mdb_Baudrate)
+  {
+    case MDB_BAUD_1200:
+    case MDB_BAUD_2400:
+    case MDB_BAUD_4800:
+    case MDB_BAUD_9600:
+    case MDB_BAUD_19200:
+    case MDB_BAUD_38400:
+        *Value = (unsigned long)(1500000 * 11 / Mdb_Baudrate);
+        break;
+    default:
+        Status = NOK;
+        break;
+  }
+  return (Status);
+}
+
+/**************************************************************************//**
+*   \brief      This function initializes a receiver with the timings of the device
+*               (baudrate and parity)
+*
+*   Bytes received from the network are given to the receiver with Modbus_ReceiverPut.
+*   Frames are assembled in Buffer, so a frame received by a server can be processed 
+*   in place by Server_Update(&Receiver->Frame, &Receiver->Context) when Size is 
+*   MDB_MSG_LENGTH_MAX at least.
+*   \ingroup Device  
+*   \param[out] Receiver Pointer to the receiver
+*   \param[in]  Buffer Pointer to the receive buffer
+*   \param[in]  Size Size of the receive buffer
+*   \return     OK if the receiver has been initialized
+*   \return     NOK if the timings are not available (unsupported baudrate)
+******************************************************************************/
+t_status Modbus_RTU::ReceiverInit(Modbus_Receiver* Receiver, char* Buffer, unsigned short Size)
+{
+  if ((GetCharTimeout(&Receiver->CharTimeout) == NOK) || (GetFrameTimeout(&Receiver->FrameTimeout) == NOK))
+  {
+    return (NOK);
+  }
+  Receiver->CharTime = (unsigned long)(1000000 * 11 / Mdb_Baudrate);
+  Receiver->Frame.data = Buffer;
+  Receiver->Frame.size = Size;
+  Receiver->LastTime = 0;
+  Receiver->Errors = 0;
+  Modbus_ReceiverRelease(Receiver);
+  return (OK);
+}
+
 // Class Interface : Server ////////////////////////////////////////////////////
 /**************************************************************************//**
 *   \brief      This function sets the Modbus server address for the device 
@@ -389,93 +739,80 @@ t_status Modbus_RTU::Server_GetAddress(int* Param)
 *               This function shall be called in the server main loop 
 *               after receiving a Modbus frame to generate the response frame
 *   \ingroup Server  
-*   \param[in,out]  msg Pointer to a message that contains the Modbus frame sent by the CLient 
+*   \param[in,out]  msg Pointer to a view of the buffer that contains the Modbus frame sent by the CLient 
 *                 and will receive the response frame to be returned to the Client
+*                 (the buffer size shall be MDB_MSG_LENGTH_MAX at least)
 *   \return     OK if a response frame should be sent on the bus
-*   \return     NOK if no response frame should be sent on the bus
+*   \return     NOK if no response frame should be sent on the bus (or the buffer is too small)
 ******************************************************************************/
-t_status Modbus_RTU::Server_Update(Modbus_Frame* msg)
+t_status Modbus_RTU::Server_Update(Modbus_View* msg)
+{
+  return (Server_Update(msg, 0));
+}
+
+/**************************************************************************//**
+*   \brief      This function serves Modbus frames sent by the Client, 
+*               whose CRC16 has been computed while they were received
+*
+*               The CRC16 context shall be initialized (Modbus_CRC16Init) at the start of the frame
+*               and updated (Modbus_CRC16Update) with each received byte, CRC16 included :
+*               the CRC16 of the frame is then checked without reading the frame again.
+*   \ingroup Server  
+*   \param[in,out]  msg Pointer to a view of the buffer that contains the Modbus frame sent by the CLient 
+*                 and will receive the response frame to be returned to the Client
+*                 (the buffer size shall be MDB_MSG_LENGTH_MAX at least)
+*   \param[in]  Context Pointer to the CRC16 context of the received frame
+*               or 0 to compute the CRC16 of the frame
+*   \return     OK if a response frame should be sent on the bus
+*   \return     NOK if no response frame should be sent on the bus (or the buffer is too small)
+******************************************************************************/
+t_status Modbus_RTU::Server_Update(Modbus_View* msg, Modbus_CRC16Context* Context)
 {
   t_status Status;
-  unsigned short CRC16, crc1;
+  Modbus_CRC16Context FrameContext;
+  Modbus_RTU* Unit = 0;
+  Modbus_Model* Model = &Mdb_Model;
   
   // Wait for a message
   Mdb_FrameReceived++;
+
+  // The response is built in place : the buffer shall be able to hold any response
+  if ((msg->size < MDB_MSG_LENGTH_MAX) || (msg->length > msg->size))
+  {
+    return (NOK);
+  }
   
+  // Find the unit which serves the address, if any
+  if (Mdb_Units != 0)
+  {
+    Unit = Mdb_Units[(unsigned char)msg->data[0]];
+    if (Unit != 0)
+    {
+      Model = &Unit->Mdb_Model;
+    }
+  }
+
   // check if address is correct
-  if ((msg->data[0] == (char)MDB_ADDRESS_BROADCAST) ||
+  if ((Unit != 0) ||
+      (msg->data[0] == (char)MDB_ADDRESS_BROADCAST) ||
       (msg->data[0]==(char)MDB_ADDRESS_MONODROP) ||
       (msg->data[0]==(char)Mdb_Address))
   {
     // Frame is for this server
     Mdb_FrameServerReceived++;
     
-    // Check frame CRC
-    CRC16 = GET_WORD(msg->data + msg->length-2);
-    if (Modbus_CRC16(msg, &crc1))
+    // Check frame CRC : the CRC16 of a frame including its CRC16 is 0
+    if (Context == 0)
     {
-      if (crc1 != CRC16)
-      {
-        return(NOK);
-      }
+      Modbus_CRC16Init(&FrameContext);
+      Modbus_CRC16UpdateBlock(&FrameContext, msg->data, msg->length);
+      Context = &FrameContext;
     }
-      // Check function code
-      switch (msg->data[1])
-      {
-#if defined(MDB_FUNCTIONCODE_01)
-        case MDB_FC01: //Read Coils
-            Modbus_ReadCoils (msg);
-            break;
-#endif
-#if defined(MDB_FUNCTIONCODE_02)
-        case MDB_FC02: //Read Discrete Inputs
-            Modbus_ReadDiscreteInputs (msg);
-            break;
-#endif
-#if defined(MDB_FUNCTIONCODE_03)
-        case MDB_FC03: //Read Holding Registers
-            Modbus_ReadHoldingRegisters (msg);
-            break;
-#endif
-#if defined(MDB_FUNCTIONCODE_04)
-        case MDB_FC04: //Read Input Registers
-            Modbus_ReadInputRegisters (msg);
-            break;
-#endif
-#if defined(MDB_FUNCTIONCODE_05)
-        case MDB_FC05: //Write Single coil
-            Modbus_WriteSingleCoil (msg);
-            break;
-#endif
-#if defined(MDB_FUNCTIONCODE_06)
-        case MDB_FC06: //Preset Single Register
-            Modbus_PresetSingleRegister (msg);
-            break;
-#endif
-#if defined(MDB_FUNCTIONCODE_07)
-        case MDB_FC07: //Read Exception Status
-            Modbus_ReadExceptionStatus (msg);
-            break;
-#endif
-#if defined(MDB_FUNCTIONCODE_08)
-        case MDB_FC08: //Read Exception Status
-            Modbus_ReadDiagnostic (msg);
-            break;
-#endif
-#if defined(MDB_FUNCTIONCODE_16)
-        case MDB_FC16: //Preset Multiple Registers
-            Modbus_PresetMultipleRegisters (msg);
-            break;
-#endif
-#if defined(MDB_FUNCTIONCODE_23)
-        case MDB_FC23: //Read/Write Multiple Registers
-            Modbus_ReadWriteMultipleRegisters (msg);
-            break;
-#endif
-        default:
-            Modbus_Exception(MDB_EXCEPTION_ILLEGAL_FUNCTION, msg);
-            break;
-      }
+    if (Modbus_CRC16Final(Context) != 0)
+    {
+      return(NOK);
+    }
+    Modbus_ServeRequest(msg, Model);
       Status = OK;
   }
   else
@@ -487,341 +824,533 @@ t_status Modbus_RTU::Server_Update(Modbus_Frame* msg)
   return (Status);
 }
 
-// CLass Interface : client ///////////////////////////////////////////////////
-#if defined(MDB_FUNCTIONCODE_01)
 /**************************************************************************//**
-*   \brief      This function builds a Read Coils request 
-*   \ingroup client  
-*   \param[in]  ServerAddr Node address of the targeted Modbus server
-*   \param[in]  Addr Address of the first coil to be read
-*   \param[in]  Nb Number of consecutive coils to read
-*   \param[out] msg Pointer to a message which will receive the request to be sent on the network
-*   \return     OK if the request frame has been successfuly generated
-*   \return     NOK if the request frame has not been generated (i.e. CRC16 error, or device type is  a Modbus server)
+*   \brief      This function serves Modbus TCP frames sent by the Client 
+*
+*               The request is served by the same handlers as Server_Update, without 
+*               any CRC16 check (TCP ensures the integrity of the frame) and without 
+*               computing the CRC16 of the response, which is not cached. The response 
+*               keeps the MBAP header of the request (transaction identifier). 
+*               The unit identifier selects the unit which serves the request (Server_SetUnits);
+*               the device answers the unit identifiers MDB_TCP_UNIT_DIRECT, 0 and its 
+*               own address, other units get an exception response.
+*   \ingroup Server  
+*   \param[in,out]  msg Pointer to a view of the buffer that contains the Modbus TCP frame 
+*                 (MBAP header first) sent by the Client and will receive the response frame
+*                 (the buffer size shall be MDB_TCP_LENGTH_MAX at least)
+*   \return     OK if a response frame should be sent to the Client
+*   \return     NOK if the frame is not a Modbus TCP frame (or the buffer is too small)
 ******************************************************************************/
-t_status Modbus_RTU::Client_ReadCoils(int ServerAddr, unsigned short Addr, int Nb, Modbus_Frame* msg)
+t_status Modbus_RTU::Server_UpdateTCP(Modbus_View* msg)
 {
-  t_status Status = OK;
-  unsigned short CRC16 = 0;
-  
-  if (Mdb_Type == MDB_CLIENT)
+  Modbus_View Pdu;
+  Modbus_RTU* Unit = 0;
+  Modbus_Model* Model = &Mdb_Model;
+  unsigned short Length;
+  t_status Status;
+
+  Mdb_FrameReceived++;
+
+  // The response is built in place
+  if ((msg->size < MDB_TCP_LENGTH_MAX) || (msg->length > msg->size) || (msg->length < MDB_TCP_HEADER_LENGTH + 2))
   {
-    //Build the request
-    msg->length = 8;
-    msg->data[0] = ServerAddr;
-    msg->data[1] = MDB_FC01;
-    PUT_WORD(&msg->data[2], Addr);
-    PUT_WORD(&msg->data[4], Nb);
-    
-    // Add CRC16
-    Status = Modbus_CRC16 (msg, &CRC16);
-    PUT_WORD(&msg->data[msg->length-2], CRC16);
+    return (NOK);
+  }
+  Length = GET_WORD(&msg->data[4]);
+  if ((GET_WORD(&msg->data[2]) != 0) || 
+      (Length < 2) || 
+      (Length > MDB_TCP_LENGTH_MAX - MDB_TCP_HEADER_LENGTH) || 
+      (MDB_TCP_HEADER_LENGTH + Length != msg->length))
+  {
+    return (NOK);
+  }
+
+  // Unit identifier and PDU, seen as a frame whose CRC16 is neither read nor written
+  Pdu.data = msg->data + MDB_TCP_HEADER_LENGTH;
+  Pdu.length = Length + 2;
+  Pdu.size = MDB_MSG_LENGTH_MAX;
+
+  // Find the unit which serves the identifier, if any
+  if (Mdb_Units != 0)
+  {
+    Unit = Mdb_Units[(unsigned char)Pdu.data[0]];
+    if (Unit != 0)
+    {
+      Model = &Unit->Mdb_Model;
+    }
+  }
+
+  Mdb_FrameServerReceived++;
+  if ((Unit == 0) &&
+      (Pdu.data[0] != (char)MDB_TCP_UNIT_DIRECT) &&
+      (Pdu.data[0] != (char)MDB_ADDRESS_BROADCAST) &&
+      (Pdu.data[0] != (char)Mdb_Address))
+  {
+    Modbus_Exception(MDB_EXCEPTION_GATEWAY_PATH_UNAVAILABLE, &Pdu);
   }
   else
   {
-    Status = NOK;
+    Model->NoCRC16 = true;
+    Status = Modbus_ServeRequest(&Pdu, Model);
+    Model->NoCRC16 = false;
+    if (Status == NOK)
+    {
+      // Wrong length for the function code : no CRC16 error can explain it on TCP
+      Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_VALUE, &Pdu);
+    }
   }
-  return(Status);
+
+  // MBAP length : unit identifier and PDU of the response
+  Length = Pdu.length - 2;
+  PUT_WORD(&msg->data[4], Length);
+  msg->length = MDB_TCP_HEADER_LENGTH + Length;
+  return (OK);
 }
-#endif
 
-#if defined(MDB_FUNCTIONCODE_02)
 /**************************************************************************//**
-*   \brief      This function builds a Read Discrete Inputs request 
-*   \ingroup client  
-*   \param[in]  ServerAddr Node address of the targeted Modbus server
-*   \param[in]  Addr Address of the first input to be read
-*   \param[in]  Nb Number of consecutive inputs to read
-*   \param[out] msg Pointer to a message which will receive the request to be sent on the network
-*   \return     OK if the request frame has been successfuly generated
-*   \return     NOK if the request frame has not been generated (i.e. CRC16 error, or device type is  a Modbus server)
+*   \brief      This function defines the table which stores the coils of the server
+*
+*               Coils of the table are then read and written directly by the server
+*               without calling Modbus_CB_GetCoil and Modbus_CB_SetCoil
+*   \ingroup Server  
+*   \param[in]  Table Pointer to the coil states (8 coils per byte, LSB first) 
+*               or 0 to access the coils through callback functions
+*   \param[in]  Addr Address of the first coil of the table
+*   \param[in]  Nb Number of coils in the table
+*   \return     OK if the table has been defined
+*   \return     NOK if the table is out of the address range or the device is not a server
 ******************************************************************************/
-t_status Modbus_RTU::Client_ReadDiscreteInputs(int ServerAddr, unsigned short Addr, int Nb, Modbus_Frame* msg)
+t_status Modbus_RTU::Server_SetCoils(unsigned char* Table, unsigned short Addr, unsigned short Nb)
 {
-  t_status Status = OK;
-  unsigned short CRC16 = 0;
-  
-  if (Mdb_Type == MDB_CLIENT)
+  t_status Status;
+
+  if ((Mdb_Type == MDB_CLIENT) ||
+      ((unsigned long)Addr + Nb > 0x10000))
   {
-    //Build the request
-    msg->length = 8;
-    msg->data[0] = ServerAddr;
-    msg->data[1] = MDB_FC02;
-    PUT_WORD(&msg->data[2], Addr);
-    PUT_WORD(&msg->data[4], Nb);
-    
-    // Add CRC16
-    Status = Modbus_CRC16 (msg, &CRC16);
-    PUT_WORD(&msg->data[msg->length-2], CRC16);
+    Status = NOK;
   }
   else
   {
-    Status = NOK;
+    Mdb_Model.Coils.Addr = Addr;
+    Mdb_Model.Coils.Nb = Nb;
+    Mdb_Model.Coils.data = Table;
+    Status = OK;
   }
-  return(Status);
+  return (Status);
 }
-#endif
 
-#if defined(MDB_FUNCTIONCODE_03)
 /**************************************************************************//**
-*   \brief      This function builds a Read Holding Registers request 
-*   \ingroup client  
-*   \param[in]  ServerAddr Node address of the targeted server
-*   \param[in]  Addr Address of the first register to be read
-*   \param[in]  Nb Number of consecutive registers to read
-*   \param[out] msg Pointer to a message which will receive the request to be sent on the network
-*   \return     OK if the request frame has been successfuly generated
-*   \return     NOK if the request frame has not been generated (i.e. CRC16 error, or device type is  a Modbus server)
+*   \brief      This function defines the table which stores the discrete inputs of the server
+*
+*               Inputs of the table are then read directly by the server
+*               without calling Modbus_CB_GetInput
+*   \ingroup Server  
+*   \param[in]  Table Pointer to the input states (8 inputs per byte, LSB first) 
+*               or 0 to access the inputs through callback functions
+*   \param[in]  Addr Address of the first input of the table
+*   \param[in]  Nb Number of inputs in the table
+*   \return     OK if the table has been defined
+*   \return     NOK if the table is out of the address range or the device is not a server
 ******************************************************************************/
-t_status Modbus_RTU::Client_ReadHoldingRegisters(int ServerAddr, unsigned short Addr, int Nb, Modbus_Frame* msg)
+t_status Modbus_RTU::Server_SetInputs(unsigned char* Table, unsigned short Addr, unsigned short Nb)
 {
-  t_status Status = OK;
-  unsigned short CRC16 = 0;
-  
-  if (Mdb_Type == MDB_CLIENT)
+  t_status Status;
+
+  if ((Mdb_Type == MDB_CLIENT) ||
+      ((unsigned long)Addr + Nb > 0x10000))
   {
-    //Build the request
-    msg->length = 8;
-    msg->data[0] = ServerAddr;
-    msg->data[1] = MDB_FC03;
-    PUT_WORD(&msg->data[2], Addr);
-    PUT_WORD(&msg->data[4], Nb);
-    
-    // Add CRC16
-    Status = Modbus_CRC16 (msg, &CRC16);
-    PUT_WORD(&msg->data[msg->length-2], CRC16);
+    Status = NOK;
   }
   else
   {
-    Status = NOK;
+    Mdb_Model.Inputs.Addr = Addr;
+    Mdb_Model.Inputs.Nb = Nb;
+    Mdb_Model.Inputs.data = Table;
+    Status = OK;
   }
-  return(Status);
+  return (Status);
 }
-#endif
 
-#if defined(MDB_FUNCTIONCODE_04)
 /**************************************************************************//**
-*   \brief      This function builds a Read Input Registers request 
-*   \ingroup client  
-*   \param[in]  ServerAddr Node address of the targeted Modbus server
-*   \param[in]  Addr Address of the first input register to be read
-*   \param[in]  Nb Number of consecutive input registers to read
-*   \param[out] msg Pointer to a message which will receive the request to be sent on the network
-*   \return     OK if the request frame has been successfuly generated
-*   \return     NOK if the request frame has not been generated (i.e. CRC16 error, or device type is a Modbus server)
+*   \brief      This function defines the table which stores the holding registers of the server
+*
+*               Registers of the table are then read and written directly by the server
+*               without calling Modbus_CB_GetRegister(s) and Modbus_CB_SetRegister(s)
+*   \ingroup Server  
+*   \param[in]  Table Pointer to the register values 
+*               or 0 to access the registers through callback functions
+*   \param[in]  Addr Address of the first register of the table
+*   \param[in]  Nb Number of registers in the table
+*   \return     OK if the table has been defined
+*   \return     NOK if the table is out of the address range or the device is not a server
 ******************************************************************************/
-t_status Modbus_RTU::Client_ReadInputRegisters(int ServerAddr, unsigned short Addr, int Nb, Modbus_Frame* msg)
+t_status Modbus_RTU::Server_SetHoldingRegisters(unsigned short* Table, unsigned short Addr, unsigned short Nb)
 {
-  t_status Status = OK;
-  unsigned short CRC16 = 0;
-  
-  if (Mdb_Type == MDB_CLIENT)
+  t_status Status;
+
+  if ((Mdb_Type == MDB_CLIENT) ||
+      ((unsigned long)Addr + Nb > 0x10000))
   {
-    //Build the request
-    msg->length = 8;
-    msg->data[0] = ServerAddr;
-    msg->data[1] = MDB_FC04;
-    PUT_WORD(&msg->data[2], Addr);
-    PUT_WORD(&msg->data[4], Nb);
-    
-    // Add CRC16
-    Modbus_CRC16 (msg, &CRC16);
-    PUT_WORD(&msg->data[msg->length-2], CRC16);
+    Status = NOK;
   }
   else
   {
-    Status = NOK;
-  } 
-  return(Status);
+    // The table is handled as a register map with a single range
+    Mdb_Model.HoldingTable.Addr = Addr;
+    Mdb_Model.HoldingTable.Nb = Nb;
+    Mdb_Model.HoldingTable.data = Table;
+    Mdb_Model.HoldingTable.Get = 0;
+    Mdb_Model.HoldingTable.Set = 0;
+    Mdb_Model.HoldingRegisters.Ranges = &Mdb_Model.HoldingTable;
+    Mdb_Model.HoldingRegisters.Nb = ((Table != 0) && (Nb != 0)) ? 1 : 0;
+    Mdb_Model.HoldingRegisters.Last = 0;
+    Modbus_CacheClear(&Mdb_Model.Cache);
+    Status = OK;
+  }
+  return (Status);
 }
-#endif
 
-#if defined(MDB_FUNCTIONCODE_05)
 /**************************************************************************//**
-*   \brief      This function builds a Write Single Coil request 
-*   \ingroup client  
-*   \param[in]  ServerAddr Node address of the targeted Modbus server
-*   \param[in]  Addr Address of the coil to write
-*   \param[in]  Data Desired state of the coil
-*   \param[out] msg Pointer to a message which will receive the request to be sent on the network
-*   \return     OK if the request frame has been successfuly generated
-*   \return     NOK if the request frame has not been generated (i.e. CRC16 error, or device type is a Modbus server)
+*   \brief      This function defines the table which stores the input registers of the server
+*
+*               Input registers of the table are then read directly by the server
+*               without calling Modbus_CB_GetInputRegister(s)
+*   \ingroup Server  
+*   \param[in]  Table Pointer to the input register values 
+*               or 0 to access the input registers through callback functions
+*   \param[in]  Addr Address of the first input register of the table
+*   \param[in]  Nb Number of input registers in the table
+*   \return     OK if the table has been defined
+*   \return     NOK if the table is out of the address range or the device is not a server
 ******************************************************************************/
-t_status Modbus_RTU::Client_WriteSingleCoil(int ServerAddr, unsigned short Addr, int Data, Modbus_Frame* msg)
+t_status Modbus_RTU::Server_SetInputRegisters(unsigned short* Table, unsigned short Addr, unsigned short Nb)
 {
-  t_status Status = OK;
-  unsigned short CRC16 = 0;
-  
-  if (Mdb_Type == MDB_CLIENT)
+  t_status Status;
+
+  if ((Mdb_Type == MDB_CLIENT) ||
+      ((unsigned long)Addr + Nb > 0x10000))
   {
-    //Build the request
-    msg->length = 8;
-    msg->data[0] = ServerAddr;
-    msg->data[1] = MDB_FC05;
-    if (Data != 0)
-      Data = 0xFF;
-    PUT_WORD(&msg->data[2], Addr);
-    PUT_WORD(&msg->data[4], Data);
-    
-    // Add CRC16
-    Status = Modbus_CRC16 (msg, &CRC16);
-    PUT_WORD(&msg->data[msg->length-2], CRC16);
+    Status = NOK;
   }
   else
   {
-    Status = NOK;
+    // The table is handled as a register map with a single range
+    Mdb_Model.InputTable.Addr = Addr;
+    Mdb_Model.InputTable.Nb = Nb;
+    Mdb_Model.InputTable.data = Table;
+    Mdb_Model.InputTable.Get = 0;
+    Mdb_Model.InputTable.Set = 0;
+    Mdb_Model.InputRegisters.Ranges = &Mdb_Model.InputTable;
+    Mdb_Model.InputRegisters.Nb = ((Table != 0) && (Nb != 0)) ? 1 : 0;
+    Mdb_Model.InputRegisters.Last = 0;
+    Modbus_CacheClear(&Mdb_Model.Cache);
+    Status = OK;
   }
-  return(Status);
+  return (Status);
 }
-#endif
 
-#if defined(MDB_FUNCTIONCODE_06)
 /**************************************************************************//**
-*   \brief      This function builds a Preset Single Register request 
-*   \ingroup client  
-*   \param[in]  ServerAddr Node address of the targeted Modbus server
-*   \param[in]  Addr Address of the register to write
-*   \param[in]  Data Desired value of the register
-*   \param[out] msg Pointer to a message which will receive the request to be sent on the network
-*   \return     OK if the request frame has been successfuly generated
-*   \return     NOK if the request frame has not been generated (i.e. CRC16 error, or device type is a Modbus server)
+*   \brief      This function defines the register map which stores the holding registers of the server
+*
+*               The map is a list of ranges sorted by increasing address, which allows
+*               the server to expose scattered blocks of registers. Each range is either 
+*               stored in memory or served by its own handler functions, which receive the 
+*               context pointer given to Server_SetHandlers.
+*               Registers which don't belong to any range are answered with an exception.
+*   \ingroup Server  
+*   \param[in]  Ranges Pointer to the list of ranges 
+*               or 0 to access the registers through callback functions
+*   \param[in]  Nb Number of ranges in the list
+*   \return     OK if the map has been defined
+*   \return     NOK if ranges are not sorted, overlap or the device is not a server
 ******************************************************************************/
-t_status Modbus_RTU::Client_PresetSingleRegister(int ServerAddr, unsigned short Addr, int Data, Modbus_Frame* msg)
+t_status Modbus_RTU::Server_SetHoldingRegisterMap(const Modbus_Range* Ranges, unsigned short Nb)
 {
-  t_status Status = OK;
-  unsigned short CRC16 = 0;
-  
-  if (Mdb_Type == MDB_CLIENT)
+  t_status Status;
+
+  if ((Mdb_Type == MDB_CLIENT) || !Modbus_CheckMap(Ranges, Nb))
   {
-    //Build the request
-    msg->length = 8;
-    msg->data[0] = ServerAddr;
-    msg->data[1] = MDB_FC06;
-    PUT_WORD(&msg->data[2], Addr);
-    PUT_WORD(&msg->data[4], Data);
-    
-    // Add CRC16
-    Status = Modbus_CRC16 (msg, &CRC16);
-    PUT_WORD(&msg->data[msg->length-2], CRC16);
+    Status = NOK;
   }
   else
   {
-    Status = NOK;
+    Mdb_Model.HoldingRegisters.Ranges = Ranges;
+    Mdb_Model.HoldingRegisters.Nb = (Ranges != 0) ? Nb : 0;
+    Mdb_Model.HoldingRegisters.Last = 0;
+    Modbus_CacheClear(&Mdb_Model.Cache);
+    Status = OK;
   }
-  return(Status);
+  return (Status);
 }
-#endif
 
-#if defined(MDB_FUNCTIONCODE_07)
 /**************************************************************************//**
-*   \brief      This function builds a Read Exception request 
-*   \ingroup client  
-*   \param[in]  ServerAddr Node address of the targeted Modbus server
-*   \param[out] msg Pointer to a message which will receive the request to be sent on the network
-*   \return     OK if the request frame has been successfuly generated
-*   \return     NOK if the request frame has not been generated (i.e. CRC16 error, or device type is  a Modbus server)
+*   \brief      This function defines the register map which stores the input registers of the server
+*
+*               The map is a list of ranges sorted by increasing address, which allows
+*               the server to expose scattered blocks of input registers. Each range is either 
+*               stored in memory or served by its own handler function, which receives the 
+*               context pointer given to Server_SetHandlers.
+*               Input registers which don't belong to any range are answered with an exception.
+*   \ingroup Server  
+*   \param[in]  Ranges Pointer to the list of ranges 
+*               or 0 to access the input registers through callback functions
+*   \param[in]  Nb Number of ranges in the list
+*   \return     OK if the map has been defined
+*   \return     NOK if ranges are not sorted, overlap or the device is not a server
 ******************************************************************************/
-t_status Modbus_RTU::Client_ReadException(int ServerAddr, Modbus_Frame* msg)
+t_status Modbus_RTU::Server_SetInputRegisterMap(const Modbus_Range* Ranges, unsigned short Nb)
 {
-  t_status Status = OK;
-  unsigned short CRC16 = 0;
-  
-  if (Mdb_Type == MDB_CLIENT)
+  t_status Status;
+
+  if ((Mdb_Type == MDB_CLIENT) || !Modbus_CheckMap(Ranges, Nb))
   {
-    //Build the request
-    msg->length = 4;
-    msg->data[0] = ServerAddr;
-    msg->data[1] = MDB_FC07;
-    
-    // Add CRC16
-    Status = Modbus_CRC16 (msg, &CRC16);
-    PUT_WORD(&msg->data[msg->length-2], CRC16);
+    Status = NOK;
   }
   else
   {
-    Status = NOK;
+    Mdb_Model.InputRegisters.Ranges = Ranges;
+    Mdb_Model.InputRegisters.Nb = (Ranges != 0) ? Nb : 0;
+    Mdb_Model.InputRegisters.Last = 0;
+    Modbus_CacheClear(&Mdb_Model.Cache);
+    Status = OK;
   }
-  return(Status); 
+  return (Status);
 }
-#endif
 
-#if defined(MDB_FUNCTIONCODE_08)
 /**************************************************************************//**
-*   \brief      This function builds a Read Diagnostic request 
-*   \ingroup client  
-*   \param[in]  ServerAddr Node address of the targeted Modbus server
-*   \param[in]  DiagType Select which diagnostic value is requested
-*   \param[in]  Data Additionnal information (depending on DiagType)
-*   \param[out] msg Pointer to a message which will receive the request to be sent on the network
-*   \return     OK if the request frame has been successfuly generated
-*   \return     NOK if the request frame has not been generated (i.e. CRC16 error, or device type is  a Modbus server)
+*   \brief      This function defines the handlers which serve the objects of the server
+*
+*               Objects which are not stored in the data model (Server_SetCoils, 
+*               Server_SetHoldingRegisterMap...) are read and written through these handlers
+*               instead of the Modbus_CB_xxx callback functions, so that each instance 
+*               can serve its own objects. A handler set to 0 answers with an exception.
+*   \ingroup Server  
+*   \param[in]  Handlers Pointer to the handler table 
+*               or 0 to access the objects through callback functions
+*   \param[in]  Context Pointer passed to each handler and to the handlers of the register map ranges
+*   \return     OK if the handlers have been defined
+*   \return     NOK if the device is not a server
 ******************************************************************************/
-t_status Modbus_RTU::Client_ReadDiagnostic(int ServerAddr, t_diagtype DiagType, int Data, Modbus_Frame* msg)
+t_status Modbus_RTU::Server_SetHandlers(const Modbus_Handlers* Handlers, void* Context)
 {
-  t_status Status = OK;
-  unsigned short CRC16 = 0;
-  
+  t_status Status;
+
   if (Mdb_Type == MDB_CLIENT)
   {
-    //Build the request
-    msg->length = 8;
-    msg->data[0] = ServerAddr;
-    msg->data[1] = MDB_FC08;
-    PUT_WORD(&msg->data[2], DiagType);
-    PUT_WORD(&msg->data[4], Data);
-    
-    // Add CRC16
-    Status = Modbus_CRC16 (msg, &CRC16);
-    PUT_WORD(&msg->data[msg->length-2], CRC16);
+    Status = NOK;
   }
   else
   {
-    Status = NOK;
+    Mdb_Model.Handlers = (Handlers != 0) ? Handlers : &Modbus_DefaultHandlers;
+    Mdb_Model.Context = Context;
+    Status = OK;
   }
-  return(Status); 
+  return (Status);
 }
-#endif
 
-#if defined(MDB_FUNCTIONCODE_16)
 /**************************************************************************//**
-*   \brief      This function builds a Preset Multiple Registers request 
-*   \ingroup client  
-*   \param[in]  ServerAddr Node address of the targeted Modbus server
-*   \param[in]  Addr Address of the first register to be written
-*   \param[in]  Data Pointer to a structure which contains number of register to write 
-*               and the values to write in them
-*   \param[out] msg Pointer to a message which will receive the request to be sent on the network
-*   \return     OK if the request frame has been successfuly generated
-*   \return     NOK if the request frame has not been generated (i.e. CRC16 error, or device type is  a Modbus server)
+*   \brief      This function defines the units served by the device
+*
+*               The device then answers all the addresses of the unit table : the frame
+*               address selects the unit whose data model (tables, maps, handlers) serves 
+*               the request. The address of the device (Server_SetAddress) is still answered 
+*               with its own data model when it has no unit. The units only need to be 
+*               configured as servers, their address and counters are not used.
+*   \ingroup Server  
+*   \param[in]  Units Pointer to a table of 256 units indexed by address (0 if the address is not a unit)
+*               or 0 to serve the device address only
+*   \return     OK if the unit table has been defined
+*   \return     NOK if the device is not a server
 ******************************************************************************/
-t_status Modbus_RTU::Client_PresetMultipleRegisters(int ServerAddr, unsigned short Addr, Modbus_Data* Data, Modbus_Frame* msg)
+t_status Modbus_RTU::Server_SetUnits(Modbus_RTU** Units)
 {
-  t_status Status = OK;
-  unsigned short CRC16 = 0;
-  char Nb;
-  char* dest;
-  int* src;
-  int i;
-  
-  Nb = Data->length;
-  
+  t_status Status;
+
   if (Mdb_Type == MDB_CLIENT)
   {
-    //Build the request
-    msg->length = 7 + Nb * 2 + 2;
-    msg->data[0] = ServerAddr;
-    msg->data[1] = MDB_FC16;
-    PUT_WORD(&msg->data[2], Addr);
-    PUT_WORD(&msg->data[4], Nb);
-    msg->data[6] = Nb * 2;
-    
-    // writes the data to send  in the Modbus frame
-    for (i = 0; i < Nb; i++)
-    {
-      dest = &msg->data[7] + 2 * i;
-      src = (int*)&Data->data[0] + i;         // because variable type is integer for Data
-      PUT_WORD(dest, *src)
-    }
+    Status = NOK;
+  }
+  else
+  {
+    Mdb_Units = Units;
+    Status = OK;
+  }
+  return (Status);
+}
+
+/**************************************************************************//**
+*   \brief      This function defines the cache which stores the responses to read requests
+*
+*               FC03 and FC04 responses are kept in the cache, so that a request which is 
+*               polled again is answered with a copy of the response. Only blocks of registers 
+*               stored in memory (Server_SetHoldingRegisters, memory ranges of a map) are cached.
+*               A cached response is updated when it is read again after a write of the registers. 
+*               When the cache is used, the application shall update these registers with the 
+*               Server_Write... functions, or write them between Server_BeginWrite and Server_EndWrite.
+*   \ingroup Server  
+*   \param[in]  Entries Pointer to the cache entries or 0 to disable the cache
+*   \param[in]  Nb Number of entries
+*   \return     OK if the cache has been defined
+*   \return     NOK if the device is not a server
+******************************************************************************/
+t_status Modbus_RTU::Server_SetCache(Modbus_CacheEntry* Entries, unsigned short Nb)
+{
+  t_status Status;
+
+  if (Mdb_Type == MDB_CLIENT)
+  {
+    Status = NOK;
+  }
+  else
+  {
+    Mdb_Model.Cache.Entries = Entries;
+    Mdb_Model.Cache.Nb = (Entries != 0) ? Nb : 0;
+    Modbus_CacheClear(&Mdb_Model.Cache);
+    Status = OK;
+  }
+  return (Status);
+}
+
+#if defined(MDB_FUNCTIONCODE_03) || defined(MDB_FUNCTIONCODE_04) || defined(MDB_FUNCTIONCODE_06) || defined(MDB_FUNCTIONCODE_16) || defined(MDB_FUNCTIONCODE_23)
+/**************************************************************************//**
+*   \brief      This function writes a holding register stored in memory
+*   \ingroup Server  
+*   \param[in]  Addr Address of the register
+*   \param[in]  Value Value of the register
+*   \return     OK if the register has been written
+*   \return     NOK if the register is not stored in memory
+******************************************************************************/
+t_status Modbus_RTU::Server_WriteRegister(unsigned short Addr, unsigned short Value)
+{
+  return (Modbus_WriteMapRegisters(&Mdb_Model, &Mdb_Model.HoldingRegisters, Addr, 1, &Value));
+}
+
+/**************************************************************************//**
+*   \brief      This function writes a block of consecutive holding registers stored in memory
+*
+*               The block is written at once : the server never reads part of it 
+*               (e.g. half of a 32-bit value), even from another thread.
+*   \ingroup Server  
+*   \param[in]  Addr Address of the first register
+*   \param[in]  Nb Number of consecutive registers
+*   \param[in]  Values Pointer to the values of the registers
+*   \return     OK if the registers have been written
+*   \return     NOK if one of the registers is not stored in memory (nothing is written)
+******************************************************************************/
+t_status Modbus_RTU::Server_WriteRegisters(unsigned short Addr, int Nb, unsigned short* Values)
+{
+  return (Modbus_WriteMapRegisters(&Mdb_Model, &Mdb_Model.HoldingRegisters, Addr, Nb, Values));
+}
+
+/**************************************************************************//**
+*   \brief      This function writes an input register stored in memory
+*   \ingroup Server  
+*   \param[in]  Addr Address of the input register
+*   \param[in]  Value Value of the input register
+*   \return     OK if the input register has been written
+*   \return     NOK if the input register is not stored in memory
+******************************************************************************/
+t_status Modbus_RTU::Server_WriteInputRegister(unsigned short Addr, unsigned short Value)
+{
+  return (Modbus_WriteMapRegisters(&Mdb_Model, &Mdb_Model.InputRegisters, Addr, 1, &Value));
+}
+
+/**************************************************************************//**
+*   \brief      This function writes a block of consecutive input registers stored in memory
+*
+*               The block is written at once : the server never reads part of it 
+*               (e.g. half of a 32-bit value), even from another thread.
+*   \ingroup Server  
+*   \param[in]  Addr Address of the first input register
+*   \param[in]  Nb Number of consecutive input registers
+*   \param[in]  Values Pointer to the values of the input registers
+*   \return     OK if the input registers have been written
+*   \return     NOK if one of the input registers is not stored in memory (nothing is written)
+******************************************************************************/
+t_status Modbus_RTU::Server_WriteInputRegisters(unsigned short Addr, int Nb, unsigned short* Values)
+{
+  return (Modbus_WriteMapRegisters(&Mdb_Model, &Mdb_Model.InputRegisters, Addr, Nb, Values));
+}
+#endif
+
+/**************************************************************************//**
+*   \brief      This function starts an update of the registers by the application
+*
+*               Registers written in memory by the application between Server_BeginWrite and 
+*               Server_EndWrite are never read partially by the server, even from another thread : 
+*               the server reads them again if they are written meanwhile. Server_Write... functions 
+*               shall not be called during the update.
+*               The server takes the same lock while it copies the values of a write request 
+*               (FC06, FC16, FC23) into the registers stored in memory : Server_BeginWrite may wait 
+*               for the end of such a copy (at most 123 registers), never for a write handler 
+*               or for the serial line.
+*   \ingroup Server  
+*   \return     OK if the update has started
+*   \return     NOK if the device is not a server
+******************************************************************************/
+t_status Modbus_RTU::Server_BeginWrite(void)
+{
+  t_status Status;
+
+  if (Mdb_Type == MDB_CLIENT)
+  {
+    Status = NOK;
+  }
+  else
+  {
+    Modbus_WriteBegin(&Mdb_Model);
+    Status = OK;
+  }
+  return (Status);
+}
+
+/**************************************************************************//**
+*   \brief      This function ends an update of the registers by the application
+*   \ingroup Server  
+*   \return     OK if the update has ended
+*   \return     NOK if the device is not a server
+******************************************************************************/
+t_status Modbus_RTU::Server_EndWrite(void)
+{
+  t_status Status;
+
+  if (Mdb_Type == MDB_CLIENT)
+  {
+    Status = NOK;
+  }
+  else
+  {
+    Modbus_WriteEnd(&Mdb_Model);
+    Status = OK;
+  }
+  return (Status);
+}
+
+// CLass Interface : client ///////////////////////////////////////////////////
+#if defined(MDB_FUNCTIONCODE_01)
+/**************************************************************************//**
+*   \brief      This function builds a Read Coils request 
+*   \ingroup client  
+*   \param[in]  ServerAddr Node address of the targeted Modbus server
+*   \param[in]  Addr Address of the first coil to be read
+*   \param[in]  Nb Number of consecutive coils to read
+*   \param[out] msg Pointer to a message which will receive the request to be sent on the network
+*   \return     OK if the request frame has been successfuly generated
+*   \return     NOK if the request frame has not been generated (i.e. CRC16 error, device type is a Modbus server, or msg is too small)
+******************************************************************************/
+t_status Modbus_RTU::Client_ReadCoils(int ServerAddr, unsigned short Addr, int Nb, Modbus_View* msg)
+{
+  t_status Status = OK;
+  unsigned short CRC16 = 0;
+  
+  if ((Mdb_Type == MDB_CLIENT) && (msg->size >= 8))
+  {
+    //Build the request
+    msg->length = 8;
+    msg->data[0] = ServerAddr;
+    msg->data[1] = MDB_FC01;
+    PUT_WORD(&msg->data[2], Addr);
+    PUT_WORD(&msg->data[4], Nb);
     
     // Add CRC16
     Status = Modbus_CRC16 (msg, &CRC16);
@@ -835,42 +1364,68 @@ t_status Modbus_RTU::Client_PresetMultipleRegisters(int ServerAddr, unsigned sho
 }
 #endif
 
-#if defined(MDB_FUNCTIONCODE_23)
+#if defined(MDB_FUNCTIONCODE_02)
 /**************************************************************************//**
-*   \brief      This function builds a Read/Write Multiple Registers request 
+*   \brief      This function builds a Read Discrete Inputs request 
 *   \ingroup client  
 *   \param[in]  ServerAddr Node address of the targeted Modbus server
-*   \param[in]  rAddr Address of the first register to be read
-*   \param[in]  rNb Number of consecutive registers registers to read
-*   \param[in]  wAddr Address of the first register to be written
-*   \param[in]  Data Pointer to a structure that contains the number of consecutive register 
-*               and the values to write in them
+*   \param[in]  Addr Address of the first input to be read
+*   \param[in]  Nb Number of consecutive inputs to read
 *   \param[out] msg Pointer to a message which will receive the request to be sent on the network
 *   \return     OK if the request frame has been successfuly generated
-*   \return     NOK if the request frame has not been generated (i.e. CRC16 error, or device type is  a Modbus server)
+*   \return     NOK if the request frame has not been generated (i.e. CRC16 error, device type is a Modbus server, or msg is too small)
 ******************************************************************************/
-t_status Modbus_RTU::Client_ReadWriteMultipleRegisters(int ServerAddr, unsigned short rAddr, int rNb,unsigned short wAddr, Modbus_Data* Data, Modbus_Frame* msg)
+t_status Modbus_RTU::Client_ReadDiscreteInputs(int ServerAddr, unsigned short Addr, int Nb, Modbus_View* msg)
 {
   t_status Status = OK;
   unsigned short CRC16 = 0;
-  int i;
- 
-  if (Mdb_Type == MDB_CLIENT)
+  
+  if ((Mdb_Type == MDB_CLIENT) && (msg->size >= 8))
   {
     //Build the request
-    msg->length = 11 + Data->length * 2 + 2;
+    msg->length = 8;
     msg->data[0] = ServerAddr;
-    msg->data[1] = MDB_FC23;
-    PUT_WORD(&msg->data[2], rAddr);
-    PUT_WORD(&msg->data[4], rNb);
-    PUT_WORD(&msg->data[6], wAddr);
-    PUT_WORD(&msg->data[8], Data->length);
-    msg->data[10] = Data->length * 2;
-    for (i = 0; i<Data->length; i++)
-    {
-      PUT_WORD(&msg->data[11+(i*2)], Data->data[i]);
-    }
+    msg->data[1] = MDB_FC02;
+    PUT_WORD(&msg->data[2], Addr);
+    PUT_WORD(&msg->data[4], Nb);
+    
+    // Add CRC16
+    Status = Modbus_CRC16 (msg, &CRC16);
+    PUT_WORD(&msg->data[msg->length-2], CRC16);
+  }
+  else
+  {
+    Status = NOK;
+  }
+  return(Status);
+}
+#endif
+
+#if defined(MDB_FUNCTIONCODE_03)
+/**************************************************************************//**
+*   \brief      This function builds a Read Holding Registers request 
+*   \ingroup client  
+*   \param[in]  ServerAddr Node address of the targeted server
+*   \param[in]  Addr Address of the first register to be read
+*   \param[in]  Nb Number of consecutive registers to read
+*   \param[out] msg Pointer to a message which will receive the request to be sent on the network
+*   \return     OK if the request frame has been successfuly generated
+*   \return     NOK if the request frame has not been generated (i.e. CRC16 error, device type is a Modbus server, or msg is too small)
+******************************************************************************/
+t_status Modbus_RTU::Client_ReadHoldingRegisters(int ServerAddr, unsigned short Addr, int Nb, Modbus_View* msg)
+{
+  t_status Status = OK;
+  unsigned short CRC16 = 0;
   
+  if ((Mdb_Type == MDB_CLIENT) && (msg->size >= 8))
+  {
+    //Build the request
+    msg->length = 8;
+    msg->data[0] = ServerAddr;
+    msg->data[1] = MDB_FC03;
+    PUT_WORD(&msg->data[2], Addr);
+    PUT_WORD(&msg->data[4], Nb);
+    
     // Add CRC16
     Status = Modbus_CRC16 (msg, &CRC16);
     PUT_WORD(&msg->data[msg->length-2], CRC16);
@@ -883,46 +1438,354 @@ t_status Modbus_RTU::Client_ReadWriteMultipleRegisters(int ServerAddr, unsigned
 }
 #endif
 
-//#ifdef MODBUS_CLIENT
+#if defined(MDB_FUNCTIONCODE_04)
 /**************************************************************************//**
-*   \brief      This function extracts Data from the response frame sent by a Modbus server
-*
-*   This function shall be called after receiving a response to a request frame 
-*   to extract required data.  
-*   \ingroup Client  
-*   \param[in]  msg Pointer to a message which contains the response frame received from the network
-*   \param[out] Data Pointer to a structure which will receive the number of data and their values 
-*   \return     OK if treatment is possible (in case of Modbus exception, length will be 0) 
-*   \return     NOK if this function could not be executed ( i.e. if the device type is not a client)
+*   \brief      This function builds a Read Input Registers request 
+*   \ingroup client  
+*   \param[in]  ServerAddr Node address of the targeted Modbus server
+*   \param[in]  Addr Address of the first input register to be read
+*   \param[in]  Nb Number of consecutive input registers to read
+*   \param[out] msg Pointer to a message which will receive the request to be sent on the network
+*   \return     OK if the request frame has been successfuly generated
+*   \return     NOK if the request frame has not been generated (i.e. CRC16 error, device type is a Modbus server, or msg is too small)
 ******************************************************************************/
-t_status Modbus_RTU::Client_Update(Modbus_Frame* msg, Modbus_Data* Data)
+t_status Modbus_RTU::Client_ReadInputRegisters(int ServerAddr, unsigned short Addr, int Nb, Modbus_View* msg)
 {
   t_status Status = OK;
-  int i;
   unsigned short CRC16 = 0;
-  unsigned short crc1 = 0xFFFF;
   
-  // Init of the destination structure
-  Data->length = 0;
+  if ((Mdb_Type == MDB_CLIENT) && (msg->size >= 8))
+  {
+    //Build the request
+    msg->length = 8;
+    msg->data[0] = ServerAddr;
+    msg->data[1] = MDB_FC04;
+    PUT_WORD(&msg->data[2], Addr);
+    PUT_WORD(&msg->data[4], Nb);
+    
+    // Add CRC16
+    Modbus_CRC16 (msg, &CRC16);
+    PUT_WORD(&msg->data[msg->length-2], CRC16);
+  }
+  else
+  {
+    Status = NOK;
+  } 
+  return(Status);
+}
+#endif
+
+#if defined(MDB_FUNCTIONCODE_05)
+/**************************************************************************//**
+*   \brief      This function builds a Write Single Coil request 
+*   \ingroup client  
+*   \param[in]  ServerAddr Node address of the targeted Modbus server
+*   \param[in]  Addr Address of the coil to write
+*   \param[in]  Data Desired state of the coil
+*   \param[out] msg Pointer to a message which will receive the request to be sent on the network
+*   \return     OK if the request frame has been successfuly generated
+*   \return     NOK if the request frame has not been generated (i.e. CRC16 error, device type is a Modbus server, or msg is too small)
+******************************************************************************/
+t_status Modbus_RTU::Client_WriteSingleCoil(int ServerAddr, unsigned short Addr, int Data, Modbus_View* msg)
+{
+  t_status Status = OK;
+  unsigned short CRC16 = 0;
   
-  if (Mdb_Type == MDB_CLIENT)
-  {   
-    // Check frame CRC
-    CRC16 = GET_WORD(msg->data + msg->length-2);
-    if (Modbus_CRC16(msg, &crc1))
-    {
-      if (crc1 != CRC16)
-      {
-        return(NOK);
-      }
-    }
+  if ((Mdb_Type == MDB_CLIENT) && (msg->size >= 8))
+  {
+    //Build the request
+    msg->length = 8;
+    msg->data[0] = ServerAddr;
+    msg->data[1] = MDB_FC05;
+    if (Data != 0)
+      Data = 0xFF;
+    PUT_WORD(&msg->data[2], Addr);
+    PUT_WORD(&msg->data[4], Data);
+    
+    // Add CRC16
+    Status = Modbus_CRC16 (msg, &CRC16);
+    PUT_WORD(&msg->data[msg->length-2], CRC16);
+  }
+  else
+  {
+    Status = NOK;
+  }
+  return(Status);
+}
+#endif
 
-    switch(msg->data[1])
-    {
+#if defined(MDB_FUNCTIONCODE_06)
+/**************************************************************************//**
+*   \brief      This function builds a Preset Single Register request 
+*   \ingroup client  
+*   \param[in]  ServerAddr Node address of the targeted Modbus server
+*   \param[in]  Addr Address of the register to write
+*   \param[in]  Data Desired value of the register
+*   \param[out] msg Pointer to a message which will receive the request to be sent on the network
+*   \return     OK if the request frame has been successfuly generated
+*   \return     NOK if the request frame has not been generated (i.e. CRC16 error, device type is a Modbus server, or msg is too small)
+******************************************************************************/
+t_status Modbus_RTU::Client_PresetSingleRegister(int ServerAddr, unsigned short Addr, int Data, Modbus_View* msg)
+{
+  t_status Status = OK;
+  unsigned short CRC16 = 0;
+  
+  if ((Mdb_Type == MDB_CLIENT) && (msg->size >= 8))
+  {
+    //Build the request
+    msg->length = 8;
+    msg->data[0] = ServerAddr;
+    msg->data[1] = MDB_FC06;
+    PUT_WORD(&msg->data[2], Addr);
+    PUT_WORD(&msg->data[4], Data);
+    
+    // Add CRC16
+    Status = Modbus_CRC16 (msg, &CRC16);
+    PUT_WORD(&msg->data[msg->length-2], CRC16);
+  }
+  else
+  {
+    Status = NOK;
+  }
+  return(Status);
+}
+#endif
+
+#if defined(MDB_FUNCTIONCODE_07)
+/**************************************************************************//**
+*   \brief      This function builds a Read Exception request 
+*   \ingroup client  
+*   \param[in]  ServerAddr Node address of the targeted Modbus server
+*   \param[out] msg Pointer to a message which will receive the request to be sent on the network
+*   \return     OK if the request frame has been successfuly generated
+*   \return     NOK if the request frame has not been generated (i.e. CRC16 error, device type is a Modbus server, or msg is too small)
+******************************************************************************/
+t_status Modbus_RTU::Client_ReadException(int ServerAddr, Modbus_View* msg)
+{
+  t_status Status = OK;
+  unsigned short CRC16 = 0;
+  
+  if ((Mdb_Type == MDB_CLIENT) && (msg->size >= 4))
+  {
+    //Build the request
+    msg->length = 4;
+    msg->data[0] = ServerAddr;
+    msg->data[1] = MDB_FC07;
+    
+    // Add CRC16
+    Status = Modbus_CRC16 (msg, &CRC16);
+    PUT_WORD(&msg->data[msg->length-2], CRC16);
+  }
+  else
+  {
+    Status = NOK;
+  }
+  return(Status); 
+}
+#endif
+
+#if defined(MDB_FUNCTIONCODE_08)
+/**************************************************************************//**
+*   \brief      This function builds a Read Diagnostic request 
+*   \ingroup client  
+*   \param[in]  ServerAddr Node address of the targeted Modbus server
+*   \param[in]  DiagType Select which diagnostic value is requested
+*   \param[in]  Data Additionnal information (depending on DiagType)
+*   \param[out] msg Pointer to a message which will receive the request to be sent on the network
+*   \return     OK if the request frame has been successfuly generated
+*   \return     NOK if the request frame has not been generated (i.e. CRC16 error, device type is a Modbus server, or msg is too small)
+******************************************************************************/
+t_status Modbus_RTU::Client_ReadDiagnostic(int ServerAddr, t_diagtype DiagType, int Data, Modbus_View* msg)
+{
+  t_status Status = OK;
+  unsigned short CRC16 = 0;
+  
+  if ((Mdb_Type == MDB_CLIENT) && (msg->size >= 8))
+  {
+    //Build the request
+    msg->length = 8;
+    msg->data[0] = ServerAddr;
+    msg->data[1] = MDB_FC08;
+    PUT_WORD(&msg->data[2], DiagType);
+    PUT_WORD(&msg->data[4], Data);
+    
+    // Add CRC16
+    Status = Modbus_CRC16 (msg, &CRC16);
+    PUT_WORD(&msg->data[msg->length-2], CRC16);
+  }
+  else
+  {
+    Status = NOK;
+  }
+  return(Status); 
+}
+#endif
+
+#if defined(MDB_FUNCTIONCODE_16)
+/**************************************************************************//**
+*   \brief      This function builds a Preset Multiple Registers request 
+*   \ingroup client  
+*   \param[in]  ServerAddr Node address of the targeted Modbus server
+*   \param[in]  Addr Address of the first register to be written
+*   \param[in]  Data Pointer to a structure which contains number of register to write 
+*               and the values to write in them
+*   \param[out] msg Pointer to a message which will receive the request to be sent on the network
+*   \return     OK if the request frame has been successfuly generated
+*   \return     NOK if the request frame has not been generated (i.e. CRC16 error, device type is a Modbus server, or msg is too small)
+******************************************************************************/
+t_status Modbus_RTU::Client_PresetMultipleRegisters(int ServerAddr, unsigned short Addr, Modbus_Data* Data, Modbus_View* msg)
+{
+  t_status Status = OK;
+  unsigned short CRC16 = 0;
+  char Nb;
+  
+  Nb = Data->length;
+  
+  if ((Mdb_Type == MDB_CLIENT) && (msg->size >= 7 + Nb * 2 + 2))
+  {
+    //Build the request
+    msg->length = 7 + Nb * 2 + 2;
+    msg->data[0] = ServerAddr;
+    msg->data[1] = MDB_FC16;
+    PUT_WORD(&msg->data[2], Addr);
+    PUT_WORD(&msg->data[4], Nb);
+    msg->data[6] = Nb * 2;
+    
+    // writes the data to send  in the Modbus frame
+    Modbus_PutDataRegisters(&msg->data[7], Data->data, Nb);
+    
+    // Add CRC16
+    Status = Modbus_CRC16 (msg, &CRC16);
+    PUT_WORD(&msg->data[msg->length-2], CRC16);
+  }
+  else
+  {
+    Status = NOK;
+  }
+  return(Status);
+}
+#endif
+
+#if defined(MDB_FUNCTIONCODE_23)
+/**************************************************************************//**
+*   \brief      This function builds a Read/Write Multiple Registers request 
+*   \ingroup client  
+*   \param[in]  ServerAddr Node address of the targeted Modbus server
+*   \param[in]  rAddr Address of the first register to be read
+*   \param[in]  rNb Number of consecutive registers registers to read
+*   \param[in]  wAddr Address of the first register to be written
+*   \param[in]  Data Pointer to a structure that contains the number of consecutive register 
+*               and the values to write in them
+*   \param[out] msg Pointer to a message which will receive the request to be sent on the network
+*   \return     OK if the request frame has been successfuly generated
+*   \return     NOK if the request frame has not been generated (i.e. CRC16 error, device type is a Modbus server, or msg is too small)
+******************************************************************************/
+t_status Modbus_RTU::Client_ReadWriteMultipleRegisters(int ServerAddr, unsigned short rAddr, int rNb,unsigned short wAddr, Modbus_Data* Data, Modbus_View* msg)
+{
+  t_status Status = OK;
+  unsigned short CRC16 = 0;
+ 
+  if ((Mdb_Type == MDB_CLIENT) && (msg->size >= 11 + Data->length * 2 + 2))
+  {
+    //Build the request
+    msg->length = 11 + Data->length * 2 + 2;
+    msg->data[0] = ServerAddr;
+    msg->data[1] = MDB_FC23;
+    PUT_WORD(&msg->data[2], rAddr);
+    PUT_WORD(&msg->data[4], rNb);
+    PUT_WORD(&msg->data[6], wAddr);
+    PUT_WORD(&msg->data[8], Data->length);
+    msg->data[10] = Data->length * 2;
+    Modbus_PutDataRegisters(&msg->data[11], Data->data, Data->length);
+  
+    // Add CRC16
+    Status = Modbus_CRC16 (msg, &CRC16);
+    PUT_WORD(&msg->data[msg->length-2], CRC16);
+  }
+  else
+  {
+    Status = NOK;
+  }
+  return(Status);
+}
+#endif
+
+//#ifdef MODBUS_CLIENT
+/**************************************************************************//**
+*   \brief      This function extracts Data from the response frame sent by a Modbus server
+*
+*   This function shall be called after receiving a response to a request frame 
+*   to extract required data.  
+*   \ingroup Client  
+*   \param[in]  msg Pointer to a message which contains the response frame received from the network
+*   \param[out] Data Pointer to a structure which will receive the number of data and their values 
+*   \return     OK if treatment is possible (in case of Modbus exception or inconsistent byte count, length will be 0) 
+*   \return     NOK if this function could not be executed ( i.e. if the device type is not a client,
+*               or if the data do not fit in Data : more than 62 registers, use Client_DecodeRegisters)
+******************************************************************************/
+t_status Modbus_RTU::Client_Update(Modbus_View* msg, Modbus_Data* Data)
+{
+  return (Client_Update(msg, Data, 0));
+}
+
+/**************************************************************************//**
+*   \brief      This function extracts Data from the response frame sent by a Modbus server, 
+*               whose CRC16 has been computed while it was received
+*
+*   The CRC16 context shall be initialized (Modbus_CRC16Init) at the start of the frame
+*   and updated (Modbus_CRC16Update) with each received byte, CRC16 included.
+*   \ingroup Client  
+*   \param[in]  msg Pointer to a message which contains the response frame received from the network
+*   \param[out] Data Pointer to a structure which will receive the number of data and their values 
+*   \param[in]  Context Pointer to the CRC16 context of the received frame
+*               or 0 to compute the CRC16 of the frame
+*   \return     OK if treatment is possible (in case of Modbus exception or inconsistent byte count, length will be 0) 
+*   \return     NOK if this function could not be executed ( i.e. if the device type is not a client,
+*               or if the data do not fit in Data : more than 62 registers, use Client_DecodeRegisters)
+******************************************************************************/
+t_status Modbus_RTU::Client_Update(Modbus_View* msg, Modbus_Data* Data, Modbus_CRC16Context* Context)
+{
+  t_status Status = OK;
+  int i;
+  int ByteCount;
+  Modbus_CRC16Context FrameContext;
+  
+  // Init of the destination structure
+  Data->length = 0;
+  
+  if ((Mdb_Type == MDB_CLIENT) && (msg->length <= msg->size))
+  {   
+    // Check frame CRC : the CRC16 of a frame including its CRC16 is 0
+    if (Context == 0)
+    {
+      Modbus_CRC16Init(&FrameContext);
+      Modbus_CRC16UpdateBlock(&FrameContext, msg->data, msg->length);
+      Context = &FrameContext;
+    }
+    if (Modbus_CRC16Final(Context) != 0)
+    {
+      return(NOK);
+    }
+
+    // Check that the data announced by the byte count are in the frame
+    ByteCount = (msg->length > 2) ? (unsigned char)msg->data[2] : 0;
+    if (msg->length < 3 + ByteCount + 2)
+    {
+      ByteCount = 0;
+    }
+    else if (ByteCount > MDB_REG_NUMBER_MAX)
+    {
+      // Data do not fit in Data (1 byte per item) : not extracted
+      ByteCount = 0;
+      Status = NOK;
+    }
+
+    switch(msg->data[1])
+    {
 #if defined(MDB_FUNCTIONCODE_01) || defined(MDB_FUNCTIONCODE_02)
       case MDB_FC01:
       case MDB_FC02:
-          Data->length = msg->data[2];
+          Data->length = ByteCount;
           Data->type = MDB_BIT;
           for (i = 0; i<Data->length; i++)
           {
@@ -933,7 +1796,7 @@ t_status Modbus_RTU::Client_Update(Modbus_Frame* msg, Modbus_Data* Data)
 #if defined(MDB_FUNCTIONCODE_03) || defined(MDB_FUNCTIONCODE_04)
       case MDB_FC03:
       case MDB_FC04:
-          Data->length = msg->data[2] / 2;
+          Data->length = ByteCount / 2;
           Data->type = MDB_WORD;
           for (i = 0; i<Data->length; i++)
           
@@ -961,7 +1824,7 @@ t_status Modbus_RTU::Client_Update(Modbus_Frame* msg, Modbus_Data* Data)
 #endif
 #if defined(MDB_FUNCTIONCODE_23)
       case MDB_FC23:
-          Data->length = msg->data[2] / 2;
+          Data->length = ByteCount / 2;
           Data->type = MDB_WORD;
           for (i = 0; i<Data->length; i++)
           
@@ -971,167 +1834,2065 @@ t_status Modbus_RTU::Client_Update(Modbus_Frame* msg, Modbus_Data* Data)
           }
           break;
 #endif
-      default:
-          break;
+      default:
+          break;
+    }
+  }
+  else
+  {
+    Status = NOK;
+  }
+  return(Status);
+}
+//#endif
+
+/**************************************************************************//**
+*   \brief      This function builds a list of requests one after the other in a transmit arena
+*
+*   Each request is built as by the matching Client_xx function, at the end of the previous 
+*   one. Its offset and length in the arena are stored in the request structure, so the whole 
+*   batch can be sent with a single gather write (writev, io_uring...). Requests which cannot 
+*   be built (unsupported function code, arena full...) get a length of 0.
+*   \ingroup Client  
+*   \param[in,out] Requests Pointer to an array of requests (parameters in, offset and length out)
+*   \param[in]  Nb Number of requests
+*   \param[out] Arena Pointer to the transmit arena
+*   \param[in]  Size Size of the arena (in bytes)
+*   \param[out] Used Pointer to a variable which will receive the number of bytes used in the arena
+*   \return     OK if all requests have been built
+*   \return     NOK if at least one request has not been built
+******************************************************************************/
+t_status Modbus_RTU::Client_BuildBatch(Modbus_BatchRequest* Requests, int Nb, char* Arena, unsigned long Size, unsigned long* Used)
+{
+  t_status Status = OK;
+  t_status FrameStatus;
+  Modbus_BatchRequest* Request;
+  Modbus_View View;
+  unsigned long Offset = 0;
+  int i;
+
+  for (i = 0; i < Nb; i++)
+  {
+    Request = &Requests[i];
+    View.data = Arena + Offset;
+    View.length = 0;
+    View.size = (Size - Offset < MDB_MSG_LENGTH_MAX) ? (unsigned short)(Size - Offset) : MDB_MSG_LENGTH_MAX;
+
+    switch (Request->FunctionCode)
+    {
+#if defined(MDB_FUNCTIONCODE_01)
+      case MDB_FC01:
+          FrameStatus = Client_ReadCoils(Request->ServerAddr, Request->Addr, Request->Nb, &View);
+          break;
+#endif
+#if defined(MDB_FUNCTIONCODE_02)
+      case MDB_FC02:
+          FrameStatus = Client_ReadDiscreteInputs(Request->ServerAddr, Request->Addr, Request->Nb, &View);
+          break;
+#endif
+#if defined(MDB_FUNCTIONCODE_03)
+      case MDB_FC03:
+          FrameStatus = Client_ReadHoldingRegisters(Request->ServerAddr, Request->Addr, Request->Nb, &View);
+          break;
+#endif
+#if defined(MDB_FUNCTIONCODE_04)
+      case MDB_FC04:
+          FrameStatus = Client_ReadInputRegisters(Request->ServerAddr, Request->Addr, Request->Nb, &View);
+          break;
+#endif
+#if defined(MDB_FUNCTIONCODE_05)
+      case MDB_FC05:
+          FrameStatus = Client_WriteSingleCoil(Request->ServerAddr, Request->Addr, Request->Nb, &View);
+          break;
+#endif
+#if defined(MDB_FUNCTIONCODE_06)
+      case MDB_FC06:
+          FrameStatus = Client_PresetSingleRegister(Request->ServerAddr, Request->Addr, Request->Nb, &View);
+          break;
+#endif
+#if defined(MDB_FUNCTIONCODE_07)
+      case MDB_FC07:
+          FrameStatus = Client_ReadException(Request->ServerAddr, &View);
+          break;
+#endif
+#if defined(MDB_FUNCTIONCODE_08)
+      case MDB_FC08:
+          FrameStatus = Client_ReadDiagnostic(Request->ServerAddr, (t_diagtype)Request->Addr, Request->Nb, &View);
+          break;
+#endif
+#if defined(MDB_FUNCTIONCODE_16)
+      case MDB_FC16:
+          FrameStatus = (Request->Data != 0) ? Client_PresetMultipleRegisters(Request->ServerAddr, Request->Addr, Request->Data, &View) : NOK;
+          break;
+#endif
+#if defined(MDB_FUNCTIONCODE_23)
+      case MDB_FC23:
+          FrameStatus = (Request->Data != 0) ? Client_ReadWriteMultipleRegisters(Request->ServerAddr, Request->Addr, Request->Nb, Request->wAddr, Request->Data, &View) : NOK;
+          break;
+#endif
+      default:
+          FrameStatus = NOK;
+          break;
+    }
+
+    Request->Offset = Offset;
+    if (FrameStatus == OK)
+    {
+      Request->Length = View.length;
+      Offset += View.length;
+    }
+    else
+    {
+      Request->Length = 0;
+      Status = NOK;
+    }
+  }
+
+  *Used = Offset;
+  return (Status);
+}
+
+#if defined(MDB_FUNCTIONCODE_01) || defined(MDB_FUNCTIONCODE_02) || defined(MDB_FUNCTIONCODE_03) || defined(MDB_FUNCTIONCODE_04)
+/**************************************************************************//**
+*   \brief      This function builds a read request once, to be sent as is at each poll
+*
+*   The request frame (data, length) is sent without any further processing and the
+*   response is checked with Client_CheckResponse before being decoded.
+*   \ingroup Client  
+*   \param[out] Request Pointer to a structure which will receive the request
+*   \param[in]  ServerAddr Node address of the targeted Modbus server
+*   \param[in]  FunctionCode Function code of the request (MDB_FC01, MDB_FC02, MDB_FC03 or MDB_FC04)
+*   \param[in]  Addr Address of the first object to be read
+*   \param[in]  Nb Number of consecutive objects to read
+*   \return     OK if the request has been built
+*   \return     NOK if the request has not been built (i.e. device type is a Modbus server,
+*               unsupported function code or number of objects out of range)
+******************************************************************************/
+t_status Modbus_RTU::Client_BuildRequest(Modbus_Request* Request, int ServerAddr, char FunctionCode, unsigned short Addr, int Nb)
+{
+  t_status Status = NOK;
+  int ByteCount = 0;
+  Modbus_View View;
+
+  View.data = Request->data;
+  View.length = 0;
+  View.size = sizeof(Request->data);
+
+  switch (FunctionCode)
+  {
+#if defined(MDB_FUNCTIONCODE_01)
+    case MDB_FC01:
+        if ((Nb >= 1) && (Nb <= MDB_INP_NUMBER_MAX))
+        {
+          Status = Client_ReadCoils(ServerAddr, Addr, Nb, &View);
+          ByteCount = (Nb + 7) >> 3;
+        }
+        break;
+#endif
+#if defined(MDB_FUNCTIONCODE_02)
+    case MDB_FC02:
+        if ((Nb >= 1) && (Nb <= MDB_INP_NUMBER_MAX))
+        {
+          Status = Client_ReadDiscreteInputs(ServerAddr, Addr, Nb, &View);
+          ByteCount = (Nb + 7) >> 3;
+        }
+        break;
+#endif
+#if defined(MDB_FUNCTIONCODE_03)
+    case MDB_FC03:
+        if ((Nb >= 1) && (Nb <= MDB_REG_NUMBER_MAX))
+        {
+          Status = Client_ReadHoldingRegisters(ServerAddr, Addr, Nb, &View);
+          ByteCount = Nb * 2;
+        }
+        break;
+#endif
+#if defined(MDB_FUNCTIONCODE_04)
+    case MDB_FC04:
+        if ((Nb >= 1) && (Nb <= MDB_REG_NUMBER_MAX))
+        {
+          Status = Client_ReadInputRegisters(ServerAddr, Addr, Nb, &View);
+          ByteCount = Nb * 2;
+        }
+        break;
+#endif
+    default:
+        break;
+  }
+
+  Request->length = (Status == OK) ? View.length : 0;
+  Request->ResponseLength = 3 + ByteCount + 2;
+  return (Status);
+}
+
+/**************************************************************************//**
+*   \brief      This function checks that a response frame matches a prebuilt request
+*
+*   Server node address, function code, byte count and frame length are compared
+*   with the ones expected for the request. The CRC16 is checked when the response
+*   is decoded (Client_DecodeBits, Client_DecodeBitTable, Client_DecodeRegisters...).
+*   \ingroup Client  
+*   \param[in]  Request Pointer to the request sent to the server
+*   \param[in]  msg Pointer to a message which contains the response frame received from the network
+*   \return     OK if the response header matches the request
+*   \return     NOK otherwise (i.e. request not built, Modbus exception, response to another request)
+******************************************************************************/
+t_status Modbus_RTU::Client_CheckResponse(const Modbus_Request* Request, Modbus_View* msg)
+{
+  if ((Request->length == 0) || (msg->length != Request->ResponseLength) || (msg->length > msg->size)
+      || (msg->data[0] != Request->data[0]) || (msg->data[1] != Request->data[1])
+      || ((unsigned char)msg->data[2] != Request->ResponseLength - 5))
+  {
+    return (NOK);
+  }
+  return (OK);
+}
+#endif
+
+#if defined(MDB_FUNCTIONCODE_01) || defined(MDB_FUNCTIONCODE_02)
+/**************************************************************************//**
+*   \brief      This function extracts the states of coils or discrete inputs from
+*               the response frame sent by a Modbus server (FC01, FC02), one bool per object
+*   \ingroup Client  
+*   \param[in]  msg Pointer to a message which contains the response frame received from the network
+*   \param[out] Values Pointer to an array which will receive the object states
+*   \param[in]  Nb Number of objects read by the request
+*   \param[in]  Context Pointer to the CRC16 context of the received frame
+*               or 0 to compute the CRC16 of the frame
+*   \return     OK if the states have been extracted
+*   \return     NOK otherwise (i.e. device type is not a client, CRC16 error, Modbus exception,
+*               unexpected function code or byte count)
+******************************************************************************/
+t_status Modbus_RTU::Client_DecodeBits(Modbus_View* msg, bool* Values, int Nb, Modbus_CRC16Context* Context)
+{
+  unsigned char* src;
+  int i;
+
+  if ((Mdb_Type != MDB_CLIENT) || (Nb <= 0) || (Modbus_ResponseByteCount(msg, Context) != (Nb + 7) >> 3)
+      || ((msg->data[1] != MDB_FC01) && (msg->data[1] != MDB_FC02)))
+  {
+    return (NOK);
+  }
+
+  src = (unsigned char*)&msg->data[3];
+  for (i = 0; i < Nb; i++)
+  {
+    Values[i] = (src[i >> 3] >> (i & 7)) & 1;
+  }
+  return (OK);
+}
+
+/**************************************************************************//**
+*   \brief      This function extracts the states of coils or discrete inputs from
+*               the response frame sent by a Modbus server (FC01, FC02) into a bit table
+*
+*               The table receives 8 objects per byte, LSB first (as Modbus_BitTable),
+*               the unused bits of its last byte are cleared.
+*   \ingroup Client  
+*   \param[in]  msg Pointer to a message which contains the response frame received from the network
+*   \param[out] Table Pointer to a bit table which will receive the object states
+*   \param[in]  Nb Number of objects read by the request
+*   \param[in]  Context Pointer to the CRC16 context of the received frame
+*               or 0 to compute the CRC16 of the frame
+*   \return     OK if the states have been extracted
+*   \return     NOK otherwise (i.e. device type is not a client, CRC16 error, Modbus exception,
+*               unexpected function code or byte count)
+******************************************************************************/
+t_status Modbus_RTU::Client_DecodeBitTable(Modbus_View* msg, unsigned char* Table, int Nb, Modbus_CRC16Context* Context)
+{
+  int NbByte = (Nb + 7) >> 3;
+
+  if ((Mdb_Type != MDB_CLIENT) || (Nb <= 0) || (Modbus_ResponseByteCount(msg, Context) != NbByte)
+      || ((msg->data[1] != MDB_FC01) && (msg->data[1] != MDB_FC02)))
+  {
+    return (NOK);
+  }
+
+  memcpy(Table, &msg->data[3], NbByte);
+  if (Nb & 7)
+  {
+    Table[NbByte - 1] &= (1 << (Nb & 7)) - 1;
+  }
+  return (OK);
+}
+#endif
+
+#if defined(MDB_FUNCTIONCODE_03) || defined(MDB_FUNCTIONCODE_04) || defined(MDB_FUNCTIONCODE_23)
+/**************************************************************************//**
+*   \brief      This function extracts register values from the response frame
+*               sent by a Modbus server (FC03, FC04, FC23)
+*   \ingroup Client  
+*   \param[in]  msg Pointer to a message which contains the response frame received from the network
+*   \param[out] Values Pointer to an array which will receive the register values
+*   \param[in]  Nb Number of registers read by the request
+*   \param[in]  Context Pointer to the CRC16 context of the received frame
+*               or 0 to compute the CRC16 of the frame
+*   \return     OK if the register values have been extracted
+*   \return     NOK otherwise (i.e. device type is not a client, CRC16 error, Modbus exception,
+*               unexpected function code or byte count)
+******************************************************************************/
+t_status Modbus_RTU::Client_DecodeRegisters(Modbus_View* msg, unsigned short* Values, int Nb, Modbus_CRC16Context* Context)
+{
+  if ((Mdb_Type != MDB_CLIENT) || (Modbus_ResponseByteCount(msg, Context) != Nb * 2)
+      || ((msg->data[1] != MDB_FC03) && (msg->data[1] != MDB_FC04) && (msg->data[1] != MDB_FC23)))
+  {
+    return (NOK);
+  }
+
+  Modbus_GetRegisters(&msg->data[3], Values, Nb);
+  return (OK);
+}
+
+/**************************************************************************//**
+*   \brief      This function extracts scattered values from the response frame
+*               sent by a Modbus server (FC03, FC04, FC23)
+*
+*               No value is extracted unless all tags are inside the response.
+*   \ingroup Client  
+*   \param[in]  msg Pointer to a message which contains the response frame received from the network
+*   \param[in]  Tags Pointer to an array of tags (register offset in the response, type and variable)
+*   \param[in]  Nb Number of tags
+*   \param[in]  Context Pointer to the CRC16 context of the received frame
+*               or 0 to compute the CRC16 of the frame
+*   \return     OK if the values have been extracted
+*   \return     NOK otherwise (i.e. device type is not a client, CRC16 error, Modbus exception,
+*               unexpected function code, tag type or tag out of the response)
+******************************************************************************/
+t_status Modbus_RTU::Client_DecodeTags(Modbus_View* msg, const Modbus_Tag* Tags, int Nb, Modbus_CRC16Context* Context)
+{
+  int ByteCount = Modbus_ResponseByteCount(msg, Context);
+  int Size;
+  char* src;
+  uint32_t Bits;
+  int i;
+
+  if ((Mdb_Type != MDB_CLIENT) || (ByteCount < 0)
+      || ((msg->data[1] != MDB_FC03) && (msg->data[1] != MDB_FC04) && (msg->data[1] != MDB_FC23)))
+  {
+    return (NOK);
+  }
+
+  // Check all tags first
+  for (i = 0; i < Nb; i++)
+  {
+    Size = (Tags[i].Type >= MDB_TAG_UINT32) ? 2 : 1;
+    if ((Tags[i].Type > MDB_TAG_FLOAT) || ((Tags[i].Offset + Size) * 2 > ByteCount))
+    {
+      return (NOK);
+    }
+  }
+
+  // Then extract them
+  for (i = 0; i < Nb; i++)
+  {
+    src = &msg->data[3 + Tags[i].Offset * 2];
+    switch (Tags[i].Type)
+    {
+      case MDB_TAG_UINT16:
+          *(unsigned short*)Tags[i].Value = GET_WORD(src);
+          break;
+      case MDB_TAG_INT16:
+          *(short*)Tags[i].Value = (short)GET_WORD(src);
+          break;
+      case MDB_TAG_UINT32:
+          *(uint32_t*)Tags[i].Value = ((uint32_t)GET_WORD(src) << 16) | GET_WORD(src + 2);
+          break;
+      case MDB_TAG_INT32:
+          *(int32_t*)Tags[i].Value = (int32_t)(((uint32_t)GET_WORD(src) << 16) | GET_WORD(src + 2));
+          break;
+      case MDB_TAG_FLOAT:
+          Bits = ((uint32_t)GET_WORD(src) << 16) | GET_WORD(src + 2);
+          memcpy(Tags[i].Value, &Bits, sizeof(float));
+          break;
+    }
+  }
+  return (OK);
+}
+#endif
+
+// Class Interface : Modbus_Frame /////////////////////////////////////////////
+/**************************************************************************//**
+*   \brief      This function provides a view of the buffer of a Modbus_Frame
+*   \param[in]  msg Pointer to the frame
+*   \return     View of the frame
+******************************************************************************/
+static Modbus_View Modbus_FrameView(Modbus_Frame* msg)
+{
+  Modbus_View View;
+
+  View.data = msg->data;
+  View.length = msg->length;
+  View.size = MDB_MSG_LENGTH_MAX;
+  return (View);
+}
+
+/**************************************************************************//**
+*   \brief      See GetCRC16(Modbus_View*, unsigned short*), for a frame stored in a Modbus_Frame
+*   \ingroup Device
+******************************************************************************/
+t_status Modbus_RTU::GetCRC16(Modbus_Frame* msg, unsigned short* Value)
+{
+  Modbus_View View = Modbus_FrameView(msg);
+  t_status Status = GetCRC16(&View, Value);
+
+  msg->length = View.length;
+  return (Status);
+}
+
+/**************************************************************************//**
+*   \brief      See Server_Update(Modbus_View*), for a frame stored in a Modbus_Frame
+*   \ingroup Server
+******************************************************************************/
+t_status Modbus_RTU::Server_Update(Modbus_Frame* msg)
+{
+  Modbus_View View = Modbus_FrameView(msg);
+  t_status Status = Server_Update(&View, 0);
+
+  msg->length = View.length;
+  return (Status);
+}
+
+/**************************************************************************//**
+*   \brief      See Server_Update(Modbus_View*, Modbus_CRC16Context*), for a frame stored in a Modbus_Frame
+*   \ingroup Server
+******************************************************************************/
+t_status Modbus_RTU::Server_Update(Modbus_Frame* msg, Modbus_CRC16Context* Context)
+{
+  Modbus_View View = Modbus_FrameView(msg);
+  t_status Status = Server_Update(&View, Context);
+
+  msg->length = View.length;
+  return (Status);
+}
+
+#if defined(MDB_FUNCTIONCODE_01)
+/**************************************************************************//**
+*   \brief      See Client_ReadCoils(int, unsigned short, int, Modbus_View*), for a frame stored in a Modbus_Frame
+*   \ingroup Client
+******************************************************************************/
+t_status Modbus_RTU::Client_ReadCoils(int ServerAddr, unsigned short Addr, int Nb, Modbus_Frame* msg)
+{
+  Modbus_View View = Modbus_FrameView(msg);
+  t_status Status = Client_ReadCoils(ServerAddr, Addr, Nb, &View);
+
+  msg->length = View.length;
+  return (Status);
+}
+#endif
+
+#if defined(MDB_FUNCTIONCODE_02)
+/**************************************************************************//**
+*   \brief      See Client_ReadDiscreteInputs(int, unsigned short, int, Modbus_View*), for a frame stored in a Modbus_Frame
+*   \ingroup Client
+******************************************************************************/
+t_status Modbus_RTU::Client_ReadDiscreteInputs(int ServerAddr, unsigned short Addr, int Nb, Modbus_Frame* msg)
+{
+  Modbus_View View = Modbus_FrameView(msg);
+  t_status Status = Client_ReadDiscreteInputs(ServerAddr, Addr, Nb, &View);
+
+  msg->length = View.length;
+  return (Status);
+}
+#endif
+
+#if defined(MDB_FUNCTIONCODE_03)
+/**************************************************************************//**
+*   \brief      See Client_ReadHoldingRegisters(int, unsigned short, int, Modbus_View*), for a frame stored in a Modbus_Frame
+*   \ingroup Client
+******************************************************************************/
+t_status Modbus_RTU::Client_ReadHoldingRegisters(int ServerAddr, unsigned short Addr, int Nb, Modbus_Frame* msg)
+{
+  Modbus_View View = Modbus_FrameView(msg);
+  t_status Status = Client_ReadHoldingRegisters(ServerAddr, Addr, Nb, &View);
+
+  msg->length = View.length;
+  return (Status);
+}
+#endif
+
+#if defined(MDB_FUNCTIONCODE_04)
+/**************************************************************************//**
+*   \brief      See Client_ReadInputRegisters(int, unsigned short, int, Modbus_View*), for a frame stored in a Modbus_Frame
+*   \ingroup Client
+******************************************************************************/
+t_status Modbus_RTU::Client_ReadInputRegisters(int ServerAddr, unsigned short Addr, int Nb, Modbus_Frame* msg)
+{
+  Modbus_View View = Modbus_FrameView(msg);
+  t_status Status = Client_ReadInputRegisters(ServerAddr, Addr, Nb, &View);
+
+  msg->length = View.length;
+  return (Status);
+}
+#endif
+
+#if defined(MDB_FUNCTIONCODE_05)
+/**************************************************************************//**
+*   \brief      See Client_WriteSingleCoil(int, unsigned short, int, Modbus_View*), for a frame stored in a Modbus_Frame
+*   \ingroup Client
+******************************************************************************/
+t_status Modbus_RTU::Client_WriteSingleCoil(int ServerAddr, unsigned short Addr, int Data, Modbus_Frame* msg)
+{
+  Modbus_View View = Modbus_FrameView(msg);
+  t_status Status = Client_WriteSingleCoil(ServerAddr, Addr, Data, &View);
+
+  msg->length = View.length;
+  return (Status);
+}
+#endif
+
+#if defined(MDB_FUNCTIONCODE_06)
+/**************************************************************************//**
+*   \brief      See Client_PresetSingleRegister(int, unsigned short, int, Modbus_View*), for a frame stored in a Modbus_Frame
+*   \ingroup Client
+******************************************************************************/
+t_status Modbus_RTU::Client_PresetSingleRegister(int ServerAddr, unsigned short Addr, int Data, Modbus_Frame* msg)
+{
+  Modbus_View View = Modbus_FrameView(msg);
+  t_status Status = Client_PresetSingleRegister(ServerAddr, Addr, Data, &View);
+
+  msg->length = View.length;
+  return (Status);
+}
+#endif
+
+#if defined(MDB_FUNCTIONCODE_07)
+/**************************************************************************//**
+*   \brief      See Client_ReadException(int, Modbus_View*), for a frame stored in a Modbus_Frame
+*   \ingroup Client
+******************************************************************************/
+t_status Modbus_RTU::Client_ReadException(int ServerAddr, Modbus_Frame* msg)
+{
+  Modbus_View View = Modbus_FrameView(msg);
+  t_status Status = Client_ReadException(ServerAddr, &View);
+
+  msg->length = View.length;
+  return (Status);
+}
+#endif
+
+#if defined(MDB_FUNCTIONCODE_08)
+/**************************************************************************//**
+*   \brief      See Client_ReadDiagnostic(int, t_diagtype, int, Modbus_View*), for a frame stored in a Modbus_Frame
+*   \ingroup Client
+******************************************************************************/
+t_status Modbus_RTU::Client_ReadDiagnostic(int ServerAddr, t_diagtype DiagType, int Data, Modbus_Frame* msg)
+{
+  Modbus_View View = Modbus_FrameView(msg);
+  t_status Status = Client_ReadDiagnostic(ServerAddr, DiagType, Data, &View);
+
+  msg->length = View.length;
+  return (Status);
+}
+#endif
+
+#if defined(MDB_FUNCTIONCODE_16)
+/**************************************************************************//**
+*   \brief      See Client_PresetMultipleRegisters(int, unsigned short, Modbus_Data*, Modbus_View*), for a frame stored in a Modbus_Frame
+*   \ingroup Client
+******************************************************************************/
+t_status Modbus_RTU::Client_PresetMultipleRegisters(int ServerAddr, unsigned short Addr, Modbus_Data* Data, Modbus_Frame* msg)
+{
+  Modbus_View View = Modbus_FrameView(msg);
+  t_status Status = Client_PresetMultipleRegisters(ServerAddr, Addr, Data, &View);
+
+  msg->length = View.length;
+  return (Status);
+}
+#endif
+
+#if defined(MDB_FUNCTIONCODE_23)
+/**************************************************************************//**
+*   \brief      See Client_ReadWriteMultipleRegisters(int, unsigned short, int, unsigned short, Modbus_Data*, Modbus_View*), for a frame stored in a Modbus_Frame
+*   \ingroup Client
+******************************************************************************/
+t_status Modbus_RTU::Client_ReadWriteMultipleRegisters(int ServerAddr, unsigned short rAddr, int rNb,unsigned short wAddr, Modbus_Data* Data, Modbus_Frame* msg)
+{
+  Modbus_View View = Modbus_FrameView(msg);
+  t_status Status = Client_ReadWriteMultipleRegisters(ServerAddr, rAddr, rNb, wAddr, Data, &View);
+
+  msg->length = View.length;
+  return (Status);
+}
+#endif
+
+/**************************************************************************//**
+*   \brief      See Client_Update(Modbus_View*, Modbus_Data*), for a frame stored in a Modbus_Frame
+*   \ingroup Client
+******************************************************************************/
+t_status Modbus_RTU::Client_Update(Modbus_Frame* msg, Modbus_Data* Data)
+{
+  Modbus_View View = Modbus_FrameView(msg);
+  t_status Status = Client_Update(&View, Data, 0);
+
+  msg->length = View.length;
+  return (Status);
+}
+
+/**************************************************************************//**
+*   \brief      See Client_Update(Modbus_View*, Modbus_Data*, Modbus_CRC16Context*), for a frame stored in a Modbus_Frame
+*   \ingroup Client
+******************************************************************************/
+t_status Modbus_RTU::Client_Update(Modbus_Frame* msg, Modbus_Data* Data, Modbus_CRC16Context* Context)
+{
+  Modbus_View View = Modbus_FrameView(msg);
+  t_status Status = Client_Update(&View, Data, Context);
+
+  msg->length = View.length;
+  return (Status);
+}
+
+#if defined(MDB_FUNCTIONCODE_01) || defined(MDB_FUNCTIONCODE_02) || defined(MDB_FUNCTIONCODE_03) || defined(MDB_FUNCTIONCODE_04)
+/**************************************************************************//**
+*   \brief      See Client_CheckResponse(const Modbus_Request*, Modbus_View*), for a frame stored in a Modbus_Frame
+*   \ingroup Client
+******************************************************************************/
+t_status Modbus_RTU::Client_CheckResponse(const Modbus_Request* Request, Modbus_Frame* msg)
+{
+  Modbus_View View = Modbus_FrameView(msg);
+
+  return (Client_CheckResponse(Request, &View));
+}
+#endif
+
+#if defined(MDB_FUNCTIONCODE_01) || defined(MDB_FUNCTIONCODE_02)
+/**************************************************************************//**
+*   \brief      See Client_DecodeBits(Modbus_View*, bool*, int, Modbus_CRC16Context*), for a frame stored in a Modbus_Frame
+*   \ingroup Client
+******************************************************************************/
+t_status Modbus_RTU::Client_DecodeBits(Modbus_Frame* msg, bool* Values, int Nb, Modbus_CRC16Context* Context)
+{
+  Modbus_View View = Modbus_FrameView(msg);
+
+  return (Client_DecodeBits(&View, Values, Nb, Context));
+}
+
+/**************************************************************************//**
+*   \brief      See Client_DecodeBitTable(Modbus_View*, unsigned char*, int, Modbus_CRC16Context*), for a frame stored in a Modbus_Frame
+*   \ingroup Client
+******************************************************************************/
+t_status Modbus_RTU::Client_DecodeBitTable(Modbus_Frame* msg, unsigned char* Table, int Nb, Modbus_CRC16Context* Context)
+{
+  Modbus_View View = Modbus_FrameView(msg);
+
+  return (Client_DecodeBitTable(&View, Table, Nb, Context));
+}
+#endif
+
+#if defined(MDB_FUNCTIONCODE_03) || defined(MDB_FUNCTIONCODE_04) || defined(MDB_FUNCTIONCODE_23)
+/**************************************************************************//**
+*   \brief      See Client_DecodeRegisters(Modbus_View*, unsigned short*, int, Modbus_CRC16Context*), for a frame stored in a Modbus_Frame
+*   \ingroup Client
+******************************************************************************/
+t_status Modbus_RTU::Client_DecodeRegisters(Modbus_Frame* msg, unsigned short* Values, int Nb, Modbus_CRC16Context* Context)
+{
+  Modbus_View View = Modbus_FrameView(msg);
+
+  return (Client_DecodeRegisters(&View, Values, Nb, Context));
+}
+
+/**************************************************************************//**
+*   \brief      See Client_DecodeTags(Modbus_View*, const Modbus_Tag*, int, Modbus_CRC16Context*), for a frame stored in a Modbus_Frame
+*   \ingroup Client
+******************************************************************************/
+t_status Modbus_RTU::Client_DecodeTags(Modbus_Frame* msg, const Modbus_Tag* Tags, int Nb, Modbus_CRC16Context* Context)
+{
+  Modbus_View View = Modbus_FrameView(msg);
+
+  return (Client_DecodeTags(&View, Tags, Nb, Context));
+}
+#endif
+
+//=============================================================================
+// Private functions
+//=============================================================================
+/**************************************************************************//**
+*   \brief      This function builds Modbus exception response frame
+*   \param[in]  Param Mosbus exception code
+*   \param[in,out] msg Pointer to a message that contains the Modbus frame sent by the Client 
+*                 and will receive the response frame to be returned to the Client
+*   \return     OK if the request frame has been successfuly generated
+*   \return     NOK if the request frame has not been generated (i.e. CRC16 error)
+******************************************************************************/
+t_status Modbus_Exception(int Param, Modbus_View* msg)
+{
+  t_status Status = OK;
+  unsigned short CRC16 = 0;
+  
+  // Build exception frame
+  msg->data[1] |= MDB_EXCEPTION_MASK; 
+  msg->data[2] = (char)Param;
+  msg->length = 5;
+  
+  // Add CRC16
+  Status = Modbus_CRC16(msg, &CRC16);
+  PUT_WORD(&msg->data[3], CRC16);
+    
+  return (Status);
+}
+
+#if defined(MDB_FUNCTIONCODE_01) || defined(MDB_FUNCTIONCODE_02) || defined(MDB_FUNCTIONCODE_03) || defined(MDB_FUNCTIONCODE_04) || defined(MDB_FUNCTIONCODE_23)
+/**************************************************************************//**
+*   \brief      This function checks the CRC16 and the byte count of a read response frame
+*   \param[in]  msg Pointer to a message which contains the response frame
+*   \param[in]  Context Pointer to the CRC16 context of the frame
+*               or 0 to compute the CRC16 of the frame
+*   \return     Byte count of the response if the CRC16 is correct and the data fill the frame
+*   \return     -1 otherwise
+******************************************************************************/
+int Modbus_ResponseByteCount(Modbus_View* msg, Modbus_CRC16Context* Context)
+{
+  Modbus_CRC16Context FrameContext;
+
+  if ((msg->length < 5) || (msg->length > msg->size) || ((unsigned char)msg->data[2] + 5 != msg->length))
+  {
+    return (-1);
+  }
+  if (Context == 0)
+  {
+    Modbus_CRC16Init(&FrameContext);
+    Modbus_CRC16UpdateBlock(&FrameContext, msg->data, msg->length);
+    Context = &FrameContext;
+  }
+  if (Modbus_CRC16Final(Context) != 0)
+  {
+    return (-1);
+  }
+  return ((unsigned char)msg->data[2]);
+}
+#endif
+
+/**************************************************************************//**
+*   \brief      This function computes Modbus CRC16
+*   \param[in] msg Pointer to a message that contains the Modbus frame
+*                (data + length including server node address and CRC16) 
+*   \param[out] Value Pointer to a variable that will receive the CRC16 value
+*   \return     OK if the CRC16 has been successfuly generated
+*   \return     NOK if the CRC16 has not been generated (i.e. frame length = 0)
+******************************************************************************/
+t_status Modbus_CRC16(Modbus_View* msg, unsigned short* Value)
+{
+  t_status Status = OK;
+  Modbus_CRC16Context Context;
+
+  if ((msg != 0) && (msg->length > 2))
+  {
+    // Remove CRC from the message length
+    Modbus_CRC16Init(&Context);
+    Modbus_CRC16UpdateBlock(&Context, msg->data, msg->length - 2);
+    *Value = Modbus_CRC16Final(&Context);
+  }
+  else
+  {
+    Status = NOK;
+  }
+  return (Status);
+}
+
+// Adds the CRC16 at the end of a response frame, unless the request came from Modbus TCP
+static void Modbus_PutCRC16(Modbus_View* msg, Modbus_Model* Model)
+{
+  unsigned short CRC16 = 0;
+
+  if (!Model->NoCRC16)
+  {
+    Modbus_CRC16(msg, &CRC16);
+    PUT_WORD(&msg->data[msg->length - 2], CRC16);
+  }
+}
+
+/**************************************************************************//**
+*   \brief      This function initializes a CRC16 context at the start of a frame
+*   \ingroup    CRC16
+*   \param[out] Context Pointer to the CRC16 context
+******************************************************************************/
+void Modbus_CRC16Init(Modbus_CRC16Context* Context)
+{
+  Context->lo = 0xFF;
+  Context->hi = 0xFF;
+}
+
+/**************************************************************************//**
+*   \brief      This function updates a CRC16 context with a received byte
+*
+*               This function can be called as each byte arrives, 
+*               e.g. from the serial reception interrupt.
+*   \ingroup    CRC16
+*   \param[in,out] Context Pointer to the CRC16 context
+*   \param[in]  Byte Received byte
+******************************************************************************/
+void Modbus_CRC16Update(Modbus_CRC16Context* Context, char Byte)
+{
+  unsigned char i;
+
+  i = Context->lo ^ Byte;
+#if (MDB_CRC_SLICING != 0)
+  Context->lo = Context->hi ^ (unsigned char)Modbus_CRC_table[0][i];
+  Context->hi = (unsigned char)(Modbus_CRC_table[0][i] >> 8);
+#else
+  Context->lo = Context->hi ^ Modbus_CRC_hi[i];
+  Context->hi = Modbus_CRC_lo[i];
+#endif
+}
+
+#if (MDB_CRC_SLICING != 0)
+// Updates the CRC16 register with MDB_CRC_SLICING bytes : the CRC register only overlaps the first 2 bytes
+static inline unsigned short Modbus_CRC16Step(unsigned short Crc, const unsigned char* p)
+{
+  unsigned short x = Crc ^ (unsigned short)(p[1] << 8 | p[0]);
+
+#if (MDB_CRC_SLICING == 8)
+  return (Modbus_CRC_table[7][x & 0xFF] ^ Modbus_CRC_table[6][x >> 8]
+        ^ Modbus_CRC_table[5][p[2]] ^ Modbus_CRC_table[4][p[3]]
+        ^ Modbus_CRC_table[3][p[4]] ^ Modbus_CRC_table[2][p[5]]
+        ^ Modbus_CRC_table[1][p[6]] ^ Modbus_CRC_table[0][p[7]]);
+#else
+  return (Modbus_CRC_table[3][x & 0xFF] ^ Modbus_CRC_table[2][x >> 8]
+        ^ Modbus_CRC_table[1][p[2]] ^ Modbus_CRC_table[0][p[3]]);
+#endif
+}
+
+/**************************************************************************//**
+*   \brief      This function computes the CRC16 of a block of bytes with the slicing-by-N tables
+*   \param[in]  Crc CRC16 register (reflected, low byte first)
+*   \param[in]  p Pointer to the bytes
+*   \param[in]  Length Number of bytes
+*   \return     Updated CRC16 register
+******************************************************************************/
+static unsigned short Modbus_CRC16Slice(unsigned short Crc, const unsigned char* p, int Length)
+{
+  while (Length >= MDB_CRC_SLICING)
+  {
+    Crc = Modbus_CRC16Step(Crc, p);
+    p += MDB_CRC_SLICING;
+    Length -= MDB_CRC_SLICING;
+  }
+
+  // Remaining bytes
+  while (Length-- > 0)
+  {
+    Crc = (Crc >> 8) ^ Modbus_CRC_table[0][(Crc ^ *p++) & 0xFF];
+  }
+  return (Crc);
+}
+#endif
+
+#if defined(MDB_CRC_CLMUL)
+// Folding constants : x^n mod P (P = x^16 + x^15 + x^2 + 1), bit-reflected in the upper 16 bits
+// of a 64-bit word. A 128-bit block is folded over 128 bits (n = 191, 127) or 512 bits (n = 575, 511)
+#define MDB_CRC_K191 0xCCD0000000000000ULL
+#define MDB_CRC_K127 0xC100000000000000ULL
+#define MDB_CRC_K575 0xC450000000000000ULL
+#define MDB_CRC_K511 0x8101000000000000ULL
+
+/**************************************************************************//**
+*   \brief      This function checks once if the CPU provides the carry-less multiplication
+*   \return     true if PCLMULQDQ (x86-64) or PMULL (AArch64) is available
+******************************************************************************/
+static bool Modbus_CRC16FoldAvailable(void)
+{
+#if defined(__x86_64__)
+  static const bool Available = (__builtin_cpu_init(), __builtin_cpu_supports("pclmul") != 0);
+#else
+  static const bool Available = ((getauxval(AT_HWCAP) & HWCAP_PMULL) != 0);
+#endif
+  return (Available);
+}
+
+#if defined(__x86_64__)
+// Folds the 128-bit block X over the distance given by K (low word of X by K low word, high word by K high word)
+#define MDB_CRC_FOLD(X, K) _mm_xor_si128(_mm_clmulepi64_si128((X), (K), 0x00), _mm_clmulepi64_si128((X), (K), 0x11))
+
+/**************************************************************************//**
+*   \brief      This function computes the CRC16 of a block of bytes by folding 
+*               128-bit blocks with carry-less multiplications (PCLMULQDQ)
+*
+*               The blocks are reduced to a single 128-bit block with the same 
+*               remainder modulo P, whose CRC16 is then computed with the tables.
+*   \param[in]  Crc CRC16 register (reflected, low byte first)
+*   \param[in]  p Pointer to the bytes
+*   \param[in]  Length Number of bytes (multiple of 16, at least 64)
+*   \return     Updated CRC16 register
+******************************************************************************/
+__attribute__((target("pclmul,sse2")))
+static unsigned short Modbus_CRC16Fold(unsigned short Crc, const unsigned char* p, int Length)
+{
+  const __m128i K1 = _mm_set_epi64x((long long)MDB_CRC_K127, (long long)MDB_CRC_K191);
+  const __m128i K4 = _mm_set_epi64x((long long)MDB_CRC_K511, (long long)MDB_CRC_K575);
+  __m128i x0, x1, x2, x3;
+  unsigned char Block[16];
+
+  // The CRC register is added to the first 2 bytes, the blocks are then folded from a zero register
+  x0 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)p), _mm_cvtsi32_si128(Crc));
+  x1 = _mm_loadu_si128((const __m128i*)(p + 16));
+  x2 = _mm_loadu_si128((const __m128i*)(p + 32));
+  x3 = _mm_loadu_si128((const __m128i*)(p + 48));
+  p += 64;
+  Length -= 64;
+
+  // 4 blocks per step
+  while (Length >= 64)
+  {
+    x0 = _mm_xor_si128(MDB_CRC_FOLD(x0, K4), _mm_loadu_si128((const __m128i*)p));
+    x1 = _mm_xor_si128(MDB_CRC_FOLD(x1, K4), _mm_loadu_si128((const __m128i*)(p + 16)));
+    x2 = _mm_xor_si128(MDB_CRC_FOLD(x2, K4), _mm_loadu_si128((const __m128i*)(p + 32)));
+    x3 = _mm_xor_si128(MDB_CRC_FOLD(x3, K4), _mm_loadu_si128((const __m128i*)(p + 48)));
+    p += 64;
+    Length -= 64;
+  }
+
+  // Then 1 block per step
+  x0 = _mm_xor_si128(MDB_CRC_FOLD(x0, K1), x1);
+  x0 = _mm_xor_si128(MDB_CRC_FOLD(x0, K1), x2);
+  x0 = _mm_xor_si128(MDB_CRC_FOLD(x0, K1), x3);
+  while (Length >= 16)
+  {
+    x0 = _mm_xor_si128(MDB_CRC_FOLD(x0, K1), _mm_loadu_si128((const __m128i*)p));
+    p += 16;
+    Length -= 16;
+  }
+
+  _mm_storeu_si128((__m128i*)Block, x0);
+  return (Modbus_CRC16Slice(0, Block, 16));
+}
+#else
+// Folds the 128-bit block X over the distance given by K (low word of X by K low word, high word by K high word)
+#define MDB_CRC_FOLD(X, K) veorq_u64(                                                                     \
+  vreinterpretq_u64_p128(vmull_p64((poly64_t)vgetq_lane_u64((X), 0), (poly64_t)vgetq_lane_u64((K), 0))), \
+  vreinterpretq_u64_p128(vmull_p64((poly64_t)vgetq_lane_u64((X), 1), (poly64_t)vgetq_lane_u64((K), 1))))
+#define MDB_CRC_LOAD(p) vreinterpretq_u64_u8(vld1q_u8(p))
+
+/**************************************************************************//**
+*   \brief      This function computes the CRC16 of a block of bytes by folding 
+*               128-bit blocks with carry-less multiplications (PMULL)
+*
+*               The blocks are reduced to a single 128-bit block with the same 
+*               remainder modulo P, whose CRC16 is then computed with the tables.
+*   \param[in]  Crc CRC16 register (reflected, low byte first)
+*   \param[in]  p Pointer to the bytes
+*   \param[in]  Length Number of bytes (multiple of 16, at least 64)
+*   \return     Updated CRC16 register
+******************************************************************************/
+__attribute__((target("+crypto")))
+static unsigned short Modbus_CRC16Fold(unsigned short Crc, const unsigned char* p, int Length)
+{
+  const uint64x2_t K1 = vcombine_u64(vcreate_u64(MDB_CRC_K191), vcreate_u64(MDB_CRC_K127));
+  const uint64x2_t K4 = vcombine_u64(vcreate_u64(MDB_CRC_K575), vcreate_u64(MDB_CRC_K511));
+  uint64x2_t x0, x1, x2, x3;
+  unsigned char Block[16];
+
+  // The CRC register is added to the first 2 bytes, the blocks are then folded from a zero register
+  x0 = veorq_u64(MDB_CRC_LOAD(p), vcombine_u64(vcreate_u64(Crc), vcreate_u64(0)));
+  x1 = MDB_CRC_LOAD(p + 16);
+  x2 = MDB_CRC_LOAD(p + 32);
+  x3 = MDB_CRC_LOAD(p + 48);
+  p += 64;
+  Length -= 64;
+
+  // 4 blocks per step
+  while (Length >= 64)
+  {
+    x0 = veorq_u64(MDB_CRC_FOLD(x0, K4), MDB_CRC_LOAD(p));
+    x1 = veorq_u64(MDB_CRC_FOLD(x1, K4), MDB_CRC_LOAD(p + 16));
+    x2 = veorq_u64(MDB_CRC_FOLD(x2, K4), MDB_CRC_LOAD(p + 32));
+    x3 = veorq_u64(MDB_CRC_FOLD(x3, K4), MDB_CRC_LOAD(p + 48));
+    p += 64;
+    Length -= 64;
+  }
+
+  // Then 1 block per step
+  x0 = veorq_u64(MDB_CRC_FOLD(x0, K1), x1);
+  x0 = veorq_u64(MDB_CRC_FOLD(x0, K1), x2);
+  x0 = veorq_u64(MDB_CRC_FOLD(x0, K1), x3);
+  while (Length >= 16)
+  {
+    x0 = veorq_u64(MDB_CRC_FOLD(x0, K1), MDB_CRC_LOAD(p));
+    p += 16;
+    Length -= 16;
+  }
+
+  vst1q_u8(Block, vreinterpretq_u8_u64(x0));
+  return (Modbus_CRC16Slice(0, Block, 16));
+}
+#endif
+#endif
+
+/**************************************************************************//**
+*   \brief      This function updates a CRC16 context with a block of received bytes
+*   \ingroup    CRC16
+*   \param[in,out] Context Pointer to the CRC16 context
+*   \param[in]  Buffer Pointer to the received bytes
+*   \param[in]  Length Number of received bytes
+******************************************************************************/
+void Modbus_CRC16UpdateBlock(Modbus_CRC16Context* Context, const char* Buffer, int Length)
+{
+#if (MDB_CRC_SLICING != 0)
+  const unsigned char* p = (const unsigned char*)Buffer;
+  unsigned short Crc = (unsigned short)(Context->hi << 8 | Context->lo);
+  int Folded;
+
+#if defined(MDB_CRC_CLMUL)
+  if ((Length >= MDB_CRC_CLMUL_MIN) && Modbus_CRC16FoldAvailable())
+  {
+    Folded = Length & ~15;
+    Crc = Modbus_CRC16Fold(Crc, p, Folded);
+    p += Folded;
+    Length -= Folded;
+  }
+#endif
+  Crc = Modbus_CRC16Slice(Crc, p, Length);
+  Context->lo = (unsigned char)Crc;
+  Context->hi = (unsigned char)(Crc >> 8);
+#else
+  unsigned char lo = Context->lo;
+  unsigned char hi = Context->hi;
+  unsigned char i;
+
+  while (Length-- > 0)
+  {
+    i = lo ^ *Buffer++;
+    lo = hi ^ Modbus_CRC_hi[i];
+    hi = Modbus_CRC_lo[i];
+  }
+  Context->lo = lo;
+  Context->hi = hi;
+#endif
+}
+
+/**************************************************************************//**
+*   \brief      This function provides the CRC16 of the bytes given to a CRC16 context
+*
+*               When the context has been updated with a whole frame, CRC16 included, 
+*               the result is 0 if the CRC16 of the frame is correct.
+*   \ingroup    CRC16
+*   \param[in]  Context Pointer to the CRC16 context
+*   \return     CRC16 value, high byte first as it is sent in the frame (PUT_WORD)
+******************************************************************************/
+unsigned short Modbus_CRC16Final(Modbus_CRC16Context* Context)
+{
+  // note that the CRC16 register is byte swapped when it is sent
+  return ((unsigned short)(Context->lo << 8 | Context->hi));
+}
+
+/**************************************************************************//**
+*   \brief      This function checks the CRC16 of a frame (CRC16 included)
+*   \param[in]  msg Pointer to the frame
+*   \return     OK if the CRC16 of the frame is correct
+*   \return     NOK otherwise (i.e. frame too short)
+******************************************************************************/
+static inline t_status Modbus_CRC16CheckFrame(Modbus_Frame* msg)
+{
+  Modbus_CRC16Context Context;
+
+  if ((msg == 0) || (msg->length <= 2))
+  {
+    return (NOK);
+  }
+  Modbus_CRC16Init(&Context);
+  Modbus_CRC16UpdateBlock(&Context, msg->data, msg->length);
+  return ((Modbus_CRC16Final(&Context) == 0) ? OK : NOK);
+}
+
+/**************************************************************************//**
+*   \brief      This function checks the CRC16 of a batch of frames (CRC16 included)
+*
+*               The frames are independent, so their CRC16 computations overlap
+*               in the execution units of the processor.
+*   \ingroup    CRC16
+*   \param[in]  msg Array of pointers to the frames
+*   \param[in]  Nb Number of frames
+*   \param[out] Status Array which receives OK or NOK for each frame
+*   \return     OK if the CRC16 of all the frames is correct
+*   \return     NOK otherwise
+******************************************************************************/
+t_status Modbus_CRC16Check(Modbus_Frame** msg, int Nb, t_status* Status)
+{
+  t_status Result = OK;
+  int i;
+
+  for (i = 0; i < Nb; i++)
+  {
+    Status[i] = Modbus_CRC16CheckFrame(msg[i]);
+    if (Status[i] == NOK)
+    {
+      Result = NOK;
+    }
+  }
+  return (Result);
+}
+
+/**************************************************************************//**
+*   \brief      This function gives received bytes to a receiver
+*
+*   Bytes of a chunk are considered as received back to back, Time being the reception 
+*   time of the last one (micros() for instance). The silence before the chunk is 
+*   compared with t1.5 and t3.5 :
+*   - up to t1.5, the bytes are added to the frame being received (with its CRC16),
+*   - between t1.5 and t3.5, the frame is discarded up to the next t3.5 silence,
+*   - beyond t3.5, the previous frame is complete : the chunk is not taken, the frame 
+*     shall be processed and released (Modbus_ReceiverRelease) before giving it again.
+*
+*   Bytes already stored at the end of the frame in the receive buffer (e.g. by DMA) 
+*   are not copied.
+*   \param[in,out] Receiver Pointer to the receiver
+*   \param[in]  Data Pointer to the received bytes
+*   \param[in]  Length Number of received bytes
+*   \param[in]  Time Reception time of the last byte (s)
+*   \return     OK if the bytes have been taken
+*   \return     NOK if a complete frame shall be processed first (Modbus_ReceiverPoll is OK)
+******************************************************************************/
+t_status Modbus_ReceiverPut(Modbus_Receiver* Receiver, const char* Data, int Length, unsigned long Time)
+{
+  Modbus_View* Frame = &Receiver->Frame;
+  unsigned long Elapsed = Time - Receiver->LastTime;
+  unsigned long Busy = (unsigned long)Length * Receiver->CharTime;
+  unsigned long Silence = (Elapsed > Busy) ? Elapsed - Busy : 0;
+
+  if (Length <= 0)
+  {
+    return (OK);
+  }
+
+  switch (Receiver->State)
+  {
+    case MDB_RX_FRAME:
+        if (Silence > Receiver->FrameTimeout)
+        {
+          // End of the previous frame
+          Modbus_ReceiverPoll(Receiver, Receiver->LastTime + Receiver->FrameTimeout + 1);
+          if (Receiver->State == MDB_RX_READY)
+          {
+            return (NOK);
+          }
+        }
+        else if (Silence > Receiver->CharTimeout)
+        {
+          // Silence violation : the frame is discarded
+          Receiver->State = MDB_RX_ERROR;
+          Receiver->Errors++;
+        }
+        break;
+    case MDB_RX_ERROR:
+        if (Silence > Receiver->FrameTimeout)
+        {
+          Modbus_ReceiverRelease(Receiver);
+        }
+        break;
+    case MDB_RX_READY:
+        return (NOK);
+    default:
+        break;
+  }
+  Receiver->LastTime = Time;
+
+  if (Receiver->State == MDB_RX_IDLE)
+  {
+    Receiver->State = MDB_RX_FRAME;
+  }
+  if (Receiver->State == MDB_RX_FRAME)
+  {
+    if (Frame->length + Length > Frame->size)
+    {
+      // Frame longer than the receive buffer : it is discarded
+      Receiver->State = MDB_RX_ERROR;
+      Receiver->Errors++;
+    }
+    else
+    {
+      if (Data != Frame->data + Frame->length)
+      {
+        memcpy(Frame->data + Frame->length, Data, Length);
+      }
+      Modbus_CRC16UpdateBlock(&Receiver->Context, Frame->data + Frame->length, Length);
+      Frame->length += Length;
+    }
+  }
+  return (OK);
+}
+
+/**************************************************************************//**
+*   \brief      This function checks whether a complete frame is available in a receiver
+*
+*   A frame is complete after a t3.5 silence. Frames shorter than MDB_MSG_LENGTH_MIN 
+*   are discarded.
+*   \param[in,out] Receiver Pointer to the receiver
+*   \param[in]  Now Current time (s)
+*   \return     OK if a complete frame is available in Receiver->Frame 
+*               (CRC16 context in Receiver->Context)
+*   \return     NOK otherwise
+******************************************************************************/
+t_status Modbus_ReceiverPoll(Modbus_Receiver* Receiver, unsigned long Now)
+{
+  if ((Receiver->State != MDB_RX_READY) && (Receiver->State != MDB_RX_IDLE)
+      && (Now - Receiver->LastTime > Receiver->FrameTimeout))
+  {
+    if ((Receiver->State == MDB_RX_FRAME) && (Receiver->Frame.length >= MDB_MSG_LENGTH_MIN))
+    {
+      Receiver->State = MDB_RX_READY;
+    }
+    else
+    {
+      if (Receiver->State == MDB_RX_FRAME)
+      {
+        Receiver->Errors++;
+      }
+      Modbus_ReceiverRelease(Receiver);
+    }
+  }
+  return ((Receiver->State == MDB_RX_READY) ? OK : NOK);
+}
+
+/**************************************************************************//**
+*   \brief      This function releases the frame of a receiver once it has been processed
+*               (the receive buffer is used for the next frame)
+*   \param[in,out] Receiver Pointer to the receiver
+******************************************************************************/
+void Modbus_ReceiverRelease(Modbus_Receiver* Receiver)
+{
+  Receiver->Frame.length = 0;
+  Modbus_CRC16Init(&Receiver->Context);
+  Receiver->State = MDB_RX_IDLE;
+}
+
+// CRC16 shift table : x^(8.2^i) mod P (reflected), shifts a CRC over 2^i zero bytes
+static const unsigned short Modbus_CRC_shift[8] =
+{
+  0x0080, 0xA001, 0xE801, 0xC881, 0x6080, 0x8801, 0xE081, 0x6800
+};
+
+/**************************************************************************//**
+*   \brief      This function computes the change of the CRC16 of a frame when a register 
+*               of the frame changes
+*
+*               CRC16 is linear : the CRC16 of the new frame is the CRC16 of the old frame 
+*               XORed with the CRC16 (without initial value) of the difference between both frames, 
+*               which only contains the two bytes of the register followed by zero bytes.
+*   \param[in]  Delta Old value XOR new value of the register
+*   \param[in]  Nb Number of bytes between the register and the CRC16 of the frame (0 to 255)
+*   \return     Value to XOR with the CRC16 of the frame (low byte first, as sent in the frame)
+******************************************************************************/
+unsigned short Modbus_CRC16Delta(unsigned short Delta, int Nb)
+{
+  unsigned short Crc;
+  unsigned short Product;
+  int i, j;
+
+  // CRC16 of the two bytes of the register, without initial value
+  Crc = Delta >> 8;
+  for (i = 0; i < 16; i++)
+  {
+    if (i == 8)
+    {
+      Crc ^= Delta & 0xFF;
+    }
+    Crc = (Crc & 1) ? (Crc >> 1) ^ 0xA001 : (Crc >> 1);
+  }
+
+  // Shift over the zero bytes : Crc = Crc * x^(8.Nb) mod P
+  for (i = 0; i < 8; i++)
+  {
+    if (Nb & (1 << i))
+    {
+      Product = 0;
+      for (j = 0; j < 16; j++)
+      {
+        Product = (Product & 1) ? (Product >> 1) ^ 0xA001 : (Product >> 1);
+        if (Modbus_CRC_shift[i] & (1 << j))
+        {
+          Product ^= Crc;
+        }
+      }
+      Crc = Product;
+    }
+  }
+  return (Crc);
+}
+
+/**************************************************************************//**
+*   \brief      This function checks that a list of ranges can be used as a register map
+*   \param[in] Ranges Pointer to the list of ranges
+*   \param[in] Nb Number of ranges in the list
+*   \return     OK if ranges are sorted by increasing address and don't overlap
+*   \return     NOK if ranges can't be used as a register map
+******************************************************************************/
+t_status Modbus_CheckMap(const Modbus_Range* Ranges, unsigned short Nb)
+{
+  t_status Status = OK;
+  unsigned long NextAddr = 0;
+  unsigned short i;
+
+  for (i = 0; (Ranges != 0) && (i < Nb); i++)
+  {
+    if ((Ranges[i].Addr < NextAddr) || (Ranges[i].Nb == 0))
+    {
+      Status = NOK;
+    }
+    NextAddr = (unsigned long)Ranges[i].Addr + Ranges[i].Nb;
+    if (NextAddr > 0x10000)
+    {
+      Status = NOK;
+    }
+  }
+  return (Status);
+}
+
+/**************************************************************************//**
+*   \brief      This function frees all entries of a response cache
+*   \param[in]  Cache Pointer to the response cache
+******************************************************************************/
+void Modbus_CacheClear(Modbus_Cache* Cache)
+{
+  unsigned short i;
+
+  for (i = 0; i < Cache->Nb; i++)
+  {
+    Cache->Entries[i].Nb = 0;
+  }
+  Cache->Next = 0;
+}
+
+#if defined(MDB_FUNCTIONCODE_03) || defined(MDB_FUNCTIONCODE_04)
+/**************************************************************************//**
+*   \brief      This function looks for the response to a FC03 or FC04 request in a response cache
+*
+*               A response built before the last write of the registers is updated first.
+*   \param[in]  Cache Pointer to the response cache
+*   \param[in,out] msg Pointer to the request frame, which receives the response frame if found
+*   \param[in]  Addr Address of the first register of the request
+*   \param[in]  Nb Number of registers of the request
+*   \param[in]  Sequence Sequence number of the register writes returned by Modbus_ReadBegin
+*   \param[in]  NoCRC16 true if the response is built without CRC16 (Server_UpdateTCP) :
+*               the CRC16 of the cached response is not copied
+*   \return     OK if the response has been found
+*   \return     NOK if the response is not in the cache
+******************************************************************************/
+t_status Modbus_CacheRead(Modbus_Cache* Cache, Modbus_View* msg, unsigned short Addr, int Nb, unsigned int Sequence, bool NoCRC16)
+{
+  Modbus_CacheEntry* Entry;
+  unsigned short i;
+
+  for (i = 0; i < Cache->Nb; i++)
+  {
+    Entry = &Cache->Entries[i];
+    if ((Entry->Nb == Nb) && (Entry->Addr == Addr) &&
+        (Entry->Response.data[0] == msg->data[0]) && (Entry->Response.data[1] == msg->data[1]))
+    {
+      if (Entry->Sequence != Sequence)
+      {
+        Modbus_CacheUpdate(Entry);
+        Entry->Sequence = Sequence;
+      }
+      msg->length = Entry->Response.length;
+      memcpy(msg->data, Entry->Response.data, NoCRC16 ? 3 + 2 * Nb : 3 + 2 * Nb + 2);
+      return (OK);
+    }
+  }
+  return (NOK);
+}
+
+/**************************************************************************//**
+*   \brief      This function stores the response to a FC03 or FC04 request in a response cache
+*
+*               The response is only stored if all its registers are stored in a single memory range, 
+*               the oldest entry is replaced. The writers of the registers are not held up : the response 
+*               is updated when it is read again if the registers have been written since Sequence.
+*   \param[in]  Cache Pointer to the response cache
+*   \param[in]  Map Pointer to the register map which contains the registers
+*   \param[in]  msg Pointer to the response frame
+*   \param[in]  Addr Address of the first register of the response
+*   \param[in]  Nb Number of registers of the response
+*   \param[in]  Sequence Sequence number of the register writes when the registers have been read
+******************************************************************************/
+void Modbus_CacheStore(Modbus_Cache* Cache, Modbus_Map* Map, Modbus_View* msg, unsigned short Addr, int Nb, unsigned int Sequence)
+{
+  Modbus_CacheEntry* Entry;
+  const Modbus_Range* Range;
+
+  if ((Cache->Nb != 0) && (Map->Nb != 0))
+  {
+    Range = Modbus_MapFind(Map, Addr);
+    if ((Range != 0) && (Range->data != 0) && IN_TABLE(*Range, Addr, Nb))
+    {
+      Entry = &Cache->Entries[Cache->Next];
+      Entry->Addr = Addr;
+      Entry->Nb = Nb;
+      Entry->data = Range->data + (Addr - Range->Addr);
+      Entry->Sequence = Sequence;
+      Entry->Response.length = msg->length;
+      memcpy(Entry->Response.data, msg->data, 3 + 2 * Nb + 2);
+      Cache->Next = (Cache->Next + 1 < Cache->Nb) ? Cache->Next + 1 : 0;
+    }
+  }
+}
+#endif
+
+/**************************************************************************//**
+*   \brief      This function updates a cached response with the current values of its registers
+*
+*               The values are read from memory, only the changed bytes of the response
+*               are patched and its CRC16 is updated incrementally.
+*   \param[in,out] Entry Pointer to the cache entry
+******************************************************************************/
+void Modbus_CacheUpdate(Modbus_CacheEntry* Entry)
+{
+  unsigned short Old, New;
+  unsigned short CRC16 = 0;
+  unsigned short Reg;
+  char* p;
+
+  for (Reg = 0; Reg < Entry->Nb; Reg++)
+  {
+    p = &Entry->Response.data[3 + 2 * Reg];
+    Old = GET_WORD(p);
+    New = Entry->data[Reg];
+    if (Old != New)
+    {
+      PUT_WORD(p, New);
+      CRC16 ^= Modbus_CRC16Delta(Old ^ New, 2 * (Entry->Nb - Reg - 1));
+    }
+  }
+
+  // Patch the CRC16 of the response (low byte first)
+  p = &Entry->Response.data[3 + 2 * Entry->Nb];
+  p[0] ^= CRC16 & 0xFF;
+  p[1] ^= CRC16 >> 8;
+}
+
+/**************************************************************************//**
+*   \brief      This function starts a read of the registers of a data model
+*
+*               The registers are read consistently (sequence lock) : the read shall be done again 
+*               while Modbus_ReadRetry is OK. The writer is never blocked by the reader.
+*   \param[in]  Model Pointer to the data model of the server
+*   \return     Sequence number of the register writes to give to Modbus_ReadRetry
+******************************************************************************/
+unsigned int Modbus_ReadBegin(Modbus_Model* Model)
+{
+  unsigned int Sequence;
+
+#if defined(MDB_SEQLOCK)
+  // Wait for the end of the write in progress
+  do
+  {
+    Sequence = __atomic_load_n(&Model->Sequence, __ATOMIC_ACQUIRE);
+  }
+  while (Sequence & 1);
+#else
+  Sequence = Model->Sequence;
+#endif
+  return (Sequence);
+}
+
+/**************************************************************************//**
+*   \brief      This function checks if the registers read since Modbus_ReadBegin have been written meanwhile
+*   \param[in]  Model Pointer to the data model of the server
+*   \param[in]  Sequence Sequence number returned by Modbus_ReadBegin
+*   \return     OK if the registers shall be read again
+*   \return     NOK if the registers have been read consistently
+******************************************************************************/
+t_status Modbus_ReadRetry(Modbus_Model* Model, unsigned int Sequence)
+{
+  t_status Status = NOK;
+
+#if defined(MDB_SEQLOCK)
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  if (__atomic_load_n(&Model->Sequence, __ATOMIC_RELAXED) != Sequence)
+  {
+    Status = OK;
+  }
+#endif
+  return (Status);
+}
+
+/**************************************************************************//**
+*   \brief      This function starts a write of the registers of a data model
+*
+*               Only one writer at a time : a second writer waits for Modbus_WriteEnd, so the 
+*               write shall only copy values in memory (no handler call, no I/O).
+*   \param[in]  Model Pointer to the data model of the server
+*   \return     Sequence number of the register writes before this write
+******************************************************************************/
+unsigned int Modbus_WriteBegin(Modbus_Model* Model)
+{
+  unsigned int Sequence;
+
+#if defined(MDB_SEQLOCK)
+  // Make the sequence number odd, once the write in progress (if any) is over
+  do
+  {
+    Sequence = __atomic_load_n(&Model->Sequence, __ATOMIC_RELAXED) & ~1U;
+  }
+  while (!__atomic_compare_exchange_n(&Model->Sequence, &Sequence, Sequence + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+#else
+  Sequence = Model->Sequence++;
+#endif
+  return (Sequence);
+}
+
+/**************************************************************************//**
+*   \brief      This function ends a write of the registers of a data model
+*   \param[in]  Model Pointer to the data model of the server
+******************************************************************************/
+void Modbus_WriteEnd(Modbus_Model* Model)
+{
+#if defined(MDB_SEQLOCK)
+  __atomic_store_n(&Model->Sequence, Model->Sequence + 1, __ATOMIC_RELEASE);
+#else
+  Model->Sequence++;
+#endif
+}
+
+/**************************************************************************//**
+*   \brief      This function builds the response frame to a request with the handler
+*               of its function code
+*   \param[in,out] msg Pointer to a message that contains the Modbus frame received from the client
+*                 and will receive the response frame to be sent
+*   \param[in]  Model Pointer to the data model which serves the request
+*   \return     OK if the response frame has been generated (exception response included)
+*   \return     NOK if the request frame has not the length of its function code (frame unchanged)
+******************************************************************************/
+t_status Modbus_ServeRequest(Modbus_View* msg, Modbus_Model* Model)
+{
+  t_status Status;
+
+  // Check function code
+  switch (msg->data[1])
+  {
+#if defined(MDB_FUNCTIONCODE_01)
+    case MDB_FC01: //Read Coils
+        Status = Modbus_ReadCoils (msg, Model);
+        break;
+#endif
+#if defined(MDB_FUNCTIONCODE_02)
+    case MDB_FC02: //Read Discrete Inputs
+        Status = Modbus_ReadDiscreteInputs (msg, Model);
+        break;
+#endif
+#if defined(MDB_FUNCTIONCODE_03)
+    case MDB_FC03: //Read Holding Registers
+        Status = Modbus_ReadHoldingRegisters (msg, Model);
+        break;
+#endif
+#if defined(MDB_FUNCTIONCODE_04)
+    case MDB_FC04: //Read Input Registers
+        Status = Modbus_ReadInputRegisters (msg, Model);
+        break;
+#endif
+#if defined(MDB_FUNCTIONCODE_05)
+    case MDB_FC05: //Write Single coil
+        Status = Modbus_WriteSingleCoil (msg, Model);
+        break;
+#endif
+#if defined(MDB_FUNCTIONCODE_06)
+    case MDB_FC06: //Preset Single Register
+        Status = Modbus_PresetSingleRegister (msg, Model);
+        break;
+#endif
+#if defined(MDB_FUNCTIONCODE_07)
+    case MDB_FC07: //Read Exception Status
+        Status = Modbus_ReadExceptionStatus (msg, Model);
+        break;
+#endif
+#if defined(MDB_FUNCTIONCODE_08)
+    case MDB_FC08: //Read Exception Status
+        Status = Modbus_ReadDiagnostic (msg, Model);
+        break;
+#endif
+#if defined(MDB_FUNCTIONCODE_16)
+    case MDB_FC16: //Preset Multiple Registers
+        Status = Modbus_PresetMultipleRegisters (msg, Model);
+        break;
+#endif
+#if defined(MDB_FUNCTIONCODE_23)
+    case MDB_FC23: //Read/Write Multiple Registers
+        Status = Modbus_ReadWriteMultipleRegisters (msg, Model);
+        break;
+#endif
+    default:
+        Modbus_Exception(MDB_EXCEPTION_ILLEGAL_FUNCTION, msg);
+        Status = OK;
+        break;
+  }
+  return (Status);
+}
+
+// Response management function
+#if defined(MDB_FUNCTIONCODE_01)
+/**************************************************************************//**
+*   \brief      This function builds the response frame to a FC01 command
+*   \param[in,out] msg Pointer to a message that contains the Modbus frame received from the client
+*                 and will receive the response frame to sent
+*                (data + length including Server node address and CRC16) 
+*   \return     OK if the frame has been successfuly generated
+*   \return     NOK if the frame has not been generated 
+******************************************************************************/
+t_status Modbus_ReadCoils(Modbus_View* msg, Modbus_Model* Model)
+{
+  t_status Status;
+  
+  unsigned short CoilAddress;
+  unsigned short CoilNb;
+  int NbByte;
+
+  
+  // Check if Request frame length is correct
+  if (msg->length == 8)
+  {
+    // Extract the request data
+    CoilAddress = GET_WORD(&msg->data[2]);
+    CoilNb = GET_WORD(&msg->data[4]);
+    
+    // Check if data are correct
+    if ((CoilAddress < 0) || 
+        (CoilAddress > 0xFFFF - CoilNb + 1) || 
+        (CoilNb <= 0) || (CoilNb > MDB_INP_NUMBER_MAX))
+    {
+      Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_VALUE, msg);
+    }
+    else
+    {
+      // Read all the coils at once in the response frame
+      if (Modbus_ReadCoilBlock(Model, CoilAddress, CoilNb, msg->data + 3))
+      {
+        // Add nb of data bytes and frame length
+        NbByte = (CoilNb + 7) / 8;
+        msg->data[2] = NbByte;
+        msg->length = 3 + NbByte + 2;
+      
+        // Add CRC16
+        Modbus_PutCRC16(msg, Model);
+      }
+      else
+      {
+        // One of the coils is not available
+        Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_ADDRESS, msg);
+      }
+    }
+    Status = OK;
+  }
+  else
+  {
+    Status = NOK;
+  }
+  return (Status);
+}
+#endif
+
+#if defined(MDB_FUNCTIONCODE_02)
+/**************************************************************************//**
+*   \brief      This function builds the response frame to a FC02 command
+*   \param[in,out] msg Pointer to a message that contains the Modbus frame received from the client
+*                 and will receive the response frame to be sent
+*                (data + length including server node address and CRC16) 
+*   \return     OK if the frame has been successfuly generated
+*   \return     NOK if the frame has not been generated 
+******************************************************************************/
+t_status Modbus_ReadDiscreteInputs(Modbus_View* msg, Modbus_Model* Model)
+{
+  t_status Status;
+  
+  unsigned short InpAddress;
+  unsigned short InpNb;
+  int NbByte;
+
+  
+  // Check if Request frame length is correct
+  if (msg->length == 8)
+  {
+    // Extract the request data
+    InpAddress = GET_WORD(&msg->data[2]);
+    InpNb = GET_WORD(&msg->data[4]);
+    
+    // Check if data are correct
+    if ((InpAddress < 0) || 
+        (InpAddress > 0xFFFF - InpNb + 1) || 
+        (InpNb <= 0) || 
+        (InpNb > MDB_INP_NUMBER_MAX))
+    {
+      Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_VALUE, msg);
+    }
+    else
+    {
+      // Read all the inputs at once in the response frame
+      if (Modbus_ReadInputBlock(Model, InpAddress, InpNb, msg->data + 3))
+      {
+        // Add nb of data bytes and frame length
+        NbByte = (InpNb + 7) / 8;
+        msg->data[2] = NbByte;
+        msg->length = 3 + NbByte + 2;
+      
+        // Add CRC16
+        Modbus_PutCRC16(msg, Model);
+      }
+      else
+      {
+        // One of the inputs is not available
+        Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_ADDRESS, msg);
+      }
+    }
+    Status = OK;
+  }
+  else
+  {
+    Status = NOK;
+  }
+  return (Status);
+}
+#endif
+
+#if defined(MDB_FUNCTIONCODE_03)
+/**************************************************************************//**
+*   \brief      This function builds the response frame to a FC03 command
+*   \param[in,out] msg Pointer to a message that contains the Modbus frame received from the client
+*                 and will receive the response frame to be sent
+*                (data + length including server node address and CRC16) 
+*   \return     OK if the frame has been successfuly generated
+*   \return     NOK if the frame has not been generated 
+******************************************************************************/
+t_status Modbus_ReadHoldingRegisters(Modbus_View* msg, Modbus_Model* Model)
+{
+  t_status Status;
+  
+  unsigned short RegAddress;
+  unsigned short RegNb;
+  unsigned int Sequence;
+  t_status Cached, Read;
+
+  // Check if Request frame length is correct
+  if (msg->length == 8)
+  {
+    // Extract the request data
+    RegAddress = GET_WORD(&msg->data[2]);
+    RegNb = GET_WORD(&msg->data[4]);
+    
+    // Check if data are correct
+    if ((RegAddress < 0)  ||
+        (RegAddress > 0xFFFF-RegNb+1) ||
+        (RegNb <= 0)||(RegNb > MDB_REG_NUMBER_MAX))
+    {
+      Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_VALUE, msg);
+    }
+    else
+    {
+      // Look for the response in the cache or read the whole block of registers at once 
+      // in the response frame, again if they are written meanwhile
+      do
+      {
+        Sequence = Modbus_ReadBegin(Model);
+        Cached = Modbus_CacheRead(&Model->Cache, msg, RegAddress, RegNb, Sequence, Model->NoCRC16);
+        Read = Cached;
+        if (!Cached)
+        {
+          Read = Modbus_ReadRegisterBlock(Model, RegAddress, RegNb, msg->data + 3);
+        }
+      }
+      while (Modbus_ReadRetry(Model, Sequence));
+
+      if (Cached)
+      {
+        // The response has been found in the cache
+      }
+      else if (Read)
+      {
+        // Prepare response frame
+        msg->length = 3 + (RegNb * 2) + 2;    //Length of the response including CRC      
+        msg->data[2] = RegNb * 2;             //Number of data bytes
+
+        // Add CRC16
+        Modbus_PutCRC16(msg, Model);
+
+        // Keep the response for the next requests (only with its CRC16)
+        if (!Model->NoCRC16)
+        {
+          Modbus_CacheStore(&Model->Cache, &Model->HoldingRegisters, msg, RegAddress, RegNb, Sequence);
+        }
+      }
+      else
+      {
+        // One of the registers is not available
+        Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_ADDRESS, msg);
+      }
+    }
+    Status = OK;
+  }
+  else
+  {
+    Status = NOK;
+  }
+  return (Status);
+  }
+#endif
+  
+#if defined(MDB_FUNCTIONCODE_04)
+/**************************************************************************//**
+*   \brief      This function builds the response frame to a FC04 command
+*   \param[in,out] msg Pointer to a message that contains the Modbus frame received from the client
+*                 and will receive the response frame to be sent
+*                (data + length including server node address and CRC16) 
+*   \return     OK if the frame has been successfuly generated
+*   \return     NOK if the frame has not been generated 
+******************************************************************************/
+t_status Modbus_ReadInputRegisters(Modbus_View* msg, Modbus_Model* Model)
+{
+  t_status Status;
+  
+  unsigned short RegAddress;
+  unsigned short RegNb;
+  unsigned int Sequence;
+  t_status Cached, Read;
+
+  // Check if Request frame length is correct
+  if (msg->length == 8)
+  {
+    // Extract the request data
+    RegAddress = GET_WORD(&msg->data[2]);
+    RegNb = GET_WORD(&msg->data[4]);
+
+    // Check if data are correct
+    if ((RegAddress < 0)  ||
+        (RegAddress > 0xFFFF-RegNb+1) ||
+        (RegNb <= 0)||(RegNb > MDB_REG_NUMBER_MAX))
+    {
+      Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_VALUE, msg);
+    }
+    else
+    {
+      // Look for the response in the cache or read the whole block of input registers at once 
+      // in the response frame, again if they are written meanwhile
+      do
+      {
+        Sequence = Modbus_ReadBegin(Model);
+        Cached = Modbus_CacheRead(&Model->Cache, msg, RegAddress, RegNb, Sequence, Model->NoCRC16);
+        Read = Cached;
+        if (!Cached)
+        {
+          Read = Modbus_ReadInputRegisterBlock(Model, RegAddress, RegNb, msg->data + 3);
+        }
+      }
+      while (Modbus_ReadRetry(Model, Sequence));
+
+      if (Cached)
+      {
+        // The response has been found in the cache
+      }
+      else if (Read)
+      {
+        // Prepare response frame
+        msg->length = 3 + (RegNb * 2) + 2;    //Length of the response including CRC      
+        msg->data[2] = RegNb * 2;             //Number of data bytes
+
+        // Add CRC16
+        Modbus_PutCRC16(msg, Model);
+
+        // Keep the response for the next requests (only with its CRC16)
+        if (!Model->NoCRC16)
+        {
+          Modbus_CacheStore(&Model->Cache, &Model->InputRegisters, msg, RegAddress, RegNb, Sequence);
+        }
+      }
+      else
+      {
+        // One of the registers is not available
+        Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_ADDRESS, msg);
+      }
+    }
+    Status = OK;
+  }
+  else
+  {
+    Status = NOK;
+  }
+  return (Status);
+  }
+#endif
+
+#if defined(MDB_FUNCTIONCODE_05)
+/**************************************************************************//**
+*   \brief      This function builds the response frame to a FC05 command
+*   \param[in,out] msg Pointer to a message that contains the Modbus frame received from the client
+*                 and will receive the response frame to be sent
+*                (data + length including server node address and CRC16) 
+*   \return     OK if the frame has been successfuly generated
+*   \return     NOK if the frame has not been generated 
+******************************************************************************/
+t_status Modbus_WriteSingleCoil(Modbus_View* msg, Modbus_Model* Model)
+{
+  t_status Status;
+  
+  unsigned short CoilAddress;
+  int CoilValue;
+
+  // Check if Request frame length is correct
+  if (msg->length == 8)
+  {
+    // Extract the request data
+    CoilAddress = GET_WORD(&msg->data[2]);
+    CoilValue = GET_WORD(&msg->data[4]);
+    
+    // Check if data are correct
+    if ((CoilAddress < 0) ||
+        (CoilAddress > 0xFFFF) ||
+        ((CoilValue != 0) && (CoilValue != 0xFF)))
+    {
+      Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_VALUE, msg);
+    }
+    else
+    {
+      if (!Modbus_WriteCoil(Model, CoilAddress, &CoilValue))
+      {
+        // One of the registers is not available
+        Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_ADDRESS, msg);
+      }
     }
+    Status = OK;
   }
   else
   {
     Status = NOK;
   }
-    return(OK);
-}
-//#endif
+  return (Status);
+}  
+#endif
 
-//=============================================================================
-// Private functions
-//=============================================================================
+#if defined(MDB_FUNCTIONCODE_06)
 /**************************************************************************//**
-*   \brief      This function builds Modbus exception response frame
-*   \param[in]  Param Mosbus exception code
-*   \param[in,out] msg Pointer to a message that contains the Modbus frame sent by the Client 
-*                 and will receive the response frame to be returned to the Client
-*   \return     OK if the request frame has been successfuly generated
-*   \return     NOK if the request frame has not been generated (i.e. CRC16 error)
+*   \brief      This function builds the response frame to a FC06 command
+*   \param[in,out] msg Pointer to a message that contains the Modbus frame received from the client
+*                 and will receive the response frame to be sent
+*                (data + length including server node address and CRC16) 
+*   \return     OK if the frame has been successfuly generated
+*   \return     NOK if the frame has not been generated 
 ******************************************************************************/
-t_status Modbus_Exception(int Param, Modbus_Frame* msg)
+t_status Modbus_PresetSingleRegister(Modbus_View* msg, Modbus_Model* Model)
 {
-  t_status Status = OK;
-  unsigned short CRC16 = 0;
-  
-  // Build exception frame
-  msg->data[1] |= MDB_EXCEPTION_MASK; 
-  msg->data[2] = (char)Param;
-  msg->length = 5;
+  t_status Status;
   
-  // Add CRC16
-  Status = Modbus_CRC16(msg, &CRC16);
-  PUT_WORD(&msg->data[3], CRC16);
+  unsigned short RegAddress;
+
+  // Check if Request frame length is correct
+  if (msg->length == 8)
+  {
+    // Extract the request data
+    RegAddress = GET_WORD(&msg->data[2]);
     
+    // Check if data are correct
+    if ((RegAddress < 0) ||
+        (RegAddress > 0xFFFF))
+    {
+      Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_VALUE, msg);
+    }
+    else
+    {
+      if (!Modbus_WriteRegisterBlock(Model, RegAddress, 1, &msg->data[4]))
+      {
+        // One of the registers is not available
+        Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_ADDRESS, msg);
+      }
+    }
+    Status = OK;
+  }
+  else
+  {
+    Status = NOK;
+  }
   return (Status);
-}
+}  
+#endif
 
+#if defined(MDB_FUNCTIONCODE_07)
 /**************************************************************************//**
-*   \brief      This function computes Modbus CRC16
-*   \param[in] msg Pointer to a message that contains the Modbus frame
+*   \brief      This function builds the response frame to a FC07 command
+*   \param[in,out] msg Pointer to a message that contains the Modbus frame received from the client
+*                 and will receive the response frame to be sent
 *                (data + length including server node address and CRC16) 
-*   \param[out] Value Pointer to a variable that will receive the CRC16 value
-*   \return     OK if the CRC16 has been successfuly generated
-*   \return     NOK if the CRC16 has not been generated (i.e. frame length = 0)
+*   \return     OK if the frame has been successfuly generated
+*   \return     NOK if the frame has not been generated 
 ******************************************************************************/
-t_status Modbus_CRC16(Modbus_Frame* msg, unsigned short* Value)
+t_status Modbus_ReadExceptionStatus(Modbus_View* msg, Modbus_Model* Model)
 {
-  t_status Status = OK;
-   
-  unsigned short hi = 0x00FF;
-  unsigned short lo = 0x00FF;
-  unsigned char i;
-  char* buffer;
-  char tmp;
-  int length;
+  t_status Status;
+  
+  int ExceptionValue;
 
-  if ((msg != 0) && (msg->length > 2))
+  // Check if Request frame length is correct
+  if (msg->length == 4)
   {
-    // Remove CRC from the message length
-    length = msg->length - 2;
-    buffer = &msg->data[0];
-    while (length--)
+    if (Modbus_ReadException(Model, &ExceptionValue))
     {
-  tmp = *buffer;
-       i = lo ^ *buffer++;
-        lo = hi ^ Modbus_CRC_hi[i];
-        hi = Modbus_CRC_lo[i];
-   }
-
-    // note that, while the above loop computes the byte swapped CRC
-    // (e.g., lo is really hi and hi is really lo)
-    // we have to re-swap when assembling a 16-bit word on a little-endian CPU
-    *Value = (int)(lo << 8 | hi);
+      msg->length = 5;                //Length of the response including CRC      
+      msg->data[2] = ExceptionValue;  //Number of data bytes
+    }
+    else
+    {
+      // One of the registers is not available
+      Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_ADDRESS, msg);
+    }
+    // Add CRC16
+    Modbus_PutCRC16(msg, Model);
+    Status = OK;
   }
   else
   {
     Status = NOK;
   }
   return (Status);
-}
+}  
+#endif
 
-// Response management function
-#if defined(MDB_FUNCTIONCODE_01)
+#if defined(MDB_FUNCTIONCODE_08)
 /**************************************************************************//**
-*   \brief      This function builds the response frame to a FC01 command
+*   \brief      This function builds the response frame to a FC08 command
 *   \param[in,out] msg Pointer to a message that contains the Modbus frame received from the client
-*                 and will receive the response frame to sent
-*                (data + length including Server node address and CRC16) 
+*                 and will receive the response frame to be sent
+*                (data + length including server node address and CRC16) 
 *   \return     OK if the frame has been successfuly generated
 *   \return     NOK if the frame has not been generated 
 ******************************************************************************/
-t_status Modbus_ReadCoils(Modbus_Frame* msg)
+t_status Modbus_ReadDiagnostic (Modbus_View* msg, Modbus_Model* Model)
 {
   t_status Status;
   
-  unsigned short CoilAddress;
-  unsigned short CoilNb;
-  int CoilValue;
-  char* dest;
-  unsigned short CRC16 = 0;
-  char CoilByte = 0;
-  int IndCoil= 0;
-  int NbByte = 0;
+  unsigned short RegAddress;
+  unsigned short RegNb;
+  int RegValue;
+  char* src;
+
+  // Extract the request data
+  RegAddress = GET_WORD(&msg->data[2]);
+  RegNb = GET_WORD(&msg->data[4]);
 
-  
   // Check if Request frame length is correct
   if (msg->length == 8)
   {
-    // Extract the request data
-    CoilAddress = GET_WORD(&msg->data[2]);
-    CoilNb = GET_WORD(&msg->data[4]);
-    
     // Check if data are correct
-    if ((CoilAddress < 0) || 
-        (CoilAddress > 0xFFFF - CoilNb + 1) || 
-        (CoilNb <= 0) || (CoilNb > MDB_INP_NUMBER_MAX))
+    if ((RegAddress < 0) || 
+        (RegAddress > (0xFFFF - RegNb + 1)) || 
+        (RegNb <= 0) || (RegNb > (MDB_REG_NUMBER_MAX - 2)))
     {
       Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_VALUE, msg);
     }
     else
     {
-      // Prepare response frame
-      dest = msg->data + 3;
+      // Length of the response including CRC
+      msg->length = 8;
+
+      // Start of the register value list
+      src = msg->data + 7;
       
-      // loop on all inputs to read
-      while (CoilNb--)
+      // Loop on all register
+      while(RegNb--)
       {
-        // Check if register exists
-        if (Modbus_ReadCoil(CoilAddress, &CoilValue))
-        {
-          // Store value in the response frame
-          CoilByte |= CoilValue << IndCoil;
-          // prepare for next input
-          CoilAddress++;
-          IndCoil++;
-          if ((IndCoil == 8) ||(CoilNb == 0))
-          {
-            IndCoil = 0;
-            *dest = CoilByte;
-            CoilByte = 0;
-            dest+=1;
-            NbByte++;
-          }
-        }          
-        else
+        RegValue = GET_WORD(src);
+        if (!Modbus_WriteRegister(Model, RegAddress, &RegValue))
         {
           // One of the registers is not available
           Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_ADDRESS, msg);
-          CoilNb = 0;
         }
+        RegAddress++;
+        src += 2;
       }
-      // Add nb of data bytes and frame length
-      msg->data[2] = NbByte;
-      msg->length = 3 + NbByte + 2;
-      
       // Add CRC16
-      Modbus_CRC16 (msg, &CRC16);
-      PUT_WORD(dest, CRC16);
+      Modbus_PutCRC16(msg, Model);
     }
     Status = OK;
   }
@@ -1140,86 +3901,55 @@ t_status Modbus_ReadCoils(Modbus_Frame* msg)
     Status = NOK;
   }
   return (Status);
-}
+}  
 #endif
 
-#if defined(MDB_FUNCTIONCODE_02)
+#if defined(MDB_FUNCTIONCODE_16)
 /**************************************************************************//**
-*   \brief      This function builds the response frame to a FC02 command
+*   \brief      This function builds the response frame to a FC16 command
 *   \param[in,out] msg Pointer to a message that contains the Modbus frame received from the client
 *                 and will receive the response frame to be sent
 *                (data + length including server node address and CRC16) 
 *   \return     OK if the frame has been successfuly generated
 *   \return     NOK if the frame has not been generated 
 ******************************************************************************/
-t_status Modbus_ReadDiscreteInputs(Modbus_Frame* msg)
+t_status Modbus_PresetMultipleRegisters(Modbus_View* msg, Modbus_Model* Model)
 {
   t_status Status;
   
-  unsigned short InpAddress;
-  unsigned short InpNb;
-  int InpValue;
-  char* dest;
-  unsigned short CRC16 = 0;
-  char InpByte = 0;
-  int IndInput = 0;
-  int NbByte = 0;
+  unsigned short RegAddress;
+  unsigned short RegNb;
+
+  // Extract the request data
+  RegAddress = GET_WORD(&msg->data[2]);
+  RegNb = GET_WORD(&msg->data[4]);
 
-  
   // Check if Request frame length is correct
-  if (msg->length == 8)
+  if (msg->length == 7 + 2 * RegNb + 2)
   {
-    // Extract the request data
-    InpAddress = GET_WORD(&msg->data[2]);
-    InpNb = GET_WORD(&msg->data[4]);
-    
     // Check if data are correct
-    if ((InpAddress < 0) || 
-        (InpAddress > 0xFFFF - InpNb + 1) || 
-        (InpNb <= 0) || 
-        (InpNb > MDB_INP_NUMBER_MAX))
+    if ((RegAddress < 0) || 
+        (RegAddress > (0xFFFF - RegNb + 1)) || 
+        (RegNb <= 0) || (RegNb > (MDB_REG_NUMBER_MAX - 2)))
     {
       Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_VALUE, msg);
     }
     else
     {
-      // Prepare response frame
-      dest = msg->data + 3;
-      
-      // loop on all inputs to read
-      while (InpNb--)
+      // Write the whole block of registers at once from the request frame
+      if (Modbus_WriteRegisterBlock(Model, RegAddress, RegNb, msg->data + 7))
       {
-        // Check if register exists
-        if (Modbus_ReadInput(InpAddress, &InpValue))
-        {
-          // Store value in the response frame
-          InpByte |= InpValue << IndInput;
-          // prepare for next input
-          InpAddress++;
-          IndInput++;
-          if ((IndInput == 8) ||(InpNb == 0))
-          {
-            IndInput = 0;
-            *dest = InpByte;
-            InpByte = 0;
-            dest+=1;
-            NbByte++;
-          }
-        }          
-        else
-        {
-          // One of the registers is not available
-          Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_ADDRESS, msg);
-          InpNb = 0;
-        }
+        // Length of the response including CRC
+        msg->length = 8;
+
+        // Add CRC16
+        Modbus_PutCRC16(msg, Model);
+      }
+      else
+      {
+        // One of the registers is not available
+        Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_ADDRESS, msg);
       }
-      // Add nb of data bytes and frame length
-      msg->data[2] = NbByte;
-      msg->length = 3 + NbByte + 2;
-      
-      // Add CRC16
-      Modbus_CRC16 (msg, &CRC16);
-      PUT_WORD(dest, CRC16);
     }
     Status = OK;
   }
@@ -1228,71 +3958,90 @@ t_status Modbus_ReadDiscreteInputs(Modbus_Frame* msg)
     Status = NOK;
   }
   return (Status);
-}
+}  
 #endif
 
-#if defined(MDB_FUNCTIONCODE_03)
+#if defined(MDB_FUNCTIONCODE_23)
 /**************************************************************************//**
-*   \brief      This function builds the response frame to a FC03 command
+*   \brief      This function builds the response frame to a FC23 command
 *   \param[in,out] msg Pointer to a message that contains the Modbus frame received from the client
 *                 and will receive the response frame to be sent
-*                (data + length including server node address and CRC16) 
+*                (data + length including node address and CRC16) 
 *   \return     OK if the frame has been successfuly generated
 *   \return     NOK if the frame has not been generated 
 ******************************************************************************/
-t_status Modbus_ReadHoldingRegisters(Modbus_Frame* msg)
+t_status Modbus_ReadWriteMultipleRegisters(Modbus_View* msg, Modbus_Model* Model)
 {
   t_status Status;
   
-  unsigned short RegAddress;
-  unsigned short RegNb;
-  int RegValue;
-  char* dest;
-  unsigned short CRC16 = 0;
+  unsigned short rRegAddress, wRegAddress;
+  unsigned short rRegNb, wRegNb;
+  unsigned int Sequence;
+  t_status Read;
+
+  // Extract the request data
+  rRegAddress = GET_WORD(&msg->data[2]);
+  rRegNb = GET_WORD(&msg->data[4]);
+  wRegAddress = GET_WORD(&msg->data[6]);
+  wRegNb = GET_WORD(&msg->data[8]);
 
   // Check if Request frame length is correct
-  if (msg->length == 8)
+  if (msg->length == 11 + 2 * wRegNb + 2)
   {
-    // Extract the request data
-    RegAddress = GET_WORD(&msg->data[2]);
-    RegNb = GET_WORD(&msg->data[4]);
-    
     // Check if data are correct
-    if ((RegAddress < 0)  ||
-        (RegAddress > 0xFFFF-RegNb+1) ||
-        (RegNb <= 0)||(RegNb > MDB_REG_NUMBER_MAX))
+    if ((rRegAddress < 0) ||
+        (wRegAddress < 0) ||
+        (rRegAddress > (0xFFFF - rRegNb + 1)) || 
+        (wRegAddress > (0xFFFF - wRegNb + 1)) || 
+        (rRegNb <= 0) || (rRegNb > (MDB_REG_NUMBER_MAX - 2)) ||
+        (wRegNb <= 0) || (wRegNb > (MDB_REG_NUMBER_MAX_FC23 - 2)))
     {
       Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_VALUE, msg);
     }
     else
     {
-      // Prepare response frame
-      msg->length = 3 + (RegNb * 2) + 2;    //Length of the response including CRC      
-      msg->data[2] = RegNb * 2;             //Number of data bytes
-      dest = msg->data + 3;
-      
-      // loop on all registers to read
-      while (RegNb--)
+      // Check the block of registers to read before writing, so that nothing is written 
+      // if the request fails
+      if ((Model->HoldingRegisters.Nb != 0) && 
+          !Modbus_MapCheck(&Model->HoldingRegisters, rRegAddress, rRegNb, MDB_ACCESS_RO))
+      {
+        // One of the registers is not available
+        Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_ADDRESS, msg);
+        Read = NOK;
+      }
+      // Write the whole block of registers at once from the request frame
+      else if (!Modbus_WriteRegisterBlock(Model, wRegAddress, wRegNb, msg->data + 11))
+      {
+        // One of the registers is not available
+        Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_ADDRESS, msg);
+        Read = NOK;
+      }
+      else
       {
-        // Check if register exists
-        if (Modbus_ReadRegister(RegAddress, &RegValue))
+        // Read the whole block of registers at once in the response frame,
+        // again if they are written meanwhile
+        do
         {
-          // Store value in the response frame
-          PUT_WORD(dest, RegValue);
-          // Prepare data for next register
-          dest +=2;
-          RegAddress++;
+          Sequence = Modbus_ReadBegin(Model);
+          Read = Modbus_ReadRegisterBlock(Model, rRegAddress, rRegNb, msg->data + 3);
         }
-        else
+        while (Modbus_ReadRetry(Model, Sequence));
+
+        if (!Read)
         {
           // One of the registers is not available
           Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_ADDRESS, msg);
-          RegNb = 0;
         }
       }
-      // Add CRC16
-      Modbus_CRC16 (msg, &CRC16);
-      PUT_WORD(dest, CRC16);
+      if (Read)
+      {
+        // Prepare response frame
+        msg->length = 3 + (rRegNb * 2) + 2;   //Length of the response including CRC      
+        msg->data[2] = rRegNb * 2;            //Number of data bytes
+
+        // Add CRC16
+        Modbus_PutCRC16(msg, Model);
+      }
     }
     Status = OK;
   }
@@ -1301,585 +4050,742 @@ t_status Modbus_ReadHoldingRegisters(Modbus_Frame* msg)
     Status = NOK;
   }
   return (Status);
-  }
+}  
 #endif
-  
-#if defined(MDB_FUNCTIONCODE_04)
+
+//Object access functions
+#if defined(MDB_FUNCTIONCODE_01) || defined(MDB_FUNCTIONCODE_02)
 /**************************************************************************//**
-*   \brief      This function builds the response frame to a FC04 command
-*   \param[in,out] msg Pointer to a message that contains the Modbus frame received from the client
-*                 and will receive the response frame to be sent
-*                (data + length including server node address and CRC16) 
-*   \return     OK if the frame has been successfuly generated
-*   \return     NOK if the frame has not been generated 
+*   \brief      This function copies a block of bits from a bit table to a frame
+*
+*               Bytes are copied as is when the first bit is aligned on a byte boundary,
+*               otherwise they are shifted and merged a word (or a byte on AVR) at a time
+*   \param[out] dest Pointer to the first data byte in the frame
+*   \param[in] Table Pointer to the bit table (8 objects per byte, LSB first)
+*   \param[in] Offset Position of the first bit to copy in the table
+*   \param[in] Nb Number of bits to copy
 ******************************************************************************/
-t_status Modbus_ReadInputRegisters(Modbus_Frame* msg)
+void Modbus_CopyBits(char* dest, unsigned char* Table, unsigned short Offset, int Nb)
 {
-  t_status Status;
-  
-  unsigned short RegAddress;
-  unsigned short RegNb;
-  int RegValue;
-  char* dest;
-  unsigned short CRC16 = 0;
+  unsigned char* src = Table + (Offset >> 3);
+  unsigned char Shift = Offset & 7;
+  int NbByte = (Nb + 7) >> 3;
+  int LastByte = ((Offset & 7) + Nb - 1) >> 3;   // Index of the last source byte to read
+  int i = 0;
+#if defined(MDB_BITWORD)
+  MDB_BITWORD Word;
+#endif
 
-  // Check if Request frame length is correct
-  if (msg->length == 8)
+  if (Shift == 0)
   {
-    // Extract the request data
-    RegAddress = GET_WORD(&msg->data[2]);
-    RegNb = GET_WORD(&msg->data[4]);
-
-    // Check if data are correct
-    if ((RegAddress < 0)  ||
-        (RegAddress > 0xFFFF-RegNb+1) ||
-        (RegNb <= 0)||(RegNb > MDB_REG_NUMBER_MAX))
+    // Aligned start address : plain copy of whole bytes
+    memcpy(dest, src, NbByte);
+  }
+  else
+  {
+#if defined(MDB_BITWORD)
+    // Shift and merge a whole word at a time while the next source byte is available
+    for (; i + (int)sizeof(MDB_BITWORD) <= LastByte; i += sizeof(MDB_BITWORD))
     {
-      Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_VALUE, msg);
+      memcpy(&Word, src + i, sizeof(MDB_BITWORD));
+      Word = (Word >> Shift) | ((MDB_BITWORD)src[i + sizeof(MDB_BITWORD)] << (8 * sizeof(MDB_BITWORD) - Shift));
+      memcpy(dest + i, &Word, sizeof(MDB_BITWORD));
     }
-    else
+#endif
+    // Shift and merge the remaining bytes
+    for (; i < NbByte; i++)
     {
-      // Prepare response frame
-      msg->length = 3 + (RegNb * 2) + 2;    //Length of the response including CRC      
-      msg->data[2] = RegNb * 2;             //Number of data bytes
-      dest = msg->data + 3;
-      
-      // loop on all registers to read
-      while (RegNb--)
+      dest[i] = src[i] >> Shift;
+      if (i < LastByte)
       {
-        // Check if register exists
-        if (Modbus_ReadInputRegister(RegAddress, &RegValue))
-        {
-          // Store value in the response frame
-          PUT_WORD(dest, RegValue);
-          // Prepare data for next register
-          dest +=2;
-          RegAddress++;
-        }
-        else
-        {
-          // One of the registers is not available
-          Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_ADDRESS, msg);
-          RegNb = 0;
-        }
+        dest[i] |= src[i + 1] << (8 - Shift);
       }
-      // Add CRC16
-      Modbus_CRC16 (msg, &CRC16);
-      PUT_WORD(dest, CRC16);
     }
-    Status = OK;
   }
-  else
+
+  // Unused bits of the last byte shall be 0
+  if (Nb & 7)
   {
-    Status = NOK;
-  }
-  return (Status);
+    dest[NbByte - 1] &= (1 << (Nb & 7)) - 1;
   }
+}
 #endif
 
-#if defined(MDB_FUNCTIONCODE_05)
+#if defined(MDB_FUNCTIONCODE_01)
 /**************************************************************************//**
-*   \brief      This function builds the response frame to a FC05 command
-*   \param[in,out] msg Pointer to a message that contains the Modbus frame received from the client
-*                 and will receive the response frame to be sent
-*                (data + length including server node address and CRC16) 
-*   \return     OK if the frame has been successfuly generated
-*   \return     NOK if the frame has not been generated 
+*   \brief      This function provides the states of a block of consecutive coils
+*   \param[in] Model Pointer to the data model of the server
+*   \param[in] Addr Address of the first coil to read
+*   \param[in] Nb Number of consecutive coils to read
+*   \param[out] dest Pointer to the frame area which will receive the states of the coils
+*   \return     OK if all states are available
+*   \return     NOK if one of the states is not available
 ******************************************************************************/
-t_status Modbus_WriteSingleCoil(Modbus_Frame* msg)
+t_status Modbus_ReadCoilBlock(Modbus_Model* Model, unsigned short Addr, int Nb, char* dest)
 {
-  t_status Status;
-  
-  unsigned short CoilAddress;
-  int CoilValue;
+  t_status Status = OK;
 
-  // Check if Request frame length is correct
-  if (msg->length == 8)
+  if (Model->Coils.data != 0)
   {
-    // Extract the request data
-    CoilAddress = GET_WORD(&msg->data[2]);
-    CoilValue = GET_WORD(&msg->data[4]);
-    
-    // Check if data are correct
-    if ((CoilAddress < 0) ||
-        (CoilAddress > 0xFFFF) ||
-        ((CoilValue != 0) && (CoilValue != 0xFF)))
+    // Coils are stored in the data model
+    if (IN_TABLE(Model->Coils, Addr, Nb))
     {
-      Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_VALUE, msg);
+      Modbus_CopyBits(dest, Model->Coils.data, Addr - Model->Coils.Addr, Nb);
     }
     else
     {
-      if (!Modbus_WriteCoil(CoilAddress, &CoilValue))
-      {
-        // One of the registers is not available
-        Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_ADDRESS, msg);
-      }
+      Status = NOK;
     }
   }
   else
   {
-    Status = NOK;
+    // Coils are provided by the application
+    if ((Model->Handlers->GetCoils == 0) || 
+        !Model->Handlers->GetCoils(Model->Context, Addr, Nb, (unsigned char*)dest))
+    {
+      Status = NOK;
+    }
   }
+  
   return (Status);
-}  
+}
 #endif
 
-#if defined(MDB_FUNCTIONCODE_06)
+#if defined(MDB_FUNCTIONCODE_02)
 /**************************************************************************//**
-*   \brief      This function builds the response frame to a FC06 command
-*   \param[in,out] msg Pointer to a message that contains the Modbus frame received from the client
-*                 and will receive the response frame to be sent
-*                (data + length including server node address and CRC16) 
-*   \return     OK if the frame has been successfuly generated
-*   \return     NOK if the frame has not been generated 
+*   \brief      This function provides the states of a block of consecutive inputs
+*   \param[in] Model Pointer to the data model of the server
+*   \param[in] Addr Address of the first input to read
+*   \param[in] Nb Number of consecutive inputs to read
+*   \param[out] dest Pointer to the frame area which will receive the states of the inputs
+*   \return     OK if all states are available
+*   \return     NOK if one of the states is not available
 ******************************************************************************/
-t_status Modbus_PresetSingleRegister(Modbus_Frame* msg)
+t_status Modbus_ReadInputBlock(Modbus_Model* Model, unsigned short Addr, int Nb, char* dest)
 {
-  t_status Status;
-  
-  unsigned short RegAddress;
-  int RegValue;
+  t_status Status = OK;
 
-  // Check if Request frame length is correct
-  if (msg->length == 8)
+  if (Model->Inputs.data != 0)
   {
-    // Extract the request data
-    RegAddress = GET_WORD(&msg->data[2]);
-    RegValue = GET_WORD(&msg->data[4]);
-    
-    // Check if data are correct
-    if ((RegAddress < 0) ||
-        (RegAddress > 0xFFFF))
+    // Inputs are stored in the data model
+    if (IN_TABLE(Model->Inputs, Addr, Nb))
     {
-      Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_VALUE, msg);
+      Modbus_CopyBits(dest, Model->Inputs.data, Addr - Model->Inputs.Addr, Nb);
     }
     else
     {
-      if (!Modbus_WriteRegister(RegAddress, &RegValue))
-      {
-        // One of the registers is not available
-        Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_ADDRESS, msg);
-      }
+      Status = NOK;
+    }
+  }
+  else
+  {
+    // Inputs are provided by the application
+    if ((Model->Handlers->GetInputs == 0) || 
+        !Model->Handlers->GetInputs(Model->Context, Addr, Nb, (unsigned char*)dest))
+    {
+      Status = NOK;
     }
   }
+  
+  return (Status);
+}
+#endif
+
+#if defined(MDB_FUNCTIONCODE_03) || defined(MDB_FUNCTIONCODE_23)
+/**************************************************************************//**
+*   \brief      This function provides the values of a block of consecutive registers
+*   \param[in] Model Pointer to the data model of the server
+*   \param[in] Addr Address of the first register to read
+*   \param[in] Nb Number of consecutive registers to read
+*   \param[out] dest Pointer to the frame area which will receive the values of the registers
+*   \return     OK if all values are available
+*   \return     NOK if one of the values is not available
+******************************************************************************/
+t_status Modbus_ReadRegisterBlock(Modbus_Model* Model, unsigned short Addr, int Nb, char* dest)
+{
+  t_status Status = OK;
+  unsigned short RegValues[MDB_REG_NUMBER_MAX];
+ 
+  if (Model->HoldingRegisters.Nb != 0)
+  {
+    // Registers are stored in the data model
+    Status = Modbus_MapRead(&Model->HoldingRegisters, Model->Context, Addr, Nb, dest);
+  }
+  else if ((Model->Handlers->GetRegisters != 0) && 
+           Model->Handlers->GetRegisters(Model->Context, Addr, Nb, RegValues))
+  {
+    // Registers are provided by the application
+    Modbus_PutRegisters(dest, RegValues, Nb);
+  }
   else
   {
     Status = NOK;
   }
+  
   return (Status);
-}  
+}
 #endif
 
-#if defined(MDB_FUNCTIONCODE_07)
+#if defined(MDB_FUNCTIONCODE_04)
 /**************************************************************************//**
-*   \brief      This function builds the response frame to a FC07 command
-*   \param[in,out] msg Pointer to a message that contains the Modbus frame received from the client
-*                 and will receive the response frame to be sent
-*                (data + length including server node address and CRC16) 
-*   \return     OK if the frame has been successfuly generated
-*   \return     NOK if the frame has not been generated 
+*   \brief      This function provides the values of a block of consecutive input registers
+*   \param[in] Model Pointer to the data model of the server
+*   \param[in] Addr Address of the first input register to read
+*   \param[in] Nb Number of consecutive input registers to read
+*   \param[out] dest Pointer to the frame area which will receive the values of the input registers
+*   \return     OK if all values are available
+*   \return     NOK if one of the values is not available
 ******************************************************************************/
-t_status Modbus_ReadExceptionStatus(Modbus_Frame* msg)
+t_status Modbus_ReadInputRegisterBlock(Modbus_Model* Model, unsigned short Addr, int Nb, char* dest)
 {
-  t_status Status;
+  t_status Status = OK;
+  unsigned short RegValues[MDB_REG_NUMBER_MAX];
+
+  if (Model->InputRegisters.Nb != 0)
+  {
+    // Input registers are stored in the data model
+    Status = Modbus_MapRead(&Model->InputRegisters, Model->Context, Addr, Nb, dest);
+  }
+  else if ((Model->Handlers->GetInputRegisters != 0) && 
+           Model->Handlers->GetInputRegisters(Model->Context, Addr, Nb, RegValues))
+  {
+    // Input registers are provided by the application
+    Modbus_PutRegisters(dest, RegValues, Nb);
+  }
+  else
+  {
+    Status = NOK;
+  }
   
-  int ExceptionValue;
-  unsigned short CRC16 = 0;
+  return (Status);
+}
+#endif
 
-  // Check if Request frame length is correct
-  if (msg->length == 4)
+#if defined(MDB_FUNCTIONCODE_05)
+/**************************************************************************//**
+*   \brief      This function sets the state of a single coil
+*   \param[in] Model Pointer to the data model of the server
+*   \param[in] Addr Address of the coil to set
+*   \param[out] Value Pointer to a varaiable which contains the state to apply
+*   \return     OK if function is successful
+*   \return     NOK if function is not successful
+******************************************************************************/
+t_status Modbus_WriteCoil(Modbus_Model* Model, unsigned short Addr, int* Value)
+{
+  t_status Status = OK;
+  unsigned short Offset;
+ 
+  if (Model->Coils.data != 0)
   {
-    if (Modbus_ReadException( &ExceptionValue))
+    // Coils are stored in the data model
+    if (IN_TABLE(Model->Coils, Addr, 1))
     {
-      msg->length = 5;                //Length of the response including CRC      
-      msg->data[2] = ExceptionValue;  //Number of data bytes
+      Offset = Addr - Model->Coils.Addr;
+      if (*Value != 0)
+      {
+        Model->Coils.data[Offset >> 3] |= 1 << (Offset & 7);
+      }
+      else
+      {
+        Model->Coils.data[Offset >> 3] &= ~(1 << (Offset & 7));
+      }
     }
     else
     {
-      // One of the registers is not available
-      Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_ADDRESS, msg);
+      Status = NOK;
     }
-    // Add CRC16
-    Modbus_CRC16 (msg, &CRC16);
-    PUT_WORD(&msg->data[3], CRC16);
   }
-  else
+  else if ((Model->Handlers->SetCoil == 0) || 
+           !Model->Handlers->SetCoil(Model->Context, Addr, Value))
   {
     Status = NOK;
   }
+  
   return (Status);
-}  
+}
 #endif
 
 #if defined(MDB_FUNCTIONCODE_08)
 /**************************************************************************//**
-*   \brief      This function builds the response frame to a FC08 command
-*   \param[in,out] msg Pointer to a message that contains the Modbus frame received from the client
-*                 and will receive the response frame to be sent
-*                (data + length including server node address and CRC16) 
-*   \return     OK if the frame has been successfuly generated
-*   \return     NOK if the frame has not been generated 
+*   \brief      This function sets the value of a single register
+*   \param[in] Model Pointer to the data model of the server
+*   \param[in] Addr Address of the register to write
+*   \param[out] Value Pointer to a varaiable which contains the value to write
+*   \return     OK if function is successful
+*   \return     NOK if function is not successful
 ******************************************************************************/
-t_status Modbus_ReadDiagnostic (Modbus_Frame*msg)
+t_status Modbus_WriteRegister(Modbus_Model* Model, unsigned short Addr, int* Value)
 {
-  t_status Status;
+  t_status Status = OK;
+  unsigned short RegValue = *Value;
   
-  unsigned short RegAddress;
-  unsigned short RegNb;
-  int RegValue;
-  char* src;
-  unsigned short CRC16 = 0;
+  if ((Model->Handlers->SetRegisters == 0) || 
+      !Model->Handlers->SetRegisters(Model->Context, Addr, 1, &RegValue))
+    {
+      Status = NOK;
+    }
+  
+  return (Status);
+}
+#endif
+
+#if defined(MDB_FUNCTIONCODE_06) || defined(MDB_FUNCTIONCODE_16) || defined(MDB_FUNCTIONCODE_23)
+/**************************************************************************//**
+*   \brief      This function sets the values of a block of consecutive registers
+*   \param[in] Model Pointer to the data model of the server
+*   \param[in] Addr Address of the first register to write
+*   \param[in] Nb Number of consecutive registers to write
+*   \param[in] src Pointer to the frame area which contains the values to write
+*   \return     OK if function is successful
+*   \return     NOK if function is not successful
+******************************************************************************/
+t_status Modbus_WriteRegisterBlock(Modbus_Model* Model, unsigned short Addr, int Nb, char* src)
+{
+  t_status Status = OK;
+  unsigned short RegValues[MDB_REG_NUMBER_MAX];
+  
+  if (Model->HoldingRegisters.Nb != 0)
+  {
+    // Registers are stored in the data model
+    Status = Modbus_MapWrite(Model, &Model->HoldingRegisters, Addr, Nb, src);
+  }
+  else
+  {
+    // Registers are provided by the application
+    Modbus_GetRegisters(src, RegValues, Nb);
+    if ((Model->Handlers->SetRegisters == 0) || 
+        !Model->Handlers->SetRegisters(Model->Context, Addr, Nb, RegValues))
+    {
+      Status = NOK;
+    }
+  }
+  
+  return (Status);
+}
+#endif
+
+#if defined(MDB_FUNCTIONCODE_03) || defined(MDB_FUNCTIONCODE_04) || defined(MDB_FUNCTIONCODE_06) || defined(MDB_FUNCTIONCODE_16) || defined(MDB_FUNCTIONCODE_23)
+// Keeps the index of the last range found in a register map
+static inline void Modbus_MapSetLast(Modbus_Map* Map, unsigned short Index)
+{
+#if defined(MDB_SEQLOCK)
+  __atomic_store_n(&Map->Last, Index, __ATOMIC_RELAXED);
+#else
+  Map->Last = Index;
+#endif
+}
 
-  // Extract the request data
-  RegAddress = GET_WORD(&msg->data[2]);
-  RegNb = GET_WORD(&msg->data[4]);
+/**************************************************************************//**
+*   \brief      This function finds the range of a register map which contains a register
+*
+*               The last range found is checked first, then the next one, so that
+*               consecutive accesses do not need a full binary search. This hint is shared
+*               by the threads of the server and of the application (relaxed atomic accesses).
+*   \param[in,out] Map Pointer to the register map
+*   \param[in] Addr Address of the register
+*   \return     Pointer to the range which contains the register
+*   \return     0 if the register doesn't belong to the map
+******************************************************************************/
+const Modbus_Range* Modbus_MapFind(Modbus_Map* Map, unsigned short Addr)
+{
+  const Modbus_Range* Range;
+  unsigned short Low, High, Mid;
+  unsigned short Last;
 
-  // Check if Request frame length is correct
-  if (msg->length == (char)(8))
+  // Check the last range found and the next one
+#if defined(MDB_SEQLOCK)
+  Last = __atomic_load_n(&Map->Last, __ATOMIC_RELAXED);
+#else
+  Last = Map->Last;
+#endif
+  Range = &Map->Ranges[Last];
+  if (Addr >= Range->Addr)
   {
-    // Check if data are correct
-    if ((RegAddress < 0) || 
-        (RegAddress > (0xFFFF - RegNb + 1)) || 
-        (RegNb <= 0) || (RegNb > (MDB_REG_NUMBER_MAX - 2)))
+    if (Addr - Range->Addr < Range->Nb)
     {
-      Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_VALUE, msg);
+      return (Range);
     }
-    else
+    if ((Last + 1 < Map->Nb) && (Addr >= Range[1].Addr) && (Addr - Range[1].Addr < Range[1].Nb))
     {
-      // Length of the response including CRC
-      msg->length = 8;
-
-      // Start of the register value list
-      src = msg->data + 7;
-      
-      // Loop on all register
-      while(RegNb--)
-      {
-        RegValue = GET_WORD(src);
-        if (!Modbus_WriteRegister(RegAddress, &RegValue))
-        {
-          // One of the registers is not available
-          Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_ADDRESS, msg);
-        }
-        RegAddress++;
-        src += 2;
-      }
-      // Add CRC16
-      Modbus_CRC16 (msg, &CRC16);
-      PUT_WORD(src, CRC16);
+      Modbus_MapSetLast(Map, Last + 1);
+      return (Range + 1);
     }
-    Status = OK;
   }
-  else
+
+  // Binary search of the range
+  Low = 0;
+  High = Map->Nb;
+  while (Low < High)
   {
-    Status = NOK;
+    Mid = (Low + High) / 2;
+    Range = &Map->Ranges[Mid];
+    if (Addr < Range->Addr)
+    {
+      High = Mid;
+    }
+    else if (Addr - Range->Addr >= Range->Nb)
+    {
+      Low = Mid + 1;
+    }
+    else
+    {
+      Modbus_MapSetLast(Map, Mid);
+      return (Range);
+    }
   }
-  return (Status);
-}  
+  return (0);
+}
 #endif
 
-#if defined(MDB_FUNCTIONCODE_16)
+#if defined(MDB_FUNCTIONCODE_03) || defined(MDB_FUNCTIONCODE_04) || defined(MDB_FUNCTIONCODE_23)
 /**************************************************************************//**
-*   \brief      This function builds the response frame to a FC16 command
-*   \param[in,out] msg Pointer to a message that contains the Modbus frame received from the client
-*                 and will receive the response frame to be sent
-*                (data + length including server node address and CRC16) 
-*   \return     OK if the frame has been successfuly generated
-*   \return     NOK if the frame has not been generated 
+*   \brief      This function reads a block of consecutive registers from a register map
+*   \param[in,out] Map Pointer to the register map
+*   \param[in] Context Context pointer passed to the read handlers of the ranges
+*   \param[in] Addr Address of the first register to read
+*   \param[in] Nb Number of consecutive registers to read
+*   \param[out] dest Pointer to the frame area which will receive the values of the registers
+*   \return     OK if all values are available
+*   \return     NOK if one of the registers doesn't belong to the map or can't be read
 ******************************************************************************/
-t_status Modbus_PresetMultipleRegisters(Modbus_Frame* msg)
+t_status Modbus_MapRead(Modbus_Map* Map, void* Context, unsigned short Addr, int Nb, char* dest)
 {
-  t_status Status;
-  
-  unsigned short RegAddress;
-  unsigned short RegNb;
-  int RegValue;
-  char* src;
-  unsigned short CRC16 = 0;
-
-  // Extract the request data
-  RegAddress = GET_WORD(&msg->data[2]);
-  RegNb = GET_WORD(&msg->data[4]);
+  t_status Status = OK;
+  const Modbus_Range* Range;
+  unsigned short RegValues[MDB_REG_NUMBER_MAX];
+  int Count;
 
-  // Check if Request frame length is correct
-  if (msg->length == (char)(7 + 2 * RegNb + 2))
+  // Loop on all ranges covered by the block
+  while ((Status == OK) && (Nb > 0))
   {
-    // Check if data are correct
-    if ((RegAddress < 0) || 
-        (RegAddress > (0xFFFF - RegNb + 1)) || 
-        (RegNb <= 0) || (RegNb > (MDB_REG_NUMBER_MAX - 2)))
+    Range = Modbus_MapFind(Map, Addr);
+    if (Range == 0)
     {
-      Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_VALUE, msg);
+      Status = NOK;
     }
     else
     {
-      // Length of the response including CRC
-      msg->length = 8;
-
-      // Start of the register value list
-      src = msg->data + 7;
-      
-      // Loop on all register
-      while(RegNb--)
+      Count = Range->Nb - (Addr - Range->Addr);
+      if (Count > Nb)
       {
-        RegValue = GET_WORD(src);
-        if (!Modbus_WriteRegister(RegAddress, &RegValue))
-        {
-          // One of the registers is not available
-          Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_ADDRESS, msg);
-        }
-        RegAddress++;
-        src += 2;
+        Count = Nb;
       }
-      // Add CRC16
-      Modbus_CRC16 (msg, &CRC16);
-      PUT_WORD(src, CRC16);
+      if (Range->data != 0)
+      {
+        Modbus_PutRegisters(dest, Range->data + (Addr - Range->Addr), Count);
+      }
+      else if ((Range->Get != 0) && Range->Get(Context, Addr, Count, RegValues))
+      {
+        Modbus_PutRegisters(dest, RegValues, Count);
+      }
+      else
+      {
+        Status = NOK;
+      }
+      Addr += Count;
+      Nb -= Count;
+      dest += 2 * Count;
     }
-    Status = OK;
-  }
-  else
-  {
-    Status = NOK;
   }
   return (Status);
-}  
+}
 #endif
 
-#if defined(MDB_FUNCTIONCODE_23)
+#if defined(MDB_FUNCTIONCODE_06) || defined(MDB_FUNCTIONCODE_16) || defined(MDB_FUNCTIONCODE_23)
 /**************************************************************************//**
-*   \brief      This function builds the response frame to a FC23 command
-*   \param[in,out] msg Pointer to a message that contains the Modbus frame received from the client
-*                 and will receive the response frame to be sent
-*                (data + length including node address and CRC16) 
-*   \return     OK if the frame has been successfuly generated
-*   \return     NOK if the frame has not been generated 
+*   \brief      This function writes a block of consecutive registers in a register map
+*
+*               The registers stored in memory are copied first, holding the writer side of the 
+*               sequence lock only during the copies. The write handlers of the other ranges are 
+*               called afterwards, outside the lock, so that they may write registers themselves.
+*   \param[in,out] Model Pointer to the data model of the server
+*   \param[in,out] Map Pointer to the register map
+*   \param[in] Addr Address of the first register to write
+*   \param[in] Nb Number of consecutive registers to write
+*   \param[in] src Pointer to the frame area which contains the values to write
+*   \return     OK if all registers have been written
+*   \return     NOK if one of the registers doesn't belong to the map or can't be written 
+*               (nothing is written then, unless a write handler fails)
 ******************************************************************************/
-t_status Modbus_ReadWriteMultipleRegisters(Modbus_Frame* msg)
+t_status Modbus_MapWrite(Modbus_Model* Model, Modbus_Map* Map, unsigned short Addr, int Nb, char* src)
 {
   t_status Status;
-  
-  unsigned short rRegAddress, wRegAddress;
-  unsigned short rRegNb, wRegNb;
-  int RegValue;
-  char* src;
-  char* dest;
-  unsigned short CRC16 = 0;
+  const Modbus_Range* Range;
+  unsigned short RegValues[MDB_REG_NUMBER_MAX];
+  unsigned short RangeAddr;
+  int Remaining;
+  int Count;
+  int Pass;
+  bool Locked = false;
+  char* p;
 
-  // Extract the request data
-  rRegAddress = GET_WORD(&msg->data[2]);
-  rRegNb = GET_WORD(&msg->data[4]);
-  wRegAddress = GET_WORD(&msg->data[6]);
-  wRegNb = GET_WORD(&msg->data[8]);
+  // Check the whole block first, so that nothing is written if one of the registers is not writable
+  Status = Modbus_MapCheck(Map, Addr, Nb, MDB_ACCESS_WO);
 
-  // Check if Request frame length is correct
-  if (msg->length == (char)(11 + 2 * wRegNb + 2))
+  // First pass : ranges stored in memory, second pass : ranges served by write handlers
+  for (Pass = 0; (Status == OK) && (Pass < 2); Pass++)
   {
-    // Check if data are correct
-    if ((rRegAddress < 0) ||
-        (wRegAddress < 0) ||
-        (rRegAddress > (0xFFFF - rRegNb + 1)) || 
-        (wRegAddress > (0xFFFF - wRegNb + 1)) || 
-        (rRegNb <= 0) || (rRegNb > (MDB_REG_NUMBER_MAX - 2)) ||
-        (wRegNb <= 0) || (wRegNb > (MDB_REG_NUMBER_MAX_FC23 - 2)))
-    {
-      Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_VALUE, msg);
-    }
-    else
+    RangeAddr = Addr;
+    Remaining = Nb;
+    p = src;
+
+    // Loop on all ranges covered by the block
+    while ((Status == OK) && (Remaining > 0))
     {
-      // Start of the register value list
-      src = msg->data + 11;
-      
-      // Loop on all registers to be written
-      while(wRegNb--)
+      Range = Modbus_MapFind(Map, RangeAddr);
+      if (Range == 0)
       {
-        RegValue = GET_WORD(src);
-        if (!Modbus_WriteRegister(wRegAddress, &RegValue))
-        {
-          // One of the registers is not available
-          Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_ADDRESS, msg);
-        }
-        wRegAddress++;
-        src += 2;
+        Status = NOK;
+        break;
       }
-
-      // Prepare response frame
-      msg->length = 3 + (rRegNb * 2) + 2;   //Length of the response including CRC      
-      msg->data[2] = rRegNb * 2;            //Number of data bytes
-      dest = msg->data + 3;
-      
-      // loop on all registers to read
-      while (rRegNb--)
+      Count = Range->Nb - (RangeAddr - Range->Addr);
+      if (Count > Remaining)
       {
-        // Check if register exists
-        if (Modbus_ReadRegister(rRegAddress, &RegValue))
-        {
-          // Store value in the response frame
-          PUT_WORD(dest, RegValue);
-          // Prepare data for next register
-          dest += 2;
-          rRegAddress++;
-        }
-        else
+        Count = Remaining;
+      }
+      if ((Pass == 0) && (Range->data != 0))
+      {
+        if (!Locked)
         {
-          // One of the registers is not available
-          Modbus_Exception(MDB_EXCEPTION_ILLEGAL_DATA_ADDRESS, msg);
-          rRegNb = 0;
+          Modbus_WriteBegin(Model);
+          Locked = true;
         }
+        Modbus_GetRegisters(p, Range->data + (RangeAddr - Range->Addr), Count);
+      }
+      else if ((Pass == 1) && (Range->data == 0))
+      {
+        Modbus_GetRegisters(p, RegValues, Count);
+        Status = Range->Set(Model->Context, RangeAddr, Count, RegValues);
       }
+      RangeAddr += Count;
+      Remaining -= Count;
+      p += 2 * Count;
+    }
 
-      // Add CRC16
-      Modbus_CRC16 (msg, &CRC16);
-      PUT_WORD(dest, CRC16);
+    if (Locked)
+    {
+      Modbus_WriteEnd(Model);
+      Locked = false;
     }
-    Status = OK;
-  }
-  else
-  {
-    Status = NOK;
   }
   return (Status);
-}  
+}
 #endif
 
-//Object access functions
-#if defined(MDB_FUNCTIONCODE_01)
+#if defined(MDB_FUNCTIONCODE_03) || defined(MDB_FUNCTIONCODE_04) || defined(MDB_FUNCTIONCODE_06) || defined(MDB_FUNCTIONCODE_16) || defined(MDB_FUNCTIONCODE_23)
 /**************************************************************************//**
-*   \brief      This function provides the state of a single coil
-*   \param[in] Addr Address of the coil to evaluate
-*   \param[out] Value Pointer to a varaiable which will receive the state of the coil
-*   \return     OK if the state is available
-*   \return     NOK if the state is not available
+*   \brief      This function checks that a block of consecutive registers can be accessed in a register map
+*   \param[in,out] Map Pointer to the register map
+*   \param[in] Addr Address of the first register of the block
+*   \param[in] Nb Number of consecutive registers of the block
+*   \param[in] Access Access to check (read, write or both)
+*   \return     OK if all registers belong to the map and can be accessed
+*   \return     NOK if one of the registers doesn't belong to the map or can't be accessed
 ******************************************************************************/
-t_status Modbus_ReadCoil(unsigned short Addr, int* Value)
+t_status Modbus_MapCheck(Modbus_Map* Map, unsigned short Addr, int Nb, t_access Access)
 {
   t_status Status = OK;
- 
- if (!Modbus_CB_GetCoil(Addr, Value))
+  const Modbus_Range* Range;
+
+  // Loop on all ranges covered by the block
+  while ((Status == OK) && (Nb > 0))
   {
-    Status = NOK;
+    Range = Modbus_MapFind(Map, Addr);
+    if ((Range == 0) ||
+        ((Range->data == 0) && (Access & MDB_ACCESS_RO) && (Range->Get == 0)) ||
+        ((Range->data == 0) && (Access & MDB_ACCESS_WO) && (Range->Set == 0)))
+    {
+      Status = NOK;
+    }
+    else
+    {
+      Nb -= Range->Nb - (Addr - Range->Addr);
+      Addr = Range->Addr + Range->Nb;
+    }
   }
-  
   return (Status);
 }
-#endif
 
-#if defined(MDB_FUNCTIONCODE_02)
 /**************************************************************************//**
-*   \brief      This function provides the state of a single Input
-*   \param[in] Addr Address of the input to evaluate
-*   \param[out] Value Pointer to a varaiable which will receive the state of the input
-*   \return     OK if the state is available
-*   \return     NOK if the state is not available
+*   \brief      This function writes a block of consecutive registers stored in memory
+*   \param[in]  Model Pointer to the data model of the server
+*   \param[in]  Map Pointer to the register map
+*   \param[in]  Addr Address of the first register
+*   \param[in]  Nb Number of consecutive registers
+*   \param[in]  Values Pointer to the values of the registers
+*   \return     OK if the registers have been written
+*   \return     NOK if one of the registers is not stored in memory (nothing is written)
 ******************************************************************************/
-t_status Modbus_ReadInput(unsigned short Addr, int* Value)
+t_status Modbus_WriteMapRegisters(Modbus_Model* Model, Modbus_Map* Map, unsigned short Addr, int Nb, unsigned short* Values)
 {
   t_status Status = OK;
- 
- if (!Modbus_CB_GetInput(Addr, Value))
+  const Modbus_Range* Range;
+  int i;
+
+  Modbus_WriteBegin(Model);
+
+  // Check that all registers are stored in memory
+  if ((Map->Nb == 0) || (Nb <= 0) || ((unsigned long)Addr + Nb > 0x10000))
   {
     Status = NOK;
   }
-  
+  for (i = 0; (Status == OK) && (i < Nb); i++)
+  {
+    Range = Modbus_MapFind(Map, Addr + i);
+    if ((Range == 0) || (Range->data == 0))
+    {
+      Status = NOK;
+    }
+  }
+
+  // Then write them
+  if (Status == OK)
+  {
+    for (i = 0; i < Nb; i++)
+    {
+      Range = Modbus_MapFind(Map, Addr + i);
+      Range->data[Addr + i - Range->Addr] = Values[i];
+    }
+  }
+
+  Modbus_WriteEnd(Model);
   return (Status);
 }
 #endif
 
-#if defined(MDB_FUNCTIONCODE_03) || defined(MDB_FUNCTIONCODE_23)
+#if defined(MDB_REG_SWAP)
 /**************************************************************************//**
-*   \brief      This function provides the value of a single Register
-*   \param[in] Addr Address of the Register to read
-*   \param[out] Value Pointer to a varaiable which will receive the value of the register
-*   \return     OK if the value is available
-*   \return     NOK if the value is not available
+*   \brief      This function swaps the bytes of a block of 16-bit words
+*               (host order to big-endian and back on little-endian targets)
+*   \param[out] dest Pointer to the first byte of the destination block
+*   \param[in] src Pointer to the first byte of the source block
+*   \param[in] Nb Number of words to swap
 ******************************************************************************/
-t_status Modbus_ReadRegister(unsigned short Addr, int* Value)
+static inline void Modbus_SwapWords(char* dest, const char* src, int Nb)
 {
-  t_status Status = OK;
- 
- if (!Modbus_CB_GetRegister(Addr, Value))
+  unsigned short Word;
+  int i = 0;
+
+#if defined(__x86_64__)
+  __m128i x;
+
+  for (; i + 8 <= Nb; i += 8)
   {
-    Status = NOK;
+    x = _mm_loadu_si128((const __m128i*)(src + 2 * i));
+    _mm_storeu_si128((__m128i*)(dest + 2 * i), _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8)));
+  }
+#elif defined(__aarch64__)
+  for (; i + 8 <= Nb; i += 8)
+  {
+    vst1q_u8((uint8_t*)(dest + 2 * i), vrev16q_u8(vld1q_u8((const uint8_t*)(src + 2 * i))));
+  }
+#endif
+  for (; i < Nb; i++)
+  {
+    memcpy(&Word, src + 2 * i, 2);
+    Word = __builtin_bswap16(Word);
+    memcpy(dest + 2 * i, &Word, 2);
   }
-  
-  return (Status);
 }
 #endif
 
-#if defined(MDB_FUNCTIONCODE_04)
+#if defined(MDB_FUNCTIONCODE_03) || defined(MDB_FUNCTIONCODE_04) || defined(MDB_FUNCTIONCODE_23)
 /**************************************************************************//**
-*   \brief      This function provides the value of a single input register
-*   \param[in] Addr Address of the input register to read
-*   \param[out] Value Pointer to a varaiable which will receive the value of the input register
-*   \return     OK if the value is available
-*   \return     NOK if the value is not available
+*   \brief      This function stores register values in a frame (big-endian)
+*   \param[out] dest Pointer to the first data byte in the frame
+*   \param[in] Values Pointer to an array which contains the register values
+*   \param[in] Nb Number of registers to store
 ******************************************************************************/
-t_status Modbus_ReadInputRegister(unsigned short Addr, int* Value)
+void Modbus_PutRegisters(char* dest, unsigned short* Values, int Nb)
 {
-  t_status Status = OK;
-
-  if (!Modbus_CB_GetInputRegister(Addr, Value))
+#if defined(MDB_REG_SWAP)
+  Modbus_SwapWords(dest, (const char*)Values, Nb);
+#else
+  while (Nb--)
   {
-      Status = NOK;
+    PUT_WORD(dest, *Values);
+    dest += 2;
+    Values++;
   }
-  
-  return (Status);
+#endif
 }
 #endif
 
-#if defined(MDB_FUNCTIONCODE_05)
+#if defined(MDB_FUNCTIONCODE_16) || defined(MDB_FUNCTIONCODE_23)
 /**************************************************************************//**
-*   \brief      This function sets the state of a single coil
-*   \param[in] Addr Address of the coil to set
-*   \param[out] Value Pointer to a varaiable which contains the state to apply
-*   \return     OK if function is successful
-*   \return     NOK if function is not successful
+*   \brief      This function stores the values of a Modbus_Data structure in a frame
+*               (big-endian, low 16 bits of each value)
+*   \param[out] dest Pointer to the first data byte in the frame
+*   \param[in] Values Pointer to an array which contains the register values
+*   \param[in] Nb Number of registers to store
 ******************************************************************************/
-t_status Modbus_WriteCoil(unsigned short Addr, int* Value)
+void Modbus_PutDataRegisters(char* dest, unsigned int* Values, int Nb)
 {
-  t_status Status = OK;
- 
- if (!Modbus_CB_SetCoil(Addr, Value))
+  int i = 0;
+
+#if defined(MDB_REG_SWAP) && defined(__x86_64__)
+  __m128i lo, hi, x;
+
+  for (; i + 8 <= Nb; i += 8)
   {
-    Status = NOK;
+    // Sign extension of the low 16 bits so that the saturating pack keeps them as is
+    lo = _mm_srai_epi32(_mm_slli_epi32(_mm_loadu_si128((const __m128i*)(Values + i)), 16), 16);
+    hi = _mm_srai_epi32(_mm_slli_epi32(_mm_loadu_si128((const __m128i*)(Values + i + 4)), 16), 16);
+    x = _mm_packs_epi32(lo, hi);
+    _mm_storeu_si128((__m128i*)(dest + 2 * i), _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8)));
+  }
+#elif defined(MDB_REG_SWAP) && defined(__aarch64__)
+  uint16x8_t x;
+
+  for (; i + 8 <= Nb; i += 8)
+  {
+    x = vcombine_u16(vmovn_u32(vld1q_u32(Values + i)), vmovn_u32(vld1q_u32(Values + i + 4)));
+    vst1q_u8((uint8_t*)(dest + 2 * i), vrev16q_u8(vreinterpretq_u8_u16(x)));
+  }
+#endif
+  for (; i < Nb; i++)
+  {
+    PUT_WORD(dest + 2 * i, Values[i]);
   }
-  
-  return (Status);
 }
 #endif
 
-#if defined(MDB_FUNCTIONCODE_06) || defined(MDB_FUNCTIONCODE_16) || defined(MDB_FUNCTIONCODE_23)
+#if defined(MDB_FUNCTIONCODE_03) || defined(MDB_FUNCTIONCODE_04) || defined(MDB_FUNCTIONCODE_06) || defined(MDB_FUNCTIONCODE_16) || defined(MDB_FUNCTIONCODE_23)
 /**************************************************************************//**
-*   \brief      This function sets the value of a single register
-*   \param[in] Addr Address of the register to write
-*   \param[out] Value Pointer to a varaiable which contains the value to write
-*   \return     OK if function is successful
-*   \return     NOK if function is not successful
+*   \brief      This function extracts register values from a frame (big-endian)
+*   \param[in] src Pointer to the first data byte in the frame
+*   \param[out] Values Pointer to an array which will receive the register values
+*   \param[in] Nb Number of registers to extract
 ******************************************************************************/
-t_status Modbus_WriteRegister(unsigned short Addr, int* Value)
+void Modbus_GetRegisters(char* src, unsigned short* Values, int Nb)
 {
-  t_status Status = OK;
-  
-  if (!Modbus_CB_SetRegister(Addr, Value))
-    {
-      Status = NOK;
-    }
-  
-  return (Status);
+#if defined(MDB_REG_SWAP)
+  Modbus_SwapWords((char*)Values, src, Nb);
+#else
+  while (Nb--)
+  {
+    *Values = GET_WORD(src);
+    src += 2;
+    Values++;
+  }
+#endif
 }
 #endif
 
 #if defined(MDB_FUNCTIONCODE_07)
 /**************************************************************************//**
 *   \brief      This function provides Exception register
+*   \param[in] Model Pointer to the data model of the server
 *   \param[out] Value Pointer to a varaiable which contains the value of the exception register
 *   \return     OK if function is successful
 *   \return     NOK if function is not successful
 ******************************************************************************/
-t_status Modbus_ReadException(int* Value)
+t_status Modbus_ReadException(Modbus_Model* Model, int* Value)
 {
   t_status Status = OK;
   
-  if (!Modbus_CB_GetException(Value))
+  if ((Model->Handlers->GetException == 0) || 
+      !Model->Handlers->GetException(Model->Context, Value))
     {
       Status = NOK;
     }
@@ -17,6 +17,9 @@
   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
+#ifndef Modbus_RTU_h
+#define Modbus_RTU_h
+
 ///Function return values
 enum t_status
 {
@@ -59,12 +62,42 @@ enum t_datatype
   MDB_LONG
 };
 
+/// Modbus tag types (value decoded from the registers of a response)
+enum t_tagtype
+{
+  MDB_TAG_UINT16,  ///< unsigned short, 1 register
+  MDB_TAG_INT16,   ///< short, 1 register
+  MDB_TAG_UINT32,  ///< uint32_t, 2 registers (high word first)
+  MDB_TAG_INT32,   ///< int32_t, 2 registers (high word first)
+  MDB_TAG_FLOAT,   ///< float (IEEE 754), 2 registers (high word first)
+};
+
+/// Modbus RTU receiver states
+enum t_rxstate
+{
+  MDB_RX_IDLE,    ///< Waiting for the first byte of a frame
+  MDB_RX_FRAME,   ///< Receiving a frame
+  MDB_RX_READY,   ///< Frame complete (t3.5 silence), waiting to be processed
+  MDB_RX_ERROR,   ///< Frame discarded, waiting for a t3.5 silence
+};
+
+/// Modbus object access rights
+enum t_access
+{
+  MDB_ACCESS_RO = 1,  ///< Object can be read only
+  MDB_ACCESS_WO = 2,  ///< Object can be written only
+  MDB_ACCESS_RW = 3,  ///< Object can be read and written
+};
+
 // Modbus exception definitions
 #define MDB_EXCEPTION_MASK 0x80
 #define MDB_EXCEPTION_ILLEGAL_FUNCTION 1
 #define MDB_EXCEPTION_ILLEGAL_DATA_ADDRESS 2
 #define MDB_EXCEPTION_ILLEGAL_DATA_VALUE 3
 #define MDB_EXCEPTION_SERVER_DEVICE_FAILURE 4
+#define MDB_EXCEPTION_SERVER_DEVICE_BUSY 6
+#define MDB_EXCEPTION_GATEWAY_PATH_UNAVAILABLE 10
+#define MDB_EXCEPTION_GATEWAY_TARGET_FAILED 11
 
 // Modbus Server node address definitions
 #define MDB_ADDRESS_MIN 1         ///< Lower bound of the server node address range
@@ -80,6 +113,11 @@ enum t_datatype
 #define MDB_REG_NUMBER_MAX  125   ///< Max number of registers in a frame
 #define MDB_REG_NUMBER_MAX_FC23  120   ///< Max number of written registers in a frame FC23
 
+// Modbus TCP definitions
+#define MDB_TCP_HEADER_LENGTH  6    ///< Length of the MBAP header before the unit identifier (transaction, protocol, length)
+#define MDB_TCP_LENGTH_MAX  260     ///< Max size of a Modbus TCP frame (MBAP header included)
+#define MDB_TCP_UNIT_DIRECT  255    ///< Unit identifier of a server reached directly (not through a gateway)
+
 // Definition of Modbus Function Code availabilities for the application
 // This allows code volume reduction
 #define MDB_FUNCTIONCODE_01	///< Function code 01 availability
@@ -93,6 +131,16 @@ enum t_datatype
 #define MDB_FUNCTIONCODE_16	///< Function code 16 availability
 #define MDB_FUNCTIONCODE_23	///< Function code 23 availability
 
+// CRC16 kernel : number of bytes processed per step (slicing-by-N with 16-bit tables)
+// 0 selects the byte-wise kernel with its 2 small tables (default on AVR targets)
+#if !defined(MDB_CRC_SLICING)
+#if defined(__AVR__) || (__cplusplus < 201103L)
+#define MDB_CRC_SLICING 0
+#else
+#define MDB_CRC_SLICING 8
+#endif
+#endif
+
 // Modbus Function codes
 enum t_functioncode{
   MDB_FC01 = 1,     ///< Read coil status
@@ -131,10 +179,18 @@ enum t_diagtype
 // Modbus frame structure
 typedef struct
 {
-  char length;
+  unsigned short length;
   char data[MDB_MSG_LENGTH_MAX];
 } Modbus_Frame;
 
+// Modbus frame view : frame stored in a buffer of the application (receive or transmit buffer, DMA region...)
+typedef struct
+{
+  char* data;             ///< Pointer to the frame (server node address first)
+  unsigned short length;  ///< Length of the frame (including server node address and CRC16)
+  unsigned short size;    ///< Size of the buffer, max length of a frame built in place
+} Modbus_View;
+
 // Modbus Data structure
 typedef struct
 {
@@ -143,7 +199,134 @@ typedef struct
   unsigned int data[MDB_REG_NUMBER_MAX];
 } Modbus_Data;
 
-// CRC tables
+// Modbus prebuilt request (read request sent periodically as is)
+typedef struct
+{
+  char data[8];                   ///< Request frame, CRC16 included
+  unsigned char length;           ///< Length of the request frame (0 if the request is not built)
+  unsigned short ResponseLength;  ///< Length of the expected response frame (CRC16 included)
+} Modbus_Request;
+
+// Modbus batch request structure : request built with others in a transmit arena
+// Parameters are the ones of the matching Client_xx function
+typedef struct
+{
+  int ServerAddr;             ///< Node address of the targeted Modbus server
+  char FunctionCode;          ///< Function code of the request (MDB_FC01 ... MDB_FC23)
+  unsigned short Addr;        ///< Address of the first object (read address for FC23, diagnostic type for FC08)
+  int Nb;                     ///< Number of objects to read (FC01 to FC04, FC23) or value to write (FC05, FC06, FC08)
+  unsigned short wAddr;       ///< Address of the first register to write (FC23)
+  Modbus_Data* Data;          ///< Registers to write (FC16, FC23)
+  unsigned long Offset;       ///< Offset of the request frame in the arena
+  unsigned short Length;      ///< Length of the request frame (0 if the request has not been built)
+} Modbus_BatchRequest;
+
+// Modbus tag structure : value stored at a given register of a read response
+typedef struct
+{
+  unsigned short Offset;  ///< Index of the (first) register of the value in the response
+  t_tagtype Type;         ///< Type of the value
+  void* Value;            ///< Pointer to the variable which will receive the value
+} Modbus_Tag;
+
+// Modbus CRC16 context, used to compute the CRC16 of a frame while it is received
+typedef struct
+{
+  unsigned char lo;   ///< Low byte of the CRC16 register
+  unsigned char hi;   ///< High byte of the CRC16 register
+} Modbus_CRC16Context;
+
+// Modbus RTU receiver : assembles the frames of a byte stream with the t1.5/t3.5 silences
+typedef struct
+{
+  Modbus_View Frame;              ///< Frame being received (in the receive buffer of the application)
+  Modbus_CRC16Context Context;    ///< CRC16 context of the frame being received
+  t_rxstate State;                ///< Receiver state
+  unsigned long CharTime;         ///< Time of a character (s)
+  unsigned long CharTimeout;      ///< Max silence between 2 characters of a frame : t1.5 (s)
+  unsigned long FrameTimeout;     ///< Min silence between 2 frames : t3.5 (s)
+  unsigned long LastTime;         ///< Reception time of the last byte (s)
+  unsigned short Errors;          ///< Number of frames discarded (silence violation, overflow, frame too short)
+} Modbus_Receiver;
+
+// Modbus bit table structure (coils or discrete inputs)
+typedef struct
+{
+  unsigned short Addr;    ///< Address of the first object of the table
+  unsigned short Nb;      ///< Number of objects in the table
+  unsigned char* data;    ///< Object states (8 objects per byte, LSB first)
+} Modbus_BitTable;
+
+// Modbus register range structure (holding or input registers)
+// Registers of a range are stored in memory (data) or served by handler functions (Get, Set)
+// Handlers receive the context pointer given to Server_SetHandlers
+typedef struct
+{
+  unsigned short Addr;    ///< Address of the first register of the range
+  unsigned short Nb;      ///< Number of registers in the range
+  unsigned short* data;   ///< Register values, or 0 if the range is served by handler functions
+  t_status (*Get)(void* Context, unsigned short Addr, int Nb, unsigned short* Values);   ///< Read handler (0 if not readable)
+  t_status (*Set)(void* Context, unsigned short Addr, int Nb, unsigned short* Values);   ///< Write handler (0 if not writable)
+} Modbus_Range;
+
+// Modbus register map structure
+typedef struct
+{
+  const Modbus_Range* Ranges;   ///< Ranges sorted by increasing address (no overlap)
+  unsigned short Nb;            ///< Number of ranges (0 if registers are accessed through callback functions)
+  unsigned short Last;          ///< Index of the last range found
+} Modbus_Map;
+
+// Modbus server handler table
+// Handlers receive the context pointer given to Server_SetHandlers (0 if the object type is not available)
+typedef struct
+{
+  t_status (*GetCoils)(void* Context, unsigned short Addr, int Nb, unsigned char* Values);            ///< Reads coils (FC01)
+  t_status (*SetCoil)(void* Context, unsigned short Addr, int* Value);                                ///< Writes a single coil (FC05)
+  t_status (*GetInputs)(void* Context, unsigned short Addr, int Nb, unsigned char* Values);           ///< Reads discrete inputs (FC02)
+  t_status (*GetRegisters)(void* Context, unsigned short Addr, int Nb, unsigned short* Values);       ///< Reads holding registers (FC03, FC23)
+  t_status (*SetRegisters)(void* Context, unsigned short Addr, int Nb, unsigned short* Values);       ///< Writes holding registers (FC06, FC08, FC16, FC23)
+  t_status (*GetInputRegisters)(void* Context, unsigned short Addr, int Nb, unsigned short* Values);  ///< Reads input registers (FC04)
+  t_status (*GetException)(void* Context, int* Value);                                                ///< Reads the exception register (FC07)
+} Modbus_Handlers;
+
+// Modbus response cache entry (FC03, FC04)
+typedef struct
+{
+  unsigned short Addr;      ///< Address of the first register of the response
+  unsigned short Nb;        ///< Number of registers of the response (0 if the entry is free)
+  unsigned short* data;     ///< Memory of the first register of the response
+  unsigned int Sequence;    ///< Sequence number of the register writes the response is up to date with
+  Modbus_Frame Response;    ///< Response frame (unit address and function code in data[0] and data[1])
+} Modbus_CacheEntry;
+
+// Modbus response cache structure
+typedef struct
+{
+  Modbus_CacheEntry* Entries;   ///< Cache entries
+  unsigned short Nb;            ///< Number of entries (0 if responses are not cached)
+  unsigned short Next;          ///< Index of the next entry to replace
+} Modbus_Cache;
+
+// Modbus server data model
+// Objects of a table which is not defined are accessed through the handler table
+typedef struct
+{
+  Modbus_BitTable Coils;            ///< Coils (FC01, FC05)
+  Modbus_BitTable Inputs;           ///< Discrete inputs (FC02)
+  Modbus_Map HoldingRegisters;      ///< Holding registers (FC03, FC06, FC16, FC23)
+  Modbus_Map InputRegisters;        ///< Input registers (FC04)
+  Modbus_Range HoldingTable;        ///< Single range used by Server_SetHoldingRegisters
+  Modbus_Range InputTable;          ///< Single range used by Server_SetInputRegisters
+  const Modbus_Handlers* Handlers;  ///< Handlers of the objects which are not stored in the data model
+  void* Context;                    ///< Context pointer passed to the handlers
+  Modbus_Cache Cache;               ///< Cache of the read responses
+  unsigned int Sequence;            ///< Sequence number of the register writes (odd while a write is in progress)
+  bool NoCRC16;                     ///< Responses are built without CRC16 (request served by Server_UpdateTCP)
+} Modbus_Model;
+
+// CRC tables (byte-wise kernel)
+#if (MDB_CRC_SLICING == 0)
 static const unsigned char Modbus_CRC_hi[] = 
 {
   0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
@@ -215,6 +398,7 @@ static const unsigned char Modbus_CRC_lo[] =
   0x44, 0x84, 0x85, 0x45, 0x87, 0x47, 0x46, 0x86,
   0x82, 0x42, 0x43, 0x83, 0x41, 0x81, 0x80, 0x40
 };
+#endif
 
 // Class Definition /////////////////////////////////////////////////////////    
 class Modbus_RTU
@@ -227,6 +411,8 @@ class Modbus_RTU
     int Mdb_FrameReceived;
     int Mdb_FrameNotResponded;
     int Mdb_FrameServerReceived;
+    Modbus_Model Mdb_Model;
+    Modbus_RTU** Mdb_Units;
   public:
     Modbus_RTU(int Param);
     // Device generic interface
@@ -237,47 +423,125 @@ class Modbus_RTU
     t_status SetParity(t_parity Param);
     t_status GetParity(t_parity* Param);
     t_status GetFrameTimeout(unsigned long* Value);
+    t_status GetCharTimeout(unsigned long* Value);
+    t_status ReceiverInit(Modbus_Receiver* Receiver, char* Buffer, unsigned short Size);
     t_status GetCRC16(Modbus_Frame* msg, unsigned short* Value);
+    t_status GetCRC16(Modbus_View* msg, unsigned short* Value);
     // Server specific interface
     t_status Server_SetAddress(int Param);
     t_status Server_GetAddress(int* Param);
     t_status Server_Update(Modbus_Frame* msg);
+    t_status Server_Update(Modbus_View* msg);
+    t_status Server_Update(Modbus_Frame* msg, Modbus_CRC16Context* Context);
+    t_status Server_Update(Modbus_View* msg, Modbus_CRC16Context* Context);
+    t_status Server_UpdateTCP(Modbus_View* msg);
+    t_status Server_SetCoils(unsigned char* Table, unsigned short Addr, unsigned short Nb);
+    t_status Server_SetInputs(unsigned char* Table, unsigned short Addr, unsigned short Nb);
+    t_status Server_SetHoldingRegisters(unsigned short* Table, unsigned short Addr, unsigned short Nb);
+    t_status Server_SetInputRegisters(unsigned short* Table, unsigned short Addr, unsigned short Nb);
+    t_status Server_SetHoldingRegisterMap(const Modbus_Range* Ranges, unsigned short Nb);
+    t_status Server_SetInputRegisterMap(const Modbus_Range* Ranges, unsigned short Nb);
+    t_status Server_SetHandlers(const Modbus_Handlers* Handlers, void* Context);
+    t_status Server_SetUnits(Modbus_RTU** Units);
+    t_status Server_SetCache(Modbus_CacheEntry* Entries, unsigned short Nb);
+    t_status Server_WriteRegister(unsigned short Addr, unsigned short Value);
+    t_status Server_WriteRegisters(unsigned short Addr, int Nb, unsigned short* Values);
+    t_status Server_WriteInputRegister(unsigned short Addr, unsigned short Value);
+    t_status Server_WriteInputRegisters(unsigned short Addr, int Nb, unsigned short* Values);
+    t_status Server_BeginWrite(void);
+    t_status Server_EndWrite(void);
     // Client specific interface
     t_status Client_ReadCoils(int ServerAddr, unsigned short Addr, int Nb, Modbus_Frame* msg); 
+    t_status Client_ReadCoils(int ServerAddr, unsigned short Addr, int Nb, Modbus_View* msg); 
     t_status Client_ReadDiscreteInputs(int ServerAddr, unsigned short Addr, int Nb, Modbus_Frame* msg); 
+    t_status Client_ReadDiscreteInputs(int ServerAddr, unsigned short Addr, int Nb, Modbus_View* msg); 
     t_status Client_ReadHoldingRegisters(int ServerAddr, unsigned short Addr, int Nb, Modbus_Frame* msg); 
+    t_status Client_ReadHoldingRegisters(int ServerAddr, unsigned short Addr, int Nb, Modbus_View* msg); 
     t_status Client_ReadInputRegisters(int ServerAddr, unsigned short Addr, int Nb, Modbus_Frame* msg); 
+    t_status Client_ReadInputRegisters(int ServerAddr, unsigned short Addr, int Nb, Modbus_View* msg); 
     t_status Client_WriteSingleCoil(int ServerAddr, unsigned short Addr, int Data, Modbus_Frame* msg); 
+    t_status Client_WriteSingleCoil(int ServerAddr, unsigned short Addr, int Data, Modbus_View* msg); 
     t_status Client_PresetSingleRegister(int ServerAddr, unsigned short Addr, int Data, Modbus_Frame* msg); 
+    t_status Client_PresetSingleRegister(int ServerAddr, unsigned short Addr, int Data, Modbus_View* msg); 
     t_status Client_ReadException(int ServerAddr, Modbus_Frame* msg);
+    t_status Client_ReadException(int ServerAddr, Modbus_View* msg);
     t_status Client_ReadDiagnostic(int ServerAddr, t_diagtype DiagType, int Data, Modbus_Frame* msg);
+    t_status Client_ReadDiagnostic(int ServerAddr, t_diagtype DiagType, int Data, Modbus_View* msg);
     t_status Client_PresetMultipleRegisters(int ServerAddr, unsigned short Addr, Modbus_Data* Data, Modbus_Frame* msg);
+    t_status Client_PresetMultipleRegisters(int ServerAddr, unsigned short Addr, Modbus_Data* Data, Modbus_View* msg);
     t_status Client_ReadWriteMultipleRegisters(int ServerAddr, unsigned short rAddr, int rNb,unsigned short wAddr, Modbus_Data* Data, Modbus_Frame* msg);
+    t_status Client_ReadWriteMultipleRegisters(int ServerAddr, unsigned short rAddr, int rNb,unsigned short wAddr, Modbus_Data* Data, Modbus_View* msg);
     t_status Client_Update(Modbus_Frame* msg, Modbus_Data* Data);
+    t_status Client_Update(Modbus_View* msg, Modbus_Data* Data);
+    t_status Client_Update(Modbus_Frame* msg, Modbus_Data* Data, Modbus_CRC16Context* Context);
+    t_status Client_Update(Modbus_View* msg, Modbus_Data* Data, Modbus_CRC16Context* Context);
+    t_status Client_BuildBatch(Modbus_BatchRequest* Requests, int Nb, char* Arena, unsigned long Size, unsigned long* Used);
+    t_status Client_BuildRequest(Modbus_Request* Request, int ServerAddr, char FunctionCode, unsigned short Addr, int Nb);
+    t_status Client_CheckResponse(const Modbus_Request* Request, Modbus_Frame* msg);
+    t_status Client_CheckResponse(const Modbus_Request* Request, Modbus_View* msg);
+    t_status Client_DecodeBits(Modbus_Frame* msg, bool* Values, int Nb, Modbus_CRC16Context* Context);
+    t_status Client_DecodeBits(Modbus_View* msg, bool* Values, int Nb, Modbus_CRC16Context* Context);
+    t_status Client_DecodeBitTable(Modbus_Frame* msg, unsigned char* Table, int Nb, Modbus_CRC16Context* Context);
+    t_status Client_DecodeBitTable(Modbus_View* msg, unsigned char* Table, int Nb, Modbus_CRC16Context* Context);
+    t_status Client_DecodeRegisters(Modbus_Frame* msg, unsigned short* Values, int Nb, Modbus_CRC16Context* Context);
+    t_status Client_DecodeRegisters(Modbus_View* msg, unsigned short* Values, int Nb, Modbus_CRC16Context* Context);
+    t_status Client_DecodeTags(Modbus_Frame* msg, const Modbus_Tag* Tags, int Nb, Modbus_CRC16Context* Context);
+    t_status Client_DecodeTags(Modbus_View* msg, const Modbus_Tag* Tags, int Nb, Modbus_CRC16Context* Context);
 };
 
+// CRC16 functions //////////////////////////////////////////////////////////
+void Modbus_CRC16Init(Modbus_CRC16Context* Context);
+void Modbus_CRC16Update(Modbus_CRC16Context* Context, char Byte);
+void Modbus_CRC16UpdateBlock(Modbus_CRC16Context* Context, const char* Buffer, int Length);
+unsigned short Modbus_CRC16Final(Modbus_CRC16Context* Context);
+t_status Modbus_CRC16Check(Modbus_Frame** msg, int Nb, t_status* Status);
+
+// Receiver functions ///////////////////////////////////////////////////////
+t_status Modbus_ReceiverPut(Modbus_Receiver* Receiver, const char* Data, int Length, unsigned long Time);
+t_status Modbus_ReceiverPoll(Modbus_Receiver* Receiver, unsigned long Now);
+void Modbus_ReceiverRelease(Modbus_Receiver* Receiver);
+
 // Private functions ////////////////////////////////////////////////////////
-t_status Modbus_ReadCoils(Modbus_Frame* msg);
-t_status Modbus_ReadDiscreteInputs(Modbus_Frame* msg);
-t_status Modbus_ReadHoldingRegisters(Modbus_Frame* msg);
-t_status Modbus_ReadInputRegisters(Modbus_Frame* msg);
-t_status Modbus_WriteSingleCoil(Modbus_Frame* msg);
-t_status Modbus_PresetSingleRegister(Modbus_Frame* msg);
-t_status Modbus_ReadExceptionStatus(Modbus_Frame* msg);
-t_status Modbus_ReadDiagnostic (Modbus_Frame* msg);
-t_status Modbus_PresetMultipleRegisters(Modbus_Frame* msg);
-t_status Modbus_ReadWriteMultipleRegisters(Modbus_Frame* msg);
-t_status Modbus_ReadCoil(unsigned short Addr, int* Value);
-t_status Modbus_WriteCoil(unsigned short Addr, int* Value);
-t_status Modbus_ReadInput(unsigned short Addr, int* Value);
-t_status Modbus_ReadRegister(unsigned short Addr, int* Value);
-t_status Modbus_ReadInputRegister(unsigned short Addr, int* Value);
-t_status Modbus_WriteRegister(unsigned short Addr, int* Value);
-t_status Modbus_ReadException(int* Param1);
-t_status Modbus_CRC16(Modbus_Frame* msg, unsigned short* Value);
-t_status Modbus_Exception(int Param, Modbus_Frame* msg);
-
-
-
-
- 
\ No newline at end of file
+t_status Modbus_ServeRequest(Modbus_View* msg, Modbus_Model* Model);
+t_status Modbus_ReadCoils(Modbus_View* msg, Modbus_Model* Model);
+t_status Modbus_ReadDiscreteInputs(Modbus_View* msg, Modbus_Model* Model);
+t_status Modbus_ReadHoldingRegisters(Modbus_View* msg, Modbus_Model* Model);
+t_status Modbus_ReadInputRegisters(Modbus_View* msg, Modbus_Model* Model);
+t_status Modbus_WriteSingleCoil(Modbus_View* msg, Modbus_Model* Model);
+t_status Modbus_PresetSingleRegister(Modbus_View* msg, Modbus_Model* Model);
+t_status Modbus_ReadExceptionStatus(Modbus_View* msg, Modbus_Model* Model);
+t_status Modbus_ReadDiagnostic (Modbus_View* msg, Modbus_Model* Model);
+t_status Modbus_PresetMultipleRegisters(Modbus_View* msg, Modbus_Model* Model);
+t_status Modbus_ReadWriteMultipleRegisters(Modbus_View* msg, Modbus_Model* Model);
+t_status Modbus_ReadCoilBlock(Modbus_Model* Model, unsigned short Addr, int Nb, char* dest);
+t_status Modbus_ReadInputBlock(Modbus_Model* Model, unsigned short Addr, int Nb, char* dest);
+t_status Modbus_WriteCoil(Modbus_Model* Model, unsigned short Addr, int* Value);
+t_status Modbus_ReadRegisterBlock(Modbus_Model* Model, unsigned short Addr, int Nb, char* dest);
+t_status Modbus_ReadInputRegisterBlock(Modbus_Model* Model, unsigned short Addr, int Nb, char* dest);
+t_status Modbus_WriteRegister(Modbus_Model* Model, unsigned short Addr, int* Value);
+t_status Modbus_WriteRegisterBlock(Modbus_Model* Model, unsigned short Addr, int Nb, char* src);
+const Modbus_Range* Modbus_MapFind(Modbus_Map* Map, unsigned short Addr);
+t_status Modbus_MapRead(Modbus_Map* Map, void* Context, unsigned short Addr, int Nb, char* dest);
+t_status Modbus_MapWrite(Modbus_Model* Model, Modbus_Map* Map, unsigned short Addr, int Nb, char* src);
+t_status Modbus_MapCheck(Modbus_Map* Map, unsigned short Addr, int Nb, t_access Access);
+t_status Modbus_CheckMap(const Modbus_Range* Ranges, unsigned short Nb);
+t_status Modbus_WriteMapRegisters(Modbus_Model* Model, Modbus_Map* Map, unsigned short Addr, int Nb, unsigned short* Values);
+unsigned int Modbus_ReadBegin(Modbus_Model* Model);
+t_status Modbus_ReadRetry(Modbus_Model* Model, unsigned int Sequence);
+unsigned int Modbus_WriteBegin(Modbus_Model* Model);
+void Modbus_WriteEnd(Modbus_Model* Model);
+void Modbus_CacheClear(Modbus_Cache* Cache);
+t_status Modbus_CacheRead(Modbus_Cache* Cache, Modbus_View* msg, unsigned short Addr, int Nb, unsigned int Sequence, bool NoCRC16);
+void Modbus_CacheStore(Modbus_Cache* Cache, Modbus_Map* Map, Modbus_View* msg, unsigned short Addr, int Nb, unsigned int Sequence);
+void Modbus_CacheUpdate(Modbus_CacheEntry* Entry);
+unsigned short Modbus_CRC16Delta(unsigned short Delta, int Nb);
+void Modbus_CopyBits(char* dest, unsigned char* Table, unsigned short Offset, int Nb);
+void Modbus_PutRegisters(char* dest, unsigned short* Values, int Nb);
+void Modbus_PutDataRegisters(char* dest, unsigned int* Values, int Nb);
+void Modbus_GetRegisters(char* src, unsigned short* Values, int Nb);
+t_status Modbus_ReadException(Modbus_Model* Model, int* Value);
+t_status Modbus_CRC16(Modbus_View* msg, unsigned short* Value);
+t_status Modbus_Exception(int Param, Modbus_View* msg);
+int Modbus_ResponseByteCount(Modbus_View* msg, Modbus_CRC16Context* Context);
+
+#endif
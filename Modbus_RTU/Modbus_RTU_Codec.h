@@ -0,0 +1,319 @@
+/*
+  Modbus_RTU_Codec.h - Typed multi-register values for Modbus_RTU
+  Copyright (c) 2012 Gilles De Vos.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/***********************************************************************//**
+* \defgroup Codec Typed register values
+* 16, 32 and 64-bit values (integers, float, double) are stored in 1, 2 or 4
+* consecutive registers. The order of the registers and of the bytes inside the
+* registers depends on the device and is given as a template parameter, so the
+* conversions only contain fixed byte permutations (8 to 16 bytes at a time with
+* SSE2 on x86_64 or NEON on aarch64).
+*
+* Values are read from or written to:
+* - a register image (unsigned short array : server tables, Client_DecodeRegisters),
+* - the data of a frame (big-endian registers, e.g. &msg->data[3] of a read response),
+* - a Modbus_Data structure (Client_Update, Client_PresetMultipleRegisters).
+*
+* Example:
+* \code
+* typedef Modbus_Codec<float, MDB_ORDER_CDAB> MeterFloat;   // low word first
+* unsigned short Regs[20];
+* float Power[10];
+*
+* if (myClient.Client_DecodeRegisters(&myFrame, Regs, 20, 0) == OK)
+* {
+*   MeterFloat::Decode(Regs, Power, 10);
+* }
+* \endcode
+* Use fixed-size types (int32_t, uint32_t, int64_t...) for integers : long is
+* 64-bit wide on most 64-bit hosts.
+* Requires a C++11 compiler (Arduino IDE 1.6.6 or later).
+***************************************************************************/
+
+#ifndef Modbus_RTU_Codec_h
+#define Modbus_RTU_Codec_h
+
+// Include files //////////////////////////////////////////////////////////////
+#include "Modbus_RTU.h"
+#include <string.h>
+#include <stdint.h>
+
+// Blocks of values are converted 16 bytes at a time with SSE2 (x86_64) or NEON (aarch64)
+#if defined(__GNUC__) && defined(__x86_64__)
+#define MDB_CODEC_SIMD
+#include <emmintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__)
+#define MDB_CODEC_SIMD
+#include <arm_neon.h>
+#endif
+
+/// Order of the bytes of a value in its registers (A = most significant byte)
+enum t_wordorder
+{
+  MDB_ORDER_ABCD,   ///< High word first, high byte first (Modbus standard, big-endian)
+  MDB_ORDER_CDAB,   ///< Low word first, high byte first (word swap)
+  MDB_ORDER_BADC,   ///< High word first, low byte first (byte swap)
+  MDB_ORDER_DCBA,   ///< Low word first, low byte first (little-endian)
+};
+
+/**************************************************************************//**
+*   \brief      Byte permutation of a block of values
+*
+*               Each value of SIZE 16-bit words is copied with its words in reverse
+*               order (WORDSWAP) and/or with the bytes of each word swapped (BYTESWAP).
+*   \ingroup    Codec
+*   \tparam     SIZE Number of words per value (1, 2 or 4)
+*   \tparam     WORDSWAP Reverse the order of the words of each value
+*   \tparam     BYTESWAP Swap the bytes of each word
+*   \param[out] dest Pointer to the destination block (shall not overlap src)
+*   \param[in]  src Pointer to the source block
+*   \param[in]  Nb Number of values
+******************************************************************************/
+template <int SIZE, bool WORDSWAP, bool BYTESWAP>
+inline void Modbus_CodecSwap(char* dest, const char* src, int Nb)
+{
+  const char* w;
+  int i = 0;
+  int j;
+
+  if (!WORDSWAP && !BYTESWAP)
+  {
+    memcpy(dest, src, 2 * SIZE * Nb);
+    return;
+  }
+
+#if defined(MDB_CODEC_SIMD)
+  {
+#if defined(__x86_64__)
+    __m128i x;
+
+    for (; i + 8 / SIZE <= Nb; i += 8 / SIZE)
+    {
+      x = _mm_loadu_si128((const __m128i*)(src + 2 * SIZE * i));
+      if (BYTESWAP)
+      {
+        x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+      }
+      if (WORDSWAP && (SIZE == 2))
+      {
+        x = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xB1), 0xB1);
+      }
+      if (WORDSWAP && (SIZE == 4))
+      {
+        x = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0x1B), 0x1B);
+      }
+      _mm_storeu_si128((__m128i*)(dest + 2 * SIZE * i), x);
+    }
+#else
+    uint8x16_t x;
+
+    for (; i + 8 / SIZE <= Nb; i += 8 / SIZE)
+    {
+      x = vld1q_u8((const uint8_t*)(src + 2 * SIZE * i));
+      if (BYTESWAP)
+      {
+        x = vrev16q_u8(x);
+      }
+      if (WORDSWAP && (SIZE == 2))
+      {
+        x = vreinterpretq_u8_u16(vrev32q_u16(vreinterpretq_u16_u8(x)));
+      }
+      if (WORDSWAP && (SIZE == 4))
+      {
+        x = vreinterpretq_u8_u16(vrev64q_u16(vreinterpretq_u16_u8(x)));
+      }
+      vst1q_u8((uint8_t*)(dest + 2 * SIZE * i), x);
+    }
+#endif
+  }
+#endif
+
+  for (; i < Nb; i++)
+  {
+    for (j = 0; j < SIZE; j++)
+    {
+      w = src + 2 * (SIZE * i + (WORDSWAP ? SIZE - 1 - j : j));
+      dest[2 * (SIZE * i + j)] = w[BYTESWAP ? 1 : 0];
+      dest[2 * (SIZE * i + j) + 1] = w[BYTESWAP ? 0 : 1];
+    }
+  }
+}
+
+/**************************************************************************//**
+*   \brief      Codec of values of type T stored in consecutive registers
+*   \ingroup    Codec
+*   \tparam     T Type of the values (2, 4 or 8 bytes)
+*   \tparam     ORDER Order of the bytes of a value in its registers
+******************************************************************************/
+template <typename T, t_wordorder ORDER = MDB_ORDER_ABCD>
+struct Modbus_Codec
+{
+  static_assert((sizeof(T) == 2) || (sizeof(T) == 4) || (sizeof(T) == 8), "Modbus_Codec values shall be 2, 4 or 8 bytes wide");
+
+  static const int Size = sizeof(T) / 2;    ///< Number of registers per value
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+  static const bool HostLE = false;
+#else
+  static const bool HostLE = true;
+#endif
+  // Low word first in the registers
+  static const bool LowFirst = (ORDER == MDB_ORDER_CDAB) || (ORDER == MDB_ORDER_DCBA);
+  // Low byte first in the registers
+  static const bool LowByte = (ORDER == MDB_ORDER_BADC) || (ORDER == MDB_ORDER_DCBA);
+  // Permutation between a value in memory and its registers (register image or frame)
+  static const bool WordSwap = (Size > 1) && (HostLE != LowFirst);
+  static const bool ImageByteSwap = LowByte;
+  static const bool FrameByteSwap = (HostLE != LowByte);
+
+  /**************************************************************************//**
+  *   \brief      This function reads a value from a register image
+  *   \param[in]  Regs Pointer to the first register of the value
+  *   \return     Value
+  ******************************************************************************/
+  static T Get(const unsigned short* Regs)
+  {
+    T Value;
+
+    Modbus_CodecSwap<Size, WordSwap, ImageByteSwap>((char*)&Value, (const char*)Regs, 1);
+    return (Value);
+  }
+
+  /**************************************************************************//**
+  *   \brief      This function writes a value to a register image
+  *   \param[out] Regs Pointer to the first register of the value
+  *   \param[in]  Value Value
+  ******************************************************************************/
+  static void Set(unsigned short* Regs, T Value)
+  {
+    Modbus_CodecSwap<Size, WordSwap, ImageByteSwap>((char*)Regs, (const char*)&Value, 1);
+  }
+
+  /**************************************************************************//**
+  *   \brief      This function reads consecutive values from a register image
+  *   \param[in]  Regs Pointer to the first register (Nb * Size registers)
+  *   \param[out] Values Pointer to an array which will receive the values
+  *   \param[in]  Nb Number of values
+  ******************************************************************************/
+  static void Decode(const unsigned short* Regs, T* Values, int Nb)
+  {
+    Modbus_CodecSwap<Size, WordSwap, ImageByteSwap>((char*)Values, (const char*)Regs, Nb);
+  }
+
+  /**************************************************************************//**
+  *   \brief      This function writes consecutive values to a register image
+  *
+  *               Values of a server table shall be written in a local image first,
+  *               then copied with Server_WriteRegisters.
+  *   \param[out] Regs Pointer to the first register (Nb * Size registers)
+  *   \param[in]  Values Pointer to an array which contains the values
+  *   \param[in]  Nb Number of values
+  ******************************************************************************/
+  static void Encode(unsigned short* Regs, const T* Values, int Nb)
+  {
+    Modbus_CodecSwap<Size, WordSwap, ImageByteSwap>((char*)Regs, (const char*)Values, Nb);
+  }
+
+  /**************************************************************************//**
+  *   \brief      This function reads consecutive values from the data of a frame
+  *   \param[in]  src Pointer to the first data byte of the values in the frame
+  *   \param[out] Values Pointer to an array which will receive the values
+  *   \param[in]  Nb Number of values
+  ******************************************************************************/
+  static void DecodeFrame(const char* src, T* Values, int Nb)
+  {
+    Modbus_CodecSwap<Size, WordSwap, FrameByteSwap>((char*)Values, src, Nb);
+  }
+
+  /**************************************************************************//**
+  *   \brief      This function writes consecutive values to the data of a frame
+  *   \param[out] dest Pointer to the first data byte of the values in the frame
+  *   \param[in]  Values Pointer to an array which contains the values
+  *   \param[in]  Nb Number of values
+  ******************************************************************************/
+  static void EncodeFrame(char* dest, const T* Values, int Nb)
+  {
+    Modbus_CodecSwap<Size, WordSwap, FrameByteSwap>(dest, (const char*)Values, Nb);
+  }
+
+  /**************************************************************************//**
+  *   \brief      This function reads consecutive values from the data extracted
+  *               by Client_Update (FC03, FC04, FC23 : one data byte per item)
+  *   \param[in]  Data Pointer to the data extracted from a response
+  *   \param[out] Values Pointer to an array which will receive the values
+  *   \param[in]  Nb Number of values
+  *   \return     OK if the values have been read
+  *   \return     NOK if the response does not contain Nb values
+  ******************************************************************************/
+  static t_status Decode(const Modbus_Data* Data, T* Values, int Nb)
+  {
+    char Bytes[sizeof(T)];
+    int i;
+    int j;
+
+    if ((Data->type != MDB_WORD) || (Nb < 0) || (Nb * Size > Data->length) || (Nb * (int)sizeof(T) > MDB_REG_NUMBER_MAX))
+    {
+      return (NOK);
+    }
+    for (i = 0; i < Nb; i++)
+    {
+      for (j = 0; j < (int)sizeof(T); j++)
+      {
+        Bytes[j] = (char)Data->data[i * sizeof(T) + j];
+      }
+      DecodeFrame(Bytes, &Values[i], 1);
+    }
+    return (OK);
+  }
+
+  /**************************************************************************//**
+  *   \brief      This function writes consecutive values to the data of a request
+  *               (Client_PresetMultipleRegisters, Client_ReadWriteMultipleRegisters :
+  *               one register per item)
+  *   \param[out] Data Pointer to the data of the request (length and registers)
+  *   \param[in]  Values Pointer to an array which contains the values
+  *   \param[in]  Nb Number of values
+  *   \return     OK if the values have been written
+  *   \return     NOK if the values do not fit in Data
+  ******************************************************************************/
+  static t_status Encode(Modbus_Data* Data, const T* Values, int Nb)
+  {
+    unsigned short Regs[Size];
+    int i;
+    int j;
+
+    if ((Nb < 0) || (Nb * Size > MDB_REG_NUMBER_MAX))
+    {
+      return (NOK);
+    }
+    for (i = 0; i < Nb; i++)
+    {
+      Set(Regs, Values[i]);
+      for (j = 0; j < Size; j++)
+      {
+        Data->data[i * Size + j] = Regs[j];
+      }
+    }
+    Data->length = Nb * Size;
+    Data->type = MDB_WORD;
+    return (OK);
+  }
+};
+
+#endif
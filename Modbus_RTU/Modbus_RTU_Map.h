@@ -0,0 +1,355 @@
+/*
+  Modbus_RTU_Map.h - Compile-time register map for Modbus_RTU servers
+  Copyright (c) 2012 Gilles De Vos.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/***********************************************************************//**
+* \defgroup StaticMap Compile-time register map
+* The register layout of a server is declared as a list of items sorted by
+* increasing address. Addresses, sizes, access rights and scaling factors are
+* template parameters, so the read and write handlers generated for the map
+* only contain constant comparisons and copies.
+*
+* Example:
+* \code
+* unsigned short Setpoints[10];
+* float Temperature;
+* long Counter;
+*
+* typedef Modbus_StaticMap<
+*   Modbus_Block<0, 10, Setpoints>,                           // 0..9 read/write
+*   Modbus_Var<100, float, &Temperature, 10, MDB_ACCESS_RO>,  // 100..101 = Temperature * 10 (32-bit, high word first)
+*   Modbus_Var<200, long, &Counter, 1, MDB_ACCESS_RO>         // 200..201 (high word first)
+* > MyMap;
+*
+* myServer.Server_SetHoldingRegisterMap(MyMap::Range, 1);
+* \endcode
+* Requires a C++11 compiler (Arduino IDE 1.6.6 or later).
+***************************************************************************/
+
+#ifndef Modbus_RTU_Map_h
+#define Modbus_RTU_Map_h
+
+// Include files //////////////////////////////////////////////////////////////
+#include "Modbus_RTU.h"
+#include <stdint.h>
+
+/**************************************************************************//**
+*   \brief      Block of consecutive registers stored in an array
+*   \ingroup    StaticMap
+*   \tparam     ADDR Address of the first register of the block
+*   \tparam     NB Number of registers in the block
+*   \tparam     DATA Array which stores the register values
+*   \tparam     ACCESS Access rights of the block
+******************************************************************************/
+template <unsigned short ADDR, unsigned short NB, unsigned short* DATA, t_access ACCESS = MDB_ACCESS_RW>
+struct Modbus_Block
+{
+  static const unsigned long Begin = ADDR;            ///< Address of the first register
+  static const unsigned long End = ADDR + NB;         ///< Address following the last register
+
+  // Reads registers from Addr (inside the block), returns the number of registers read
+  static int Read(unsigned short Addr, int Nb, unsigned short* Values)
+  {
+    int Count = 0;
+
+    if (ACCESS & MDB_ACCESS_RO)
+    {
+      Count = End - Addr;
+      if (Count > Nb)
+      {
+        Count = Nb;
+      }
+      for (int i = 0; i < Count; i++)
+      {
+        Values[i] = DATA[Addr - ADDR + i];
+      }
+    }
+    return (Count);
+  }
+
+  // Returns the number of registers from Addr (inside the block) which can be written
+  static int Check(unsigned short Addr, int Nb)
+  {
+    int Count = 0;
+
+    if (ACCESS & MDB_ACCESS_WO)
+    {
+      Count = End - Addr;
+      if (Count > Nb)
+      {
+        Count = Nb;
+      }
+    }
+    return (Count);
+  }
+
+  // Writes registers from Addr (inside the block), returns the number of registers written
+  static int Write(unsigned short Addr, int Nb, unsigned short* Values)
+  {
+    int Count = Check(Addr, Nb);
+
+    for (int i = 0; i < Count; i++)
+    {
+      DATA[Addr - ADDR + i] = Values[i];
+    }
+    return (Count);
+  }
+};
+
+/**************************************************************************//**
+*   \brief      Variable mapped on 1 register (8/16-bit types) or 2 registers
+*               (32-bit types, high word first)
+*
+*               Register value = Variable * SCALE (truncated),
+*               Variable = Register value / SCALE.
+*               2-register values are 32-bit wide (two's complement for signed types),
+*               whatever the size of long on the target.
+*               A 32-bit variable can only be written with both of its registers.
+*   \ingroup    StaticMap
+*   \tparam     ADDR Address of the (first) register
+*   \tparam     T Type of the variable
+*   \tparam     VAR Pointer to the variable
+*   \tparam     SCALE Scaling factor applied to the variable
+*   \tparam     ACCESS Access rights of the variable
+******************************************************************************/
+template <unsigned short ADDR, typename T, T* VAR, long SCALE = 1, t_access ACCESS = MDB_ACCESS_RW>
+struct Modbus_Var
+{
+  static const int Size = (sizeof(T) > 2) ? 2 : 1;    ///< Number of registers
+  static const unsigned long Begin = ADDR;            ///< Address of the first register
+  static const unsigned long End = ADDR + Size;       ///< Address following the last register
+
+  // Reads registers from Addr (inside the variable), returns the number of registers read
+  static int Read(unsigned short Addr, int Nb, unsigned short* Values)
+  {
+    int Count = 0;
+    uint32_t Value;
+
+    if (ACCESS & MDB_ACCESS_RO)
+    {
+      Value = (T(-1) < T(0)) ? (uint32_t)(int32_t)(*VAR * SCALE) : (uint32_t)(*VAR * SCALE);
+      for (; (Count < Nb) && ((unsigned long)(Addr + Count) < End); Count++)
+      {
+        Values[Count] = (unsigned short)(Value >> (16 * (End - 1 - Addr - Count)));
+      }
+    }
+    return (Count);
+  }
+
+  // Returns the number of registers from Addr (inside the variable) which can be written
+  static int Check(unsigned short Addr, int Nb)
+  {
+    int Count = 0;
+
+    if ((ACCESS & MDB_ACCESS_WO) && (Addr == ADDR) && (Nb >= Size))
+    {
+      Count = Size;
+    }
+    return (Count);
+  }
+
+  // Writes registers from Addr (inside the variable), returns the number of registers written
+  static int Write(unsigned short Addr, int Nb, unsigned short* Values)
+  {
+    int Count = Check(Addr, Nb);
+    int32_t Value;
+
+    if (Count == 2)
+    {
+      // Sign extension from 32 bits for signed variables
+      Value = (int32_t)(((uint32_t)Values[0] << 16) | Values[1]);
+      *VAR = (T(-1) < T(0)) ? (T)((T)Value / SCALE) : (T)((T)(uint32_t)Value / SCALE);
+    }
+    else if (Count == 1)
+    {
+      // Sign extension of the register value for signed variables
+      Value = (T(-1) < T(0)) ? (int32_t)(short)Values[0] : (int32_t)Values[0];
+      *VAR = (T)((T)Value / SCALE);
+    }
+    return (Count);
+  }
+};
+
+/**************************************************************************//**
+*   \brief      Register map made of a list of items (Modbus_Block, Modbus_Var)
+*               sorted by increasing address
+*
+*               The map is attached to a server as a single range (Range) which
+*               covers all items and is served by the Get and Set handlers.
+*               Registers between items are answered with an exception.
+*   \ingroup    StaticMap
+******************************************************************************/
+template <typename... Items>
+struct Modbus_StaticMap;
+
+// End of the list of items
+template <>
+struct Modbus_StaticMap<>
+{
+  static const bool Empty = true;
+  static const unsigned long Begin = 0x10000;
+  static const unsigned long End = 0;
+
+  static int ReadItem(unsigned short, int, unsigned short*) { return (0); }
+  static int CheckItem(unsigned short, int) { return (0); }
+  static int WriteItem(unsigned short, int, unsigned short*) { return (0); }
+};
+
+template <typename Item, typename... Items>
+struct Modbus_StaticMap<Item, Items...>
+{
+  typedef Modbus_StaticMap<Items...> Next;
+
+  static_assert(Item::End <= Next::Begin, "Modbus_StaticMap items shall be sorted by address and shall not overlap");
+  static_assert(Item::End <= 0x10000, "Modbus_StaticMap item out of the address range");
+
+  static const bool Empty = false;
+  static const unsigned long Begin = Item::Begin;                       ///< Address of the first register of the map
+  static const unsigned long End = Next::Empty ? Item::End : Next::End; ///< Address following the last register of the map
+
+  static_assert(Next::Empty || (Next::End - Item::Begin < 0x10000), "Modbus_StaticMap shall not cover more than 65535 registers");
+
+  static const Modbus_Range Range[1];   ///< Range to attach to a server register map
+
+  // Reads registers from Addr, returns the number of registers read (0 if Addr is not mapped)
+  static int ReadItem(unsigned short Addr, int Nb, unsigned short* Values)
+  {
+    if (Addr < Item::Begin)
+    {
+      return (0);
+    }
+    if (Addr < Item::End)
+    {
+      return (Item::Read(Addr, Nb, Values));
+    }
+    return (Next::ReadItem(Addr, Nb, Values));
+  }
+
+  // Returns the number of registers from Addr which can be written (0 if Addr is not mapped)
+  static int CheckItem(unsigned short Addr, int Nb)
+  {
+    if (Addr < Item::Begin)
+    {
+      return (0);
+    }
+    if (Addr < Item::End)
+    {
+      return (Item::Check(Addr, Nb));
+    }
+    return (Next::CheckItem(Addr, Nb));
+  }
+
+  // Writes registers from Addr, returns the number of registers written (0 if Addr is not mapped)
+  static int WriteItem(unsigned short Addr, int Nb, unsigned short* Values)
+  {
+    if (Addr < Item::Begin)
+    {
+      return (0);
+    }
+    if (Addr < Item::End)
+    {
+      return (Item::Write(Addr, Nb, Values));
+    }
+    return (Next::WriteItem(Addr, Nb, Values));
+  }
+
+  /**************************************************************************//**
+  *   \brief      Read handler of the map (FC03, FC04, FC23)
+  *   \param[in]  Context Context pointer of the server (unused, items are bound at compile time)
+  *   \param[in]  Addr Address of the first register to read
+  *   \param[in]  Nb Number of consecutive registers to read
+  *   \param[out] Values Pointer to an array which will receive the register values
+  *   \return     OK if all registers are mapped and readable
+  *   \return     NOK otherwise
+  ******************************************************************************/
+  static t_status Get(void* Context, unsigned short Addr, int Nb, unsigned short* Values)
+  {
+    int Count;
+
+    while (Nb > 0)
+    {
+      Count = ReadItem(Addr, Nb, Values);
+      if (Count == 0)
+      {
+        return (NOK);
+      }
+      Addr += Count;
+      Nb -= Count;
+      Values += Count;
+    }
+    return (OK);
+  }
+
+  /**************************************************************************//**
+  *   \brief      Write handler of the map (FC06, FC16, FC23)
+  *
+  *               Nothing is written unless all registers are mapped and writable.
+  *   \param[in]  Context Context pointer of the server (unused, items are bound at compile time)
+  *   \param[in]  Addr Address of the first register to write
+  *   \param[in]  Nb Number of consecutive registers to write
+  *   \param[in]  Values Pointer to an array which contains the register values
+  *   \return     OK if all registers have been written
+  *   \return     NOK otherwise
+  ******************************************************************************/
+  static t_status Set(void* Context, unsigned short Addr, int Nb, unsigned short* Values)
+  {
+    unsigned short CheckAddr = Addr;
+    int CheckNb = Nb;
+    int Count;
+
+    // Check the whole block first
+    while (CheckNb > 0)
+    {
+      Count = CheckItem(CheckAddr, CheckNb);
+      if (Count == 0)
+      {
+        return (NOK);
+      }
+      CheckAddr += Count;
+      CheckNb -= Count;
+    }
+
+    // Then write it
+    while (Nb > 0)
+    {
+      Count = WriteItem(Addr, Nb, Values);
+      Addr += Count;
+      Nb -= Count;
+      Values += Count;
+    }
+    return (OK);
+  }
+};
+
+template <typename Item, typename... Items>
+const Modbus_Range Modbus_StaticMap<Item, Items...>::Range[1] =
+{
+  {
+    (unsigned short)Begin,
+    (unsigned short)(End - Begin),
+    0,
+    &Modbus_StaticMap<Item, Items...>::Get,
+#if defined(MDB_FUNCTIONCODE_06) || defined(MDB_FUNCTIONCODE_16) || defined(MDB_FUNCTIONCODE_23)
+    &Modbus_StaticMap<Item, Items...>::Set
+#else
+    0
+#endif
+  }
+};
+
+#endif
@@ -0,0 +1,697 @@
+/*
+  Modbus_RTU_Serial.cpp - Serial transport of Modbus_RTU for Linux hosts
+  Copyright (c) 2012 Gilles De Vos.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// Include files //////////////////////////////////////////////////////////////
+#include "Modbus_RTU_Serial.h"
+
+#if defined(__linux__)
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <sys/timerfd.h>
+#include <sys/epoll.h>
+#include <linux/serial.h>
+
+//=============================================================================
+// Serial transport functions
+//=============================================================================
+/**************************************************************************//**
+*   \brief      This function opens a serial port with the baudrate and parity of a device
+*   \ingroup Serial
+*   \param[out] Port Pointer to the serial port
+*   \param[in]  Device Pointer to the Modbus device which uses the port
+*   \param[in]  Path Path of the tty (e.g. "/dev/ttyUSB0")
+*   \param[in]  Options Port options (MDB_SERIAL_RS485 or 0)
+*   \return     OK if the port has been opened and configured
+*   \return     NOK otherwise (errno gives the reason)
+******************************************************************************/
+t_status Modbus_SerialOpen(Modbus_Serial* Port, Modbus_RTU* Device, const char* Path, int Options)
+{
+  int fd = open(Path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+
+  if (fd < 0)
+  {
+    Port->fd = -1;
+    Port->Timer = -1;
+    return (NOK);
+  }
+  return (Modbus_SerialAttach(Port, Device, fd, Options));
+}
+
+/**************************************************************************//**
+*   \brief      This function configures an open tty (or one side of a pseudo-terminal
+*               pair created by openpty) with the baudrate and parity of a device
+*
+*   The port owns the file descriptor, which is closed by Modbus_SerialClose
+*   (or at once if the configuration fails).
+*   \ingroup Serial
+*   \param[out] Port Pointer to the serial port
+*   \param[in]  Device Pointer to the Modbus device which uses the port
+*   \param[in]  fd File descriptor of the tty
+*   \param[in]  Options Port options (MDB_SERIAL_RS485 or 0)
+*   \return     OK if the port has been configured
+*   \return     NOK otherwise (errno gives the reason)
+******************************************************************************/
+t_status Modbus_SerialAttach(Modbus_Serial* Port, Modbus_RTU* Device, int fd, int Options)
+{
+  struct termios Tio;
+  struct serial_rs485 Rs485;
+  t_baud Baudrate;
+  t_parity Parity;
+  speed_t Speed;
+
+  Port->fd = fd;
+  Port->Timer = -1;
+  Port->PendingLength = 0;
+
+  Device->GetBaudrate(&Baudrate);
+  Device->GetParity(&Parity);
+  switch (Baudrate)
+  {
+    case MDB_BAUD_1200: Speed = B1200; break;
+    case MDB_BAUD_2400: Speed = B2400; break;
+    case MDB_BAUD_4800: Speed = B4800; break;
+    case MDB_BAUD_9600: Speed = B9600; break;
+    case MDB_BAUD_19200: Speed = B19200; break;
+    case MDB_BAUD_38400: Speed = B38400; break;
+    default:
+        errno = EINVAL;
+        Modbus_SerialClose(Port);
+        return (NOK);
+  }
+
+  // Raw 8-bit characters, 11 bits per character : parity bit or 2 stop bits
+  if ((fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0) || (tcgetattr(fd, &Tio) != 0))
+  {
+    Modbus_SerialClose(Port);
+    return (NOK);
+  }
+  cfmakeraw(&Tio);
+  Tio.c_cflag &= ~(CSIZE | PARENB | PARODD | CSTOPB);
+  Tio.c_cflag |= CS8 | CLOCAL | CREAD;
+  switch (Parity)
+  {
+    case MDB_PARITY_EVEN:
+        Tio.c_cflag |= PARENB;
+        break;
+    case MDB_PARITY_ODD:
+        Tio.c_cflag |= PARENB | PARODD;
+        break;
+    default:
+        Tio.c_cflag |= CSTOPB;
+        break;
+  }
+  Tio.c_cc[VMIN] = 0;
+  Tio.c_cc[VTIME] = 0;
+  cfsetispeed(&Tio, Speed);
+  cfsetospeed(&Tio, Speed);
+  if (tcsetattr(fd, TCSANOW, &Tio) != 0)
+  {
+    Modbus_SerialClose(Port);
+    return (NOK);
+  }
+
+  // Transmitter enabled by RTS while sending
+  if (Options & MDB_SERIAL_RS485)
+  {
+    memset(&Rs485, 0, sizeof(Rs485));
+    Rs485.flags = SER_RS485_ENABLED | SER_RS485_RTS_ON_SEND;
+    if (ioctl(fd, TIOCSRS485, &Rs485) != 0)
+    {
+      Modbus_SerialClose(Port);
+      return (NOK);
+    }
+  }
+
+  Port->Timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if ((Port->Timer < 0) || (Device->ReceiverInit(&Port->Receiver, Port->Buffer, sizeof(Port->Buffer)) == NOK))
+  {
+    Modbus_SerialClose(Port);
+    return (NOK);
+  }
+  return (OK);
+}
+
+/**************************************************************************//**
+*   \brief      This function closes a serial port
+*   \ingroup Serial
+*   \param[in,out] Port Pointer to the serial port
+******************************************************************************/
+void Modbus_SerialClose(Modbus_Serial* Port)
+{
+  if (Port->fd >= 0)
+  {
+    close(Port->fd);
+    Port->fd = -1;
+  }
+  if (Port->Timer >= 0)
+  {
+    close(Port->Timer);
+    Port->Timer = -1;
+  }
+}
+
+/**************************************************************************//**
+*   \brief      This function provides the time used to date the received bytes
+*   \ingroup Serial
+*   \return     Monotonic time (s)
+******************************************************************************/
+unsigned long Modbus_SerialTime(void)
+{
+  struct timespec Now;
+
+  clock_gettime(CLOCK_MONOTONIC, &Now);
+  return ((unsigned long)Now.tv_sec * 1000000UL + (unsigned long)(Now.tv_nsec / 1000));
+}
+
+/**************************************************************************//**
+*   \brief      This function waits for a complete frame on a serial port
+*
+*   The thread sleeps in poll() until bytes are received or the t3.5 silence
+*   following the last byte has elapsed (timerfd). The frame is available in
+*   Port->Receiver.Frame (CRC16 context in Port->Receiver.Context) until the
+*   next call on the port.
+*   \ingroup Serial
+*   \param[in,out] Port Pointer to the serial port
+*   \param[in]  Timeout Max waiting time (ms), -1 to wait without limit
+*   \return     OK if a frame has been received
+*   \return     NOK otherwise (timeout or error of the tty)
+******************************************************************************/
+t_status Modbus_SerialReceive(Modbus_Serial* Port, int Timeout)
+{
+  Modbus_Receiver* Receiver = &Port->Receiver;
+  struct pollfd Fds[2];
+  struct itimerspec Silence;
+  unsigned long long Expirations;
+  unsigned long Deadline = Modbus_SerialTime() + (unsigned long)Timeout * 1000UL;
+  unsigned long Now;
+  int Wait = -1;
+  int Length;
+
+  // The frame of the previous call has been processed
+  if (Receiver->State == MDB_RX_READY)
+  {
+    Modbus_ReceiverRelease(Receiver);
+  }
+
+  memset(&Silence, 0, sizeof(Silence));
+  Silence.it_value.tv_nsec = (long)(Receiver->FrameTimeout + 1) * 1000L;
+  Fds[0].fd = Port->fd;
+  Fds[0].events = POLLIN;
+  Fds[1].fd = Port->Timer;
+  Fds[1].events = POLLIN;
+
+  for (;;)
+  {
+    // Bytes read from the tty, possibly after the end of the previous frame
+    if (Port->PendingLength > 0)
+    {
+      if (Modbus_ReceiverPut(Receiver, Port->Pending, Port->PendingLength, Port->PendingTime) == NOK)
+      {
+        return (OK);
+      }
+      Port->PendingLength = 0;
+      timerfd_settime(Port->Timer, 0, &Silence, 0);
+    }
+
+    if (Timeout >= 0)
+    {
+      Now = Modbus_SerialTime();
+      if ((long)(Deadline - Now) <= 0)
+      {
+        return (NOK);
+      }
+      Wait = (int)((Deadline - Now + 999) / 1000);
+    }
+    Length = poll(Fds, 2, Wait);
+    if (Length < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return (NOK);
+    }
+
+    // Received bytes are handled before the end of the silence
+    if (Fds[0].revents & POLLIN)
+    {
+      Length = read(Port->fd, Port->Pending, sizeof(Port->Pending));
+      if (Length > 0)
+      {
+        Port->PendingLength = Length;
+        Port->PendingTime = Modbus_SerialTime();
+        continue;
+      }
+      if ((Length == 0) || ((errno != EAGAIN) && (errno != EINTR)))
+      {
+        return (NOK);
+      }
+    }
+    else if (Fds[0].revents & (POLLERR | POLLHUP | POLLNVAL))
+    {
+      return (NOK);
+    }
+
+    if ((Fds[1].revents & POLLIN) && (read(Port->Timer, &Expirations, sizeof(Expirations)) > 0))
+    {
+      if (Modbus_ReceiverPoll(Receiver, Modbus_SerialTime()) == OK)
+      {
+        return (OK);
+      }
+    }
+  }
+}
+
+/**************************************************************************//**
+*   \brief      This function sends a frame on a serial port
+*
+*   The function returns when the frame has been transmitted (tcdrain).
+*   \ingroup Serial
+*   \param[in]  Port Pointer to the serial port
+*   \param[in]  msg Pointer to the frame to send
+*   \return     OK if the frame has been sent
+*   \return     NOK otherwise (error of the tty)
+******************************************************************************/
+t_status Modbus_SerialSend(Modbus_Serial* Port, Modbus_View* msg)
+{
+  struct pollfd Fd;
+  int Sent = 0;
+  int Length;
+
+  Fd.fd = Port->fd;
+  Fd.events = POLLOUT;
+  while (Sent < msg->length)
+  {
+    Length = write(Port->fd, msg->data + Sent, msg->length - Sent);
+    if (Length > 0)
+    {
+      Sent += Length;
+    }
+    else if ((Length < 0) && (errno == EAGAIN))
+    {
+      poll(&Fd, 1, -1);
+    }
+    else if ((Length < 0) && (errno != EINTR))
+    {
+      return (NOK);
+    }
+  }
+  tcdrain(Port->fd);
+  return (OK);
+}
+
+/**************************************************************************//**
+*   \brief      See Modbus_SerialSend(Modbus_Serial*, Modbus_View*), for a frame stored in a Modbus_Frame
+*   \ingroup Serial
+******************************************************************************/
+t_status Modbus_SerialSend(Modbus_Serial* Port, Modbus_Frame* msg)
+{
+  Modbus_View View;
+
+  View.data = msg->data;
+  View.length = msg->length;
+  View.size = MDB_MSG_LENGTH_MAX;
+  return (Modbus_SerialSend(Port, &View));
+}
+
+/**************************************************************************//**
+*   \brief      This function waits for a request on a serial port and answers it
+*
+*   The request is served in place in the receive buffer of the port
+*   (Server_Update with the CRC16 computed while it was received).
+*   \ingroup Serial
+*   \param[in,out] Port Pointer to the serial port
+*   \param[in]  Server Pointer to the Modbus server
+*   \param[in]  Timeout Max waiting time of the request (ms), -1 to wait without limit
+*   \return     OK if a response has been sent
+*   \return     NOK otherwise (timeout, error of the tty, or request without response, 
+*               e.g. broadcast request)
+******************************************************************************/
+t_status Modbus_SerialServer(Modbus_Serial* Port, Modbus_RTU* Server, int Timeout)
+{
+  char Address;
+
+  if (Modbus_SerialReceive(Port, Timeout) == NOK)
+  {
+    return (NOK);
+  }
+
+  // Broadcast requests are served but never answered
+  Address = Port->Receiver.Frame.data[0];
+  if ((Server->Server_Update(&Port->Receiver.Frame, &Port->Receiver.Context) == NOK)
+      || (Address == (char)MDB_ADDRESS_BROADCAST))
+  {
+    return (NOK);
+  }
+  return (Modbus_SerialSend(Port, &Port->Receiver.Frame));
+}
+
+/**************************************************************************//**
+*   \brief      This function sends a request on a serial port and waits for its response
+*
+*   Bytes received before the request are dropped. The response frame stays
+*   available in Port->Receiver.Frame until the next call on the port
+*   (e.g. for Client_DecodeRegisters).
+*   \ingroup Serial
+*   \param[in,out] Port Pointer to the serial port
+*   \param[in]  Client Pointer to the Modbus client
+*   \param[in]  Request Pointer to the request frame (built by a Client_xx function)
+*   \param[out] Data Pointer to a structure which will receive the data of the response
+*               (Client_Update), or 0 (i.e. responses of more than 62 registers, decoded
+*               with Client_DecodeRegisters)
+*   \param[in]  Timeout Max waiting time of the response (ms)
+*   \return     OK if a response with a correct CRC16 has been received from the server
+*               (or the request is a broadcast). The response may be an exception response : 
+*               its function code is then the one of the request | MDB_EXCEPTION_MASK.
+*   \return     NOK otherwise (timeout, error of the tty, CRC16 error, response from another
+*               server or to another function, data which do not fit in Data)
+******************************************************************************/
+t_status Modbus_SerialClient(Modbus_Serial* Port, Modbus_RTU* Client, Modbus_View* Request, Modbus_Data* Data, int Timeout)
+{
+  Modbus_View* Response = &Port->Receiver.Frame;
+
+  tcflush(Port->fd, TCIFLUSH);
+  Port->PendingLength = 0;
+  Modbus_ReceiverRelease(&Port->Receiver);
+
+  if (Modbus_SerialSend(Port, Request) == NOK)
+  {
+    return (NOK);
+  }
+  if (Request->data[0] == (char)MDB_ADDRESS_BROADCAST)
+  {
+    return (OK);
+  }
+  if ((Modbus_SerialReceive(Port, Timeout) == NOK)
+      || (Response->data[0] != Request->data[0])
+      || ((Response->data[1] != Request->data[1]) && (Response->data[1] != (char)(Request->data[1] | MDB_EXCEPTION_MASK))))
+  {
+    return (NOK);
+  }
+  if (Data != 0)
+  {
+    return (Client->Client_Update(Response, Data, &Port->Receiver.Context));
+  }
+  return ((Modbus_CRC16Final(&Port->Receiver.Context) == 0) ? OK : NOK);
+}
+
+/**************************************************************************//**
+*   \brief      See Modbus_SerialClient(Modbus_Serial*, Modbus_RTU*, Modbus_View*, Modbus_Data*, int),
+*               for a request stored in a Modbus_Frame
+*   \ingroup Serial
+******************************************************************************/
+t_status Modbus_SerialClient(Modbus_Serial* Port, Modbus_RTU* Client, Modbus_Frame* Request, Modbus_Data* Data, int Timeout)
+{
+  Modbus_View View;
+
+  View.data = Request->data;
+  View.length = Request->length;
+  View.size = MDB_MSG_LENGTH_MAX;
+  return (Modbus_SerialClient(Port, Client, &View, Data, Timeout));
+}
+
+//=============================================================================
+// Multi-port server loop
+//=============================================================================
+// Tag of an epoll event : index of the port, and tty (0) or timer (1)
+#define MDB_LOOP_TTY      0
+#define MDB_LOOP_TIMER    1
+#define MDB_LOOP_TAG(Index, Source)   (((unsigned long long)(Index) << 1) | (Source))
+
+// Closes a port whose tty has failed (its file descriptors leave the epoll instance)
+static void Modbus_LoopDrop(Modbus_SerialLoopPort* Port)
+{
+  Modbus_SerialClose(&Port->Serial);
+  Port->QueueLength = 0;
+}
+
+// Writes the queue of a port until the tty is full, and watches the tty for writing
+// as long as bytes remain
+static void Modbus_LoopWrite(Modbus_SerialLoop* Loop, int Index)
+{
+  Modbus_SerialLoopPort* Port = &Loop->Ports[Index];
+  struct epoll_event Event;
+  int Length;
+
+  while (Port->QueueLength > 0)
+  {
+    Length = write(Port->Serial.fd, Port->Queue + Port->QueueStart, Port->QueueLength);
+    if (Length > 0)
+    {
+      Port->QueueStart += Length;
+      Port->QueueLength -= Length;
+    }
+    else if ((Length < 0) && (errno == EAGAIN))
+    {
+      break;
+    }
+    else if ((Length < 0) && (errno != EINTR))
+    {
+      Modbus_LoopDrop(Port);
+      return;
+    }
+  }
+  if (Port->QueueLength == 0)
+  {
+    Port->QueueStart = 0;
+  }
+
+  Event.events = (Port->QueueLength > 0) ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+  if (Event.events != Port->Events)
+  {
+    Event.data.u64 = MDB_LOOP_TAG(Index, MDB_LOOP_TTY);
+    epoll_ctl(Loop->fd, EPOLL_CTL_MOD, Port->Serial.fd, &Event);
+    Port->Events = Event.events;
+  }
+}
+
+// Answers the complete frame of a port (unless it is a broadcast request) and releases it
+static void Modbus_LoopServe(Modbus_SerialLoop* Loop, int Index)
+{
+  Modbus_SerialLoopPort* Port = &Loop->Ports[Index];
+  Modbus_Receiver* Receiver = &Port->Serial.Receiver;
+  Modbus_View* Frame = &Receiver->Frame;
+  char Address = Frame->data[0];
+
+  // Broadcast requests are served but never answered
+  if ((Port->Server->Server_Update(Frame, &Receiver->Context) == OK) && (Address != (char)MDB_ADDRESS_BROADCAST))
+  {
+    if (Port->QueueStart + Port->QueueLength + Frame->length > (int)sizeof(Port->Queue))
+    {
+      memmove(Port->Queue, Port->Queue + Port->QueueStart, Port->QueueLength);
+      Port->QueueStart = 0;
+    }
+    if (Port->QueueLength + Frame->length > (int)sizeof(Port->Queue))
+    {
+      Port->Overruns++;
+    }
+    else
+    {
+      memcpy(Port->Queue + Port->QueueStart + Port->QueueLength, Frame->data, Frame->length);
+      Port->QueueLength += Frame->length;
+      Port->Requests++;
+    }
+  }
+  Modbus_ReceiverRelease(Receiver);
+  Modbus_LoopWrite(Loop, Index);
+}
+
+// Reads the bytes received by a port, and restarts its timer of the t3.5 silence
+static void Modbus_LoopRead(Modbus_SerialLoop* Loop, int Index)
+{
+  Modbus_SerialLoopPort* Port = &Loop->Ports[Index];
+  Modbus_Serial* Serial = &Port->Serial;
+  struct itimerspec Silence;
+  int Length;
+
+  Length = read(Serial->fd, Serial->Pending, sizeof(Serial->Pending));
+  if (Length <= 0)
+  {
+    if ((Length == 0) || ((errno != EAGAIN) && (errno != EINTR)))
+    {
+      Modbus_LoopDrop(Port);
+    }
+    return;
+  }
+
+  // A frame completed by the silence before these bytes is answered first
+  while (Modbus_ReceiverPut(&Serial->Receiver, Serial->Pending, Length, Modbus_SerialTime()) == NOK)
+  {
+    Modbus_LoopServe(Loop, Index);
+    if (Serial->fd < 0)
+    {
+      return;
+    }
+  }
+
+  memset(&Silence, 0, sizeof(Silence));
+  Silence.it_value.tv_nsec = (long)(Serial->Receiver.FrameTimeout + 1) * 1000L;
+  timerfd_settime(Serial->Timer, 0, &Silence, 0);
+}
+
+/**************************************************************************//**
+*   \brief      This function prepares a loop serving several ports from one thread
+*
+*   Each port shall be opened (Modbus_SerialOpen or Modbus_SerialAttach) with the
+*   device given in Server, which answers the requests received on it.
+*   \ingroup SerialLoop
+*   \param[out] Loop Pointer to the loop
+*   \param[in,out] Ports Pointer to the array of ports (kept by the loop)
+*   \param[in]  Nb Number of ports
+*   \return     OK if the loop is ready
+*   \return     NOK otherwise (errno gives the reason)
+******************************************************************************/
+t_status Modbus_SerialLoopInit(Modbus_SerialLoop* Loop, Modbus_SerialLoopPort* Ports, int Nb)
+{
+  struct epoll_event Event;
+  int i;
+
+  Loop->Ports = Ports;
+  Loop->Nb = Nb;
+  Loop->fd = epoll_create1(EPOLL_CLOEXEC);
+  if (Loop->fd < 0)
+  {
+    return (NOK);
+  }
+
+  for (i = 0; i < Nb; i++)
+  {
+    Ports[i].QueueStart = 0;
+    Ports[i].QueueLength = 0;
+    Ports[i].Events = EPOLLIN;
+    Ports[i].Requests = 0;
+    Ports[i].Overruns = 0;
+
+    Event.events = EPOLLIN;
+    Event.data.u64 = MDB_LOOP_TAG(i, MDB_LOOP_TTY);
+    if (epoll_ctl(Loop->fd, EPOLL_CTL_ADD, Ports[i].Serial.fd, &Event) != 0)
+    {
+      break;
+    }
+    Event.data.u64 = MDB_LOOP_TAG(i, MDB_LOOP_TIMER);
+    if (epoll_ctl(Loop->fd, EPOLL_CTL_ADD, Ports[i].Serial.Timer, &Event) != 0)
+    {
+      break;
+    }
+  }
+  if (i < Nb)
+  {
+    close(Loop->fd);
+    Loop->fd = -1;
+    return (NOK);
+  }
+  return (OK);
+}
+
+/**************************************************************************//**
+*   \brief      This function waits for the events of the ports of a loop and handles them
+*
+*   Received bytes are given to the receivers of their ports, complete requests
+*   are answered and responses are written as far as the ttys can take them.
+*   The bytes received by all ports are read before the ends of silences are
+*   checked. A port whose tty fails is closed (Serial.fd is -1) and no longer
+*   served.
+*   \ingroup SerialLoop
+*   \param[in,out] Loop Pointer to the loop
+*   \param[in]  Timeout Max waiting time of an event (ms), -1 to wait without limit
+*   \return     OK if the events have been handled (or the time has elapsed)
+*   \return     NOK otherwise (error of the epoll instance)
+******************************************************************************/
+t_status Modbus_SerialLoopUpdate(Modbus_SerialLoop* Loop, int Timeout)
+{
+  struct epoll_event Events[MDB_SERIAL_EVENTS_MAX];
+  Modbus_SerialLoopPort* Port;
+  unsigned long long Expirations;
+  int Nb;
+  int Index;
+  int i;
+
+  Nb = epoll_wait(Loop->fd, Events, MDB_SERIAL_EVENTS_MAX, Timeout);
+  if (Nb < 0)
+  {
+    return ((errno == EINTR) ? OK : NOK);
+  }
+
+  // Ttys
+  for (i = 0; i < Nb; i++)
+  {
+    Index = (int)(Events[i].data.u64 >> 1);
+    Port = &Loop->Ports[Index];
+    if (((Events[i].data.u64 & 1) != MDB_LOOP_TTY) || (Port->Serial.fd < 0))
+    {
+      continue;
+    }
+    if (Events[i].events & EPOLLIN)
+    {
+      Modbus_LoopRead(Loop, Index);
+    }
+    else if (Events[i].events & (EPOLLERR | EPOLLHUP))
+    {
+      Modbus_LoopDrop(Port);
+    }
+    if ((Events[i].events & EPOLLOUT) && (Port->Serial.fd >= 0))
+    {
+      Modbus_LoopWrite(Loop, Index);
+    }
+  }
+
+  // Ends of silences
+  for (i = 0; i < Nb; i++)
+  {
+    Index = (int)(Events[i].data.u64 >> 1);
+    Port = &Loop->Ports[Index];
+    if (((Events[i].data.u64 & 1) != MDB_LOOP_TIMER) || (Port->Serial.fd < 0))
+    {
+      continue;
+    }
+    if ((read(Port->Serial.Timer, &Expirations, sizeof(Expirations)) > 0)
+        && (Modbus_ReceiverPoll(&Port->Serial.Receiver, Modbus_SerialTime()) == OK))
+    {
+      Modbus_LoopServe(Loop, Index);
+    }
+  }
+  return (OK);
+}
+
+/**************************************************************************//**
+*   \brief      This function closes a loop and its ports
+*   \ingroup SerialLoop
+*   \param[in,out] Loop Pointer to the loop
+******************************************************************************/
+void Modbus_SerialLoopClose(Modbus_SerialLoop* Loop)
+{
+  int i;
+
+  for (i = 0; i < Loop->Nb; i++)
+  {
+    Modbus_SerialClose(&Loop->Ports[i].Serial);
+  }
+  if (Loop->fd >= 0)
+  {
+    close(Loop->fd);
+    Loop->fd = -1;
+  }
+}
+#endif
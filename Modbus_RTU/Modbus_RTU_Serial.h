@@ -0,0 +1,133 @@
+/*
+  Modbus_RTU_Serial.h - Serial transport of Modbus_RTU for Linux hosts
+  Copyright (c) 2012 Gilles De Vos.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/***********************************************************************//**
+* \defgroup Serial Serial transport (Linux)
+* A serial port (tty) is configured with the baudrate and parity of a device,
+* optionally with the RS-485 direction control of the kernel driver. Received
+* bytes are assembled by a Modbus_Receiver : the port waits with poll() on the
+* tty and on a timerfd armed for the t3.5 silence, so no thread spins while
+* the bus is idle.
+*
+* Example (server):
+* \code
+* Modbus_Serial Port;
+*
+* if (Modbus_SerialOpen(&Port, &myServer, "/dev/ttyUSB0", MDB_SERIAL_RS485) == OK)
+* {
+*   while (1)
+*   {
+*     Modbus_SerialServer(&Port, &myServer, -1);
+*   }
+* }
+* \endcode
+***************************************************************************/
+
+/***********************************************************************//**
+* \defgroup SerialLoop Multi-port server loop (Linux)
+* Several servers, each on its own serial port, are served by a single thread.
+* The ttys and the timers of the t3.5 silences of all ports are watched by one
+* epoll instance; responses are written without blocking, the rest of a
+* response being sent when the tty can take it again.
+*
+* Example:
+* \code
+* Modbus_SerialLoopPort Ports[2];
+* Modbus_SerialLoop Loop;
+*
+* Modbus_SerialOpen(&Ports[0].Serial, &myServer1, "/dev/ttyS1", MDB_SERIAL_RS485);
+* Ports[0].Server = &myServer1;
+* Modbus_SerialOpen(&Ports[1].Serial, &myServer2, "/dev/ttyS2", MDB_SERIAL_RS485);
+* Ports[1].Server = &myServer2;
+* if (Modbus_SerialLoopInit(&Loop, Ports, 2) == OK)
+* {
+*   while (1)
+*   {
+*     Modbus_SerialLoopUpdate(&Loop, -1);
+*   }
+* }
+* \endcode
+***************************************************************************/
+
+#ifndef Modbus_RTU_Serial_h
+#define Modbus_RTU_Serial_h
+
+#if defined(__linux__)
+
+// Include files //////////////////////////////////////////////////////////////
+#include "Modbus_RTU.h"
+
+// Serial port options
+#define MDB_SERIAL_RS485  0x01    ///< Direction control of the RS-485 transceiver by the kernel driver (TIOCSRS485)
+
+#define MDB_SERIAL_EVENTS_MAX   64    ///< Max number of events handled by one call of Modbus_SerialLoopUpdate
+
+// Modbus serial port structure
+typedef struct
+{
+  int fd;                             ///< File descriptor of the tty (-1 if the port is closed)
+  int Timer;                          ///< File descriptor of the timer of the t3.5 silence
+  Modbus_Receiver Receiver;           ///< Frame assembler (frame valid until the next call on the port)
+  char Buffer[MDB_MSG_LENGTH_MAX];    ///< Receive buffer of the frames
+  char Pending[MDB_MSG_LENGTH_MAX];   ///< Bytes read after the end of a frame, not yet given to the receiver
+  int PendingLength;                  ///< Number of pending bytes
+  unsigned long PendingTime;          ///< Reception time of the pending bytes
+} Modbus_Serial;
+
+// Port of a multi-port server loop
+typedef struct
+{
+  Modbus_Serial Serial;                 ///< Serial port (opened before Modbus_SerialLoopInit, closed if its tty fails)
+  Modbus_RTU* Server;                   ///< Server answering on the port
+  char Queue[2 * MDB_MSG_LENGTH_MAX];   ///< Responses not written yet
+  int QueueStart;                       ///< Index of the first byte to write in the queue
+  int QueueLength;                      ///< Number of bytes to write
+  unsigned int Events;                  ///< Events of the tty watched by the loop
+  unsigned long Requests;               ///< Number of answered requests
+  unsigned long Overruns;               ///< Number of responses dropped (queue full)
+} Modbus_SerialLoopPort;
+
+// Multi-port server loop
+typedef struct
+{
+  int fd;                               ///< File descriptor of the epoll instance
+  Modbus_SerialLoopPort* Ports;         ///< Ports of the loop
+  int Nb;                               ///< Number of ports
+} Modbus_SerialLoop;
+
+// Serial transport functions ///////////////////////////////////////////////
+t_status Modbus_SerialOpen(Modbus_Serial* Port, Modbus_RTU* Device, const char* Path, int Options);
+t_status Modbus_SerialAttach(Modbus_Serial* Port, Modbus_RTU* Device, int fd, int Options);
+void Modbus_SerialClose(Modbus_Serial* Port);
+t_status Modbus_SerialReceive(Modbus_Serial* Port, int Timeout);
+t_status Modbus_SerialSend(Modbus_Serial* Port, Modbus_View* msg);
+t_status Modbus_SerialSend(Modbus_Serial* Port, Modbus_Frame* msg);
+t_status Modbus_SerialServer(Modbus_Serial* Port, Modbus_RTU* Server, int Timeout);
+t_status Modbus_SerialClient(Modbus_Serial* Port, Modbus_RTU* Client, Modbus_View* Request, Modbus_Data* Data, int Timeout);
+t_status Modbus_SerialClient(Modbus_Serial* Port, Modbus_RTU* Client, Modbus_Frame* Request, Modbus_Data* Data, int Timeout);
+unsigned long Modbus_SerialTime(void);
+
+// Multi-port server loop functions //////////////////////////////////////////
+t_status Modbus_SerialLoopInit(Modbus_SerialLoop* Loop, Modbus_SerialLoopPort* Ports, int Nb);
+t_status Modbus_SerialLoopUpdate(Modbus_SerialLoop* Loop, int Timeout);
+void Modbus_SerialLoopClose(Modbus_SerialLoop* Loop);
+
+#endif
+
+#endif
@@ -0,0 +1,1053 @@
+/*
+  Modbus_RTU_TCP.cpp - Modbus TCP server front-end of Modbus_RTU for Linux hosts
+  Copyright (c) 2012 Gilles De Vos.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// Include files //////////////////////////////////////////////////////////////
+#include "Modbus_RTU_TCP.h"
+
+#if defined(__linux__)
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <termios.h>
+#include <sys/timerfd.h>
+
+// Macro definitions
+#define GET_WORD(p)     ((((unsigned short)(*(p))& 0x0ff) << 8) | (*((p)+1)& 0x0ff))
+#define PUT_WORD(p, x)  {*(p) = ((x) >> 8) & 0x0ff; *((p)+1) = (x) & 0x0ff;}
+
+//=============================================================================
+// Private functions
+//=============================================================================
+// Tag of an epoll event : listening socket (0), index of the connection + 1,
+// or index of a gateway line with the source of the event (tty, timers)
+#define MDB_TCP_LISTEN    0
+#define MDB_TCP_TAG(Index)    ((unsigned long long)(Index) + 1)
+#define MDB_LINE_TTY        0
+#define MDB_LINE_SILENCE    1
+#define MDB_LINE_RESPONSE   2
+#define MDB_LINE_FLAG       (1ULL << 32)
+#define MDB_LINE_TAG(Index, Source)   (MDB_LINE_FLAG | ((unsigned long long)(Index) << 2) | (Source))
+
+static void Modbus_GatewayCancel(Modbus_Gateway* Gateway, int Connection);
+static t_status Modbus_GatewayRequest(Modbus_TCPServer* Tcp, int Index, Modbus_View* msg);
+
+// Closes a connection and gives it back to the free list
+static void Modbus_TCPDrop(Modbus_TCPServer* Tcp, int Index)
+{
+  Modbus_TCPConnection* Connection = &Tcp->Connections[Index];
+
+  close(Connection->fd);
+  Connection->fd = -1;
+  Connection->Next = Tcp->Free;
+  Tcp->Free = Index;
+  if (Tcp->Gateway != 0)
+  {
+    Modbus_GatewayCancel(Tcp->Gateway, Index);
+  }
+}
+
+// Checks whether the queue of a connection can take one more response, besides the
+// responses of the gateway which are still expected
+static bool Modbus_TCPRoom(Modbus_TCPConnection* Connection)
+{
+  return (Connection->TxLength + (Connection->Pending + 1) * MDB_TCP_LENGTH_MAX <= (int)sizeof(Connection->Tx));
+}
+
+// Adds a response to the queue of a connection (room shall be available)
+static void Modbus_TCPQueue(Modbus_TCPConnection* Connection, const char* Frame, int Length)
+{
+  if (Connection->TxStart + Connection->TxLength + Length > (int)sizeof(Connection->Tx))
+  {
+    memmove(Connection->Tx, Connection->Tx + Connection->TxStart, Connection->TxLength);
+    Connection->TxStart = 0;
+  }
+  memcpy(Connection->Tx + Connection->TxStart + Connection->TxLength, Frame, Length);
+  Connection->TxLength += Length;
+}
+
+// Turns a Modbus TCP request into an exception response, returns its length
+static int Modbus_TCPException(char* Frame, int Code)
+{
+  Frame[4] = 0;
+  Frame[5] = 3;
+  Frame[MDB_TCP_HEADER_LENGTH + 1] |= MDB_EXCEPTION_MASK;
+  Frame[MDB_TCP_HEADER_LENGTH + 2] = (char)Code;
+  return (MDB_TCP_HEADER_LENGTH + 3);
+}
+
+// Watches the socket of a connection for reading as long as a response can be queued,
+// and for writing as long as bytes remain in the queue
+static void Modbus_TCPWatch(Modbus_TCPServer* Tcp, int Index)
+{
+  Modbus_TCPConnection* Connection = &Tcp->Connections[Index];
+  struct epoll_event Event;
+
+  Event.events = 0;
+  if (Modbus_TCPRoom(Connection))
+  {
+    Event.events |= EPOLLIN;
+  }
+  if (Connection->TxLength > 0)
+  {
+    Event.events |= EPOLLOUT;
+  }
+  if (Event.events != Connection->Events)
+  {
+    Event.data.u64 = MDB_TCP_TAG(Index);
+    epoll_ctl(Tcp->Epoll, EPOLL_CTL_MOD, Connection->fd, &Event);
+    Connection->Events = Event.events;
+  }
+}
+
+// Answers the complete requests of a connection while their responses can be queued
+// (returns NOK if the connection does not carry Modbus TCP frames)
+static t_status Modbus_TCPServe(Modbus_TCPServer* Tcp, int Index)
+{
+  Modbus_TCPConnection* Connection = &Tcp->Connections[Index];
+  char Buffer[MDB_TCP_LENGTH_MAX];
+  Modbus_View View;
+  int Start = 0;
+  int Length;
+
+  while (Connection->RxLength - Start >= MDB_TCP_HEADER_LENGTH)
+  {
+    Length = MDB_TCP_HEADER_LENGTH + ((((unsigned char)Connection->Rx[Start + 4]) << 8) | (unsigned char)Connection->Rx[Start + 5]);
+    if (Length > MDB_TCP_LENGTH_MAX)
+    {
+      return (NOK);
+    }
+    if ((Connection->RxLength - Start < Length) || !Modbus_TCPRoom(Connection))
+    {
+      break;
+    }
+
+    // The response may be longer than the request : it is built out of the receive buffer
+    memcpy(Buffer, Connection->Rx + Start, Length);
+    View.data = Buffer;
+    View.length = (unsigned short)Length;
+    View.size = sizeof(Buffer);
+    Start += Length;
+
+    // Requests to the units of the serial lines are answered later by the gateway
+    if ((Tcp->Gateway != 0) && (Length > MDB_TCP_HEADER_LENGTH) &&
+        (Tcp->Gateway->Route[(unsigned char)Buffer[MDB_TCP_HEADER_LENGTH]] >= 0))
+    {
+      if (Modbus_GatewayRequest(Tcp, Index, &View) == OK)
+      {
+        continue;
+      }
+    }
+    else if (Tcp->Server->Server_UpdateTCP(&View) == NOK)
+    {
+      return (NOK);
+    }
+    if (View.length == 0)
+    {
+      return (NOK);
+    }
+    Modbus_TCPQueue(Connection, View.data, View.length);
+  }
+
+  // Beginning of the next request
+  if (Start > 0)
+  {
+    Connection->RxLength -= Start;
+    memmove(Connection->Rx, Connection->Rx + Start, Connection->RxLength);
+  }
+  return (OK);
+}
+
+// Writes the queue of a connection until the socket is full
+// (returns NOK if the connection has failed)
+static t_status Modbus_TCPWrite(Modbus_TCPServer* Tcp, int Index)
+{
+  Modbus_TCPConnection* Connection = &Tcp->Connections[Index];
+  int Length;
+
+  while (Connection->TxLength > 0)
+  {
+    Length = send(Connection->fd, Connection->Tx + Connection->TxStart, Connection->TxLength, MSG_NOSIGNAL);
+    if (Length > 0)
+    {
+      Connection->TxStart += Length;
+      Connection->TxLength -= Length;
+    }
+    else if ((Length < 0) && (errno == EAGAIN))
+    {
+      return (OK);
+    }
+    else if ((Length < 0) && (errno != EINTR))
+    {
+      return (NOK);
+    }
+  }
+  Connection->TxStart = 0;
+  return (OK);
+}
+
+// Serves the received requests of a connection and writes their responses
+static void Modbus_TCPService(Modbus_TCPServer* Tcp, int Index)
+{
+  Modbus_TCPConnection* Connection = &Tcp->Connections[Index];
+
+  do
+  {
+    if ((Modbus_TCPServe(Tcp, Index) == NOK) || (Modbus_TCPWrite(Tcp, Index) == NOK))
+    {
+      Modbus_TCPDrop(Tcp, Index);
+      return;
+    }
+  }
+  // Requests left for lack of room in the queue, which has been written since
+  while (Modbus_TCPRoom(Connection) &&
+         (Connection->RxLength >= MDB_TCP_HEADER_LENGTH) &&
+         (Connection->RxLength >= MDB_TCP_HEADER_LENGTH + ((((unsigned char)Connection->Rx[4]) << 8) | (unsigned char)Connection->Rx[5])));
+  Modbus_TCPWatch(Tcp, Index);
+}
+
+// Reads the bytes received on a connection
+static void Modbus_TCPRead(Modbus_TCPServer* Tcp, int Index)
+{
+  Modbus_TCPConnection* Connection = &Tcp->Connections[Index];
+  int Length;
+
+  if (Connection->RxLength >= (int)sizeof(Connection->Rx))
+  {
+    return;
+  }
+  Length = recv(Connection->fd, Connection->Rx + Connection->RxLength, sizeof(Connection->Rx) - Connection->RxLength, 0);
+  if (Length > 0)
+  {
+    Connection->RxLength += Length;
+    Modbus_TCPService(Tcp, Index);
+  }
+  else if ((Length == 0) || ((errno != EAGAIN) && (errno != EINTR)))
+  {
+    // Connection closed by the client
+    Modbus_TCPDrop(Tcp, Index);
+  }
+}
+
+// Accepts the pending connections
+static void Modbus_TCPAccept(Modbus_TCPServer* Tcp)
+{
+  Modbus_TCPConnection* Connection;
+  struct epoll_event Event;
+  int NoDelay = 1;
+  int Index;
+  int fd;
+
+  for (;;)
+  {
+    fd = accept4(Tcp->fd, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return;
+    }
+    if (Tcp->Free < 0)
+    {
+      close(fd);
+      Tcp->Refused++;
+      continue;
+    }
+
+    // Responses are sent at once, not delayed to be merged with the next ones
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &NoDelay, sizeof(NoDelay));
+
+    Index = Tcp->Free;
+    Connection = &Tcp->Connections[Index];
+    Event.events = EPOLLIN;
+    Event.data.u64 = MDB_TCP_TAG(Index);
+    if (epoll_ctl(Tcp->Epoll, EPOLL_CTL_ADD, fd, &Event) != 0)
+    {
+      close(fd);
+      Tcp->Refused++;
+      continue;
+    }
+    Tcp->Free = Connection->Next;
+    Connection->fd = fd;
+    Connection->RxLength = 0;
+    Connection->TxStart = 0;
+    Connection->TxLength = 0;
+    Connection->Events = EPOLLIN;
+    Connection->Pending = 0;
+    Tcp->Accepted++;
+  }
+}
+
+//=============================================================================
+// Gateway private functions
+//=============================================================================
+// Removes the requests of a closed connection from the transactions of the lines
+static void Modbus_GatewayCancel(Modbus_Gateway* Gateway, int Connection)
+{
+  Modbus_GatewayTransaction* Transaction;
+  Modbus_GatewayLine* Line;
+  int l, t, i, j;
+
+  for (l = 0; l < Gateway->Nb; l++)
+  {
+    Line = &Gateway->Lines[l];
+    for (t = 0; t < Line->Nb; t++)
+    {
+      Transaction = &Line->Queue[(Line->First + t) % MDB_GATEWAY_QUEUE_LENGTH];
+      for (i = 0, j = 0; i < Transaction->NbWaiters; i++)
+      {
+        if (Transaction->Waiters[i].Connection != Connection)
+        {
+          Transaction->Waiters[j++] = Transaction->Waiters[i];
+        }
+      }
+      Transaction->NbWaiters = j;
+    }
+  }
+}
+
+// Writes the request of the transaction on the bus until the tty is full, then starts
+// the response timeout once it is written
+static void Modbus_GatewayWrite(Modbus_TCPServer* Tcp, int Index)
+{
+  Modbus_GatewayLine* Line = &Tcp->Gateway->Lines[Index];
+  Modbus_Frame* Request = &Line->Queue[Line->First].Request;
+  struct epoll_event Event;
+  struct itimerspec Timeout;
+  unsigned long Delay;
+  int Length;
+
+  while (Line->Sent < Request->length)
+  {
+    Length = write(Line->Serial.fd, Request->data + Line->Sent, Request->length - Line->Sent);
+    if (Length > 0)
+    {
+      Line->Sent += Length;
+    }
+    else if ((Length < 0) && (errno == EAGAIN))
+    {
+      break;
+    }
+    else if ((Length < 0) && (errno != EINTR))
+    {
+      // No response can come : the transaction ends with the timeout
+      Line->Sent = Request->length;
+    }
+  }
+
+  Event.events = EPOLLIN;
+  if (Line->Sent == Request->length)
+  {
+    // Response time, from the end of the transmission of the request
+    Delay = (unsigned long)Line->Timeout * 1000UL + Request->length * Line->Serial.Receiver.CharTime;
+    memset(&Timeout, 0, sizeof(Timeout));
+    Timeout.it_value.tv_sec = Delay / 1000000UL;
+    Timeout.it_value.tv_nsec = (long)(Delay % 1000000UL) * 1000L;
+    timerfd_settime(Line->Timer, 0, &Timeout, 0);
+  }
+  else
+  {
+    Event.events |= EPOLLOUT;
+  }
+  if (Event.events != Line->Events)
+  {
+    Event.data.u64 = MDB_LINE_TAG(Index, MDB_LINE_TTY);
+    epoll_ctl(Tcp->Epoll, EPOLL_CTL_MOD, Line->Serial.fd, &Event);
+    Line->Events = Event.events;
+  }
+}
+
+// Sends the oldest transaction of a line if the bus is free
+static void Modbus_GatewaySend(Modbus_TCPServer* Tcp, int Index)
+{
+  Modbus_GatewayLine* Line = &Tcp->Gateway->Lines[Index];
+
+  if ((Line->Sent >= 0) || (Line->Serial.fd < 0))
+  {
+    return;
+  }
+
+  // Transactions whose clients have all gone are not sent
+  while ((Line->Nb > 0) && (Line->Queue[Line->First].NbWaiters == 0))
+  {
+    Line->First = (Line->First + 1) % MDB_GATEWAY_QUEUE_LENGTH;
+    Line->Nb--;
+  }
+  if (Line->Nb == 0)
+  {
+    return;
+  }
+
+  // Bytes received before the request are not part of its response
+  tcflush(Line->Serial.fd, TCIFLUSH);
+  Modbus_ReceiverRelease(&Line->Serial.Receiver);
+  Line->Sent = 0;
+  Line->Transactions++;
+  Modbus_GatewayWrite(Tcp, Index);
+}
+
+// Answers the TCP requests of the transaction on the bus with the response frame
+// (0 for a gateway exception), then sends the next transaction
+static void Modbus_GatewayComplete(Modbus_TCPServer* Tcp, int Index, Modbus_View* Frame)
+{
+  Modbus_GatewayLine* Line = &Tcp->Gateway->Lines[Index];
+  Modbus_GatewayTransaction* Transaction = &Line->Queue[Line->First];
+  Modbus_GatewayWaiter Waiters[MDB_GATEWAY_WAITERS_MAX];
+  Modbus_TCPConnection* Connection;
+  char Buffer[MDB_TCP_LENGTH_MAX];
+  struct itimerspec Stop;
+  int NbWaiters = Transaction->NbWaiters;
+  int Length;
+  int i;
+
+  // Unit identifier and PDU of the response
+  if (Frame != 0)
+  {
+    Length = Frame->length - 2;
+    memcpy(Buffer + MDB_TCP_HEADER_LENGTH, Frame->data, Length);
+  }
+  else
+  {
+    Length = 3;
+    Buffer[MDB_TCP_HEADER_LENGTH] = Transaction->Request.data[0];
+    Buffer[MDB_TCP_HEADER_LENGTH + 1] = Transaction->Request.data[1] | MDB_EXCEPTION_MASK;
+    Buffer[MDB_TCP_HEADER_LENGTH + 2] = MDB_EXCEPTION_GATEWAY_TARGET_FAILED;
+  }
+  Buffer[2] = 0;
+  Buffer[3] = 0;
+  PUT_WORD(&Buffer[4], Length);
+  memcpy(Waiters, Transaction->Waiters, NbWaiters * sizeof(Modbus_GatewayWaiter));
+
+  // The transaction leaves the line before its clients can queue new ones
+  memset(&Stop, 0, sizeof(Stop));
+  timerfd_settime(Line->Timer, 0, &Stop, 0);
+  Line->First = (Line->First + 1) % MDB_GATEWAY_QUEUE_LENGTH;
+  Line->Nb--;
+  Line->Sent = -1;
+
+  for (i = 0; i < NbWaiters; i++)
+  {
+    Connection = &Tcp->Connections[Waiters[i].Connection];
+    if (Connection->fd < 0)
+    {
+      continue;
+    }
+    PUT_WORD(&Buffer[0], Waiters[i].Transaction);
+    Connection->Pending--;
+    Modbus_TCPQueue(Connection, Buffer, MDB_TCP_HEADER_LENGTH + Length);
+    Modbus_TCPService(Tcp, Waiters[i].Connection);
+  }
+  Modbus_GatewaySend(Tcp, Index);
+}
+
+// Answers the transaction on the bus if the received frame is its response, then
+// releases the frame
+static void Modbus_GatewayFrame(Modbus_TCPServer* Tcp, int Index)
+{
+  Modbus_GatewayLine* Line = &Tcp->Gateway->Lines[Index];
+  Modbus_Receiver* Receiver = &Line->Serial.Receiver;
+  Modbus_View* Frame = &Receiver->Frame;
+  Modbus_GatewayTransaction* Transaction = &Line->Queue[Line->First];
+
+  if ((Line->Nb > 0) && (Line->Sent == Transaction->Request.length) &&
+      (Frame->data[0] == Transaction->Request.data[0]) &&
+      (((Frame->data[1] == Transaction->Request.data[1]) &&
+        ((Transaction->ResponseLength == 0) || (Frame->length == Transaction->ResponseLength))) ||
+       ((Frame->data[1] == (char)(Transaction->Request.data[1] | MDB_EXCEPTION_MASK)) && (Frame->length == 5))) &&
+      (Modbus_CRC16Final(&Receiver->Context) == 0))
+  {
+    Modbus_GatewayComplete(Tcp, Index, Frame);
+  }
+  Modbus_ReceiverRelease(Receiver);
+}
+
+// Closes a line whose tty has failed, its transactions are answered with an exception
+static void Modbus_GatewayFail(Modbus_TCPServer* Tcp, int Index)
+{
+  Modbus_GatewayLine* Line = &Tcp->Gateway->Lines[Index];
+
+  Modbus_SerialClose(&Line->Serial);
+  while (Line->Nb > 0)
+  {
+    Modbus_GatewayComplete(Tcp, Index, 0);
+  }
+}
+
+// Reads the bytes received on a line, and restarts its timer of the t3.5 silence
+static void Modbus_GatewayRead(Modbus_TCPServer* Tcp, int Index)
+{
+  Modbus_GatewayLine* Line = &Tcp->Gateway->Lines[Index];
+  Modbus_Serial* Serial = &Line->Serial;
+  struct itimerspec Silence;
+  unsigned long Count;
+  int Length;
+
+  Length = read(Serial->fd, Serial->Pending, sizeof(Serial->Pending));
+  if (Length <= 0)
+  {
+    if ((Length == 0) || ((errno != EAGAIN) && (errno != EINTR)))
+    {
+      Modbus_GatewayFail(Tcp, Index);
+    }
+    return;
+  }
+
+  // Only a response to the transaction on the bus is expected, the bytes following
+  // its response are dropped
+  if ((Line->Nb == 0) || (Line->Sent != Line->Queue[Line->First].Request.length))
+  {
+    return;
+  }
+  Count = Line->Transactions;
+  while (Modbus_ReceiverPut(&Serial->Receiver, Serial->Pending, Length, Modbus_SerialTime()) == NOK)
+  {
+    Modbus_GatewayFrame(Tcp, Index);
+    if ((Line->Transactions != Count) || (Line->Sent != Line->Queue[Line->First].Request.length))
+    {
+      return;
+    }
+  }
+
+  memset(&Silence, 0, sizeof(Silence));
+  Silence.it_value.tv_nsec = (long)(Serial->Receiver.FrameTimeout + 1) * 1000L;
+  timerfd_settime(Serial->Timer, 0, &Silence, 0);
+}
+
+// Builds the bus transaction of a request for a unit of a serial line, or merges it with an
+// identical read received shortly before (returns NOK if msg has been turned into an
+// immediate response, of length 0 if the request is not a Modbus TCP frame)
+static t_status Modbus_GatewayRequest(Modbus_TCPServer* Tcp, int Index, Modbus_View* msg)
+{
+  Modbus_Gateway* Gateway = Tcp->Gateway;
+  char* Frame = msg->data;
+  char* Pdu = Frame + MDB_TCP_HEADER_LENGTH + 1;
+  int PduLength = msg->length - MDB_TCP_HEADER_LENGTH - 1;
+  int Unit = (unsigned char)Frame[MDB_TCP_HEADER_LENGTH];
+  int LineIndex = Gateway->Route[Unit];
+  Modbus_GatewayLine* Line = &Gateway->Lines[LineIndex];
+  Modbus_RTU* Client = Line->Client;
+  Modbus_GatewayTransaction* Transaction;
+  Modbus_Frame Request;
+  unsigned short ResponseLength = 0;
+  unsigned long Now;
+  t_status Status = NOK;
+  Modbus_View View;
+#if defined(MDB_FUNCTIONCODE_01) || defined(MDB_FUNCTIONCODE_02) || defined(MDB_FUNCTIONCODE_03) || defined(MDB_FUNCTIONCODE_04)
+  Modbus_Request Read;
+#endif
+#if defined(MDB_FUNCTIONCODE_16) || defined(MDB_FUNCTIONCODE_23)
+  Modbus_Data Data;
+  int Nb;
+  int i;
+#endif
+  unsigned short CRC16;
+
+  if ((GET_WORD(&Frame[2]) != 0) || (PduLength < 1) || (GET_WORD(&Frame[4]) != PduLength + 1))
+  {
+    msg->length = 0;
+    return (NOK);
+  }
+  if (Line->Serial.fd < 0)
+  {
+    msg->length = Modbus_TCPException(Frame, MDB_EXCEPTION_GATEWAY_PATH_UNAVAILABLE);
+    return (NOK);
+  }
+
+  // RTU request built by the client of the line
+  View.data = Request.data;
+  View.length = 0;
+  View.size = sizeof(Request.data);
+  switch (Pdu[0])
+  {
+#if defined(MDB_FUNCTIONCODE_01) || defined(MDB_FUNCTIONCODE_02) || defined(MDB_FUNCTIONCODE_03) || defined(MDB_FUNCTIONCODE_04)
+    case MDB_FC01:
+    case MDB_FC02:
+    case MDB_FC03:
+    case MDB_FC04:
+        if ((PduLength == 5) && (Client->Client_BuildRequest(&Read, Unit, Pdu[0], GET_WORD(&Pdu[1]), GET_WORD(&Pdu[3])) == OK))
+        {
+          memcpy(Request.data, Read.data, Read.length);
+          View.length = Read.length;
+          ResponseLength = Read.ResponseLength;
+          Status = OK;
+        }
+        break;
+#endif
+#if defined(MDB_FUNCTIONCODE_06)
+    case MDB_FC06:
+        if (PduLength == 5)
+        {
+          Status = Client->Client_PresetSingleRegister(Unit, GET_WORD(&Pdu[1]), GET_WORD(&Pdu[3]), &View);
+          ResponseLength = 8;
+        }
+        break;
+#endif
+#if defined(MDB_FUNCTIONCODE_16)
+    case MDB_FC16:
+        Nb = GET_WORD(&Pdu[3]);
+        if ((Nb >= 1) && (Nb <= MDB_REG_NUMBER_MAX) && (PduLength == 6 + 2 * Nb) && ((unsigned char)Pdu[5] == 2 * Nb))
+        {
+          Data.length = Nb;
+          Data.type = MDB_WORD;
+          for (i = 0; i < Nb; i++)
+          {
+            Data.data[i] = GET_WORD(&Pdu[6 + 2 * i]);
+          }
+          Status = Client->Client_PresetMultipleRegisters(Unit, GET_WORD(&Pdu[1]), &Data, &View);
+          ResponseLength = 8;
+        }
+        break;
+#endif
+#if defined(MDB_FUNCTIONCODE_23)
+    case MDB_FC23:
+        Nb = GET_WORD(&Pdu[7]);
+        if ((PduLength >= 10) && (GET_WORD(&Pdu[3]) >= 1) && (GET_WORD(&Pdu[3]) <= MDB_REG_NUMBER_MAX) &&
+            (Nb >= 1) && (Nb <= MDB_REG_NUMBER_MAX_FC23) && (PduLength == 10 + 2 * Nb) && ((unsigned char)Pdu[9] == 2 * Nb))
+        {
+          Data.length = Nb;
+          Data.type = MDB_WORD;
+          for (i = 0; i < Nb; i++)
+          {
+            Data.data[i] = GET_WORD(&Pdu[10 + 2 * i]);
+          }
+          Status = Client->Client_ReadWriteMultipleRegisters(Unit, GET_WORD(&Pdu[1]), GET_WORD(&Pdu[3]), GET_WORD(&Pdu[5]), &Data, &View);
+          ResponseLength = 5 + 2 * GET_WORD(&Pdu[3]);
+        }
+        break;
+#endif
+    default:
+        // Other function codes are forwarded as they are
+        if (PduLength + 3 <= (int)sizeof(Request.data))
+        {
+          Request.data[0] = (char)Unit;
+          memcpy(&Request.data[1], Pdu, PduLength);
+          View.length = PduLength + 3;
+          Status = Client->GetCRC16(&View, &CRC16);
+          PUT_WORD(&Request.data[View.length - 2], CRC16);
+        }
+        break;
+  }
+  if (Status == NOK)
+  {
+    msg->length = Modbus_TCPException(Frame, MDB_EXCEPTION_ILLEGAL_DATA_VALUE);
+    return (NOK);
+  }
+  Request.length = View.length;
+
+  // Identical read waiting for the bus, or on the bus and received shortly before : 
+  // its response answers this request too
+  Now = Modbus_SerialTime();
+  if ((Pdu[0] == MDB_FC03) || (Pdu[0] == MDB_FC04))
+  {
+    for (i = 0; i < Line->Nb; i++)
+    {
+      Transaction = &Line->Queue[(Line->First + i) % MDB_GATEWAY_QUEUE_LENGTH];
+      if ((Transaction->Request.length == Request.length) &&
+          (memcmp(Transaction->Request.data, Request.data, Request.length) == 0) &&
+          ((i > 0) || (Line->Sent < 0) || (Now - Transaction->Time <= Gateway->Window)) &&
+          (Transaction->NbWaiters < MDB_GATEWAY_WAITERS_MAX))
+      {
+        Transaction->Waiters[Transaction->NbWaiters].Connection = Index;
+        Transaction->Waiters[Transaction->NbWaiters].Transaction = GET_WORD(&Frame[0]);
+        Transaction->NbWaiters++;
+        Tcp->Connections[Index].Pending++;
+        Line->Merged++;
+        return (OK);
+      }
+    }
+  }
+
+  if (Line->Nb == MDB_GATEWAY_QUEUE_LENGTH)
+  {
+    msg->length = Modbus_TCPException(Frame, MDB_EXCEPTION_SERVER_DEVICE_BUSY);
+    return (NOK);
+  }
+  Transaction = &Line->Queue[(Line->First + Line->Nb) % MDB_GATEWAY_QUEUE_LENGTH];
+  Transaction->Request.length = Request.length;
+  memcpy(Transaction->Request.data, Request.data, Request.length);
+  Transaction->ResponseLength = ResponseLength;
+  Transaction->Time = Now;
+  Transaction->NbWaiters = 1;
+  Transaction->Waiters[0].Connection = Index;
+  Transaction->Waiters[0].Transaction = GET_WORD(&Frame[0]);
+  Line->Nb++;
+  Tcp->Connections[Index].Pending++;
+  Modbus_GatewaySend(Tcp, LineIndex);
+  return (OK);
+}
+
+//=============================================================================
+// Modbus TCP server functions
+//=============================================================================
+/**************************************************************************//**
+*   \brief      This function opens a Modbus TCP server on a local address
+*   \ingroup TCP
+*   \param[out] Tcp Pointer to the Modbus TCP server
+*   \param[in]  Server Pointer to the Modbus server whose data model is served
+*   \param[in]  Address Local IPv4 address to listen to (e.g. "127.0.0.1"), 0 for all addresses
+*   \param[in]  Port TCP port to listen to (MDB_TCP_PORT), 0 for a port chosen by the system
+*               (given in Tcp->Port)
+*   \param[in,out] Connections Pointer to the array of connections (kept by the server)
+*   \param[in]  Nb Max number of simultaneous connections
+*   \return     OK if the server is listening
+*   \return     NOK otherwise (errno gives the reason)
+******************************************************************************/
+t_status Modbus_TCPOpen(Modbus_TCPServer* Tcp, Modbus_RTU* Server, const char* Address, unsigned short Port, Modbus_TCPConnection* Connections, int Nb)
+{
+  struct sockaddr_in Local;
+  socklen_t Length = sizeof(Local);
+  struct epoll_event Event;
+  int ReuseAddr = 1;
+  int i;
+
+  Tcp->Server = Server;
+  Tcp->Connections = Connections;
+  Tcp->Nb = Nb;
+  Tcp->Free = -1;
+  Tcp->Accepted = 0;
+  Tcp->Refused = 0;
+  Tcp->Gateway = 0;
+  for (i = Nb - 1; i >= 0; i--)
+  {
+    Connections[i].fd = -1;
+    Connections[i].Next = Tcp->Free;
+    Tcp->Free = i;
+  }
+
+  memset(&Local, 0, sizeof(Local));
+  Local.sin_family = AF_INET;
+  Local.sin_port = htons(Port);
+  Local.sin_addr.s_addr = htonl(INADDR_ANY);
+  if ((Address != 0) && (inet_pton(AF_INET, Address, &Local.sin_addr) != 1))
+  {
+    errno = EINVAL;
+    Tcp->fd = -1;
+    Tcp->Epoll = -1;
+    return (NOK);
+  }
+
+  Tcp->Epoll = epoll_create1(EPOLL_CLOEXEC);
+  Tcp->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if ((Tcp->Epoll < 0) || (Tcp->fd < 0))
+  {
+    Modbus_TCPClose(Tcp);
+    return (NOK);
+  }
+  setsockopt(Tcp->fd, SOL_SOCKET, SO_REUSEADDR, &ReuseAddr, sizeof(ReuseAddr));
+
+  Event.events = EPOLLIN;
+  Event.data.u64 = MDB_TCP_LISTEN;
+  if ((bind(Tcp->fd, (struct sockaddr*)&Local, sizeof(Local)) != 0) ||
+      (listen(Tcp->fd, SOMAXCONN) != 0) ||
+      (getsockname(Tcp->fd, (struct sockaddr*)&Local, &Length) != 0) ||
+      (epoll_ctl(Tcp->Epoll, EPOLL_CTL_ADD, Tcp->fd, &Event) != 0))
+  {
+    Modbus_TCPClose(Tcp);
+    return (NOK);
+  }
+  Tcp->Port = ntohs(Local.sin_port);
+  return (OK);
+}
+
+/**************************************************************************//**
+*   \brief      This function waits for the events of a Modbus TCP server and handles them
+*
+*   New connections are accepted (closed at once if all connections are used),
+*   complete requests are answered and responses are written as far as the
+*   sockets can take them. The requests of a client which does not read its
+*   responses wait in the socket until room is available for their responses.
+*   A connection which does not carry Modbus TCP frames is closed.
+*   With a gateway, the events of its serial lines are handled too.
+*   \ingroup TCP
+*   \param[in,out] Tcp Pointer to the Modbus TCP server
+*   \param[in]  Timeout Max waiting time of an event (ms), -1 to wait without limit
+*   \return     OK if the events have been handled (or the time has elapsed)
+*   \return     NOK otherwise (error of the epoll instance)
+******************************************************************************/
+t_status Modbus_TCPUpdate(Modbus_TCPServer* Tcp, int Timeout)
+{
+  struct epoll_event Events[MDB_TCP_EVENTS_MAX];
+  Modbus_GatewayLine* Line;
+  unsigned long long Expirations;
+  int Nb;
+  int Index;
+  int Source;
+  int i;
+
+  Nb = epoll_wait(Tcp->Epoll, Events, MDB_TCP_EVENTS_MAX, Timeout);
+  if (Nb < 0)
+  {
+    return ((errno == EINTR) ? OK : NOK);
+  }
+
+  // Sockets and ttys
+  for (i = 0; i < Nb; i++)
+  {
+    if (Events[i].data.u64 == MDB_TCP_LISTEN)
+    {
+      Modbus_TCPAccept(Tcp);
+      continue;
+    }
+    if (Events[i].data.u64 & MDB_LINE_FLAG)
+    {
+      Index = (int)((Events[i].data.u64 & ~MDB_LINE_FLAG) >> 2);
+      Line = &Tcp->Gateway->Lines[Index];
+      if (((Events[i].data.u64 & 3) != MDB_LINE_TTY) || (Line->Serial.fd < 0))
+      {
+        continue;
+      }
+      if (Events[i].events & EPOLLIN)
+      {
+        Modbus_GatewayRead(Tcp, Index);
+      }
+      else if (Events[i].events & (EPOLLERR | EPOLLHUP))
+      {
+        Modbus_GatewayFail(Tcp, Index);
+      }
+      if ((Events[i].events & EPOLLOUT) && (Line->Serial.fd >= 0) &&
+          (Line->Nb > 0) && (Line->Sent >= 0) && (Line->Sent < Line->Queue[Line->First].Request.length))
+      {
+        Modbus_GatewayWrite(Tcp, Index);
+      }
+      continue;
+    }
+
+    Index = (int)(Events[i].data.u64 - 1);
+    if (Tcp->Connections[Index].fd < 0)
+    {
+      continue;
+    }
+    if (Events[i].events & EPOLLIN)
+    {
+      Modbus_TCPRead(Tcp, Index);
+    }
+    else if (Events[i].events & (EPOLLERR | EPOLLHUP))
+    {
+      Modbus_TCPDrop(Tcp, Index);
+    }
+    if ((Events[i].events & EPOLLOUT) && (Tcp->Connections[Index].fd >= 0))
+    {
+      Modbus_TCPService(Tcp, Index);
+    }
+  }
+
+  // Ends of the silences, then response timeouts of the gateway lines
+  for (Source = MDB_LINE_SILENCE; Source <= MDB_LINE_RESPONSE; Source++)
+  {
+    for (i = 0; i < Nb; i++)
+    {
+      if (!(Events[i].data.u64 & MDB_LINE_FLAG) || ((int)(Events[i].data.u64 & 3) != Source))
+      {
+        continue;
+      }
+      Index = (int)((Events[i].data.u64 & ~MDB_LINE_FLAG) >> 2);
+      Line = &Tcp->Gateway->Lines[Index];
+      if ((read((Source == MDB_LINE_SILENCE) ? Line->Serial.Timer : Line->Timer, &Expirations, sizeof(Expirations)) <= 0) ||
+          (Line->Serial.fd < 0) || (Line->Nb == 0) || (Line->Sent != Line->Queue[Line->First].Request.length))
+      {
+        continue;
+      }
+      if (Source == MDB_LINE_RESPONSE)
+      {
+        Line->Timeouts++;
+        Modbus_GatewayComplete(Tcp, Index, 0);
+      }
+      else if (Modbus_ReceiverPoll(&Line->Serial.Receiver, Modbus_SerialTime()) == OK)
+      {
+        Modbus_GatewayFrame(Tcp, Index);
+      }
+    }
+  }
+  return (OK);
+}
+
+/**************************************************************************//**
+*   \brief      This function closes a Modbus TCP server and its connections
+*   \ingroup TCP
+*   \param[in,out] Tcp Pointer to the Modbus TCP server
+******************************************************************************/
+void Modbus_TCPClose(Modbus_TCPServer* Tcp)
+{
+  int i;
+
+  for (i = 0; i < Tcp->Nb; i++)
+  {
+    if (Tcp->Connections[i].fd >= 0)
+    {
+      Modbus_TCPDrop(Tcp, i);
+    }
+  }
+  if (Tcp->fd >= 0)
+  {
+    close(Tcp->fd);
+    Tcp->fd = -1;
+  }
+  if (Tcp->Epoll >= 0)
+  {
+    close(Tcp->Epoll);
+    Tcp->Epoll = -1;
+  }
+}
+
+/**************************************************************************//**
+*   \brief      This function forwards the requests to some units of a Modbus TCP server
+*               to the serial lines of a gateway
+*
+*   The ttys and timers of the lines are watched by the epoll instance of the
+*   server, so Modbus_TCPUpdate handles the serial lines too.
+*   \ingroup Gateway
+*   \param[in,out] Tcp Pointer to the Modbus TCP server
+*   \param[in,out] Gateway Pointer to the gateway (initialized by Modbus_GatewayInit)
+*   \return     OK if the lines are watched by the server
+*   \return     NOK otherwise (errno gives the reason)
+******************************************************************************/
+t_status Modbus_TCPSetGateway(Modbus_TCPServer* Tcp, Modbus_Gateway* Gateway)
+{
+  Modbus_GatewayLine* Line;
+  struct epoll_event Event;
+  int i;
+
+  for (i = 0; i < Gateway->Nb; i++)
+  {
+    Line = &Gateway->Lines[i];
+    if (Line->Serial.fd < 0)
+    {
+      continue;
+    }
+    Event.events = Line->Events;
+    Event.data.u64 = MDB_LINE_TAG(i, MDB_LINE_TTY);
+    if (epoll_ctl(Tcp->Epoll, EPOLL_CTL_ADD, Line->Serial.fd, &Event) != 0)
+    {
+      return (NOK);
+    }
+    Event.events = EPOLLIN;
+    Event.data.u64 = MDB_LINE_TAG(i, MDB_LINE_SILENCE);
+    if (epoll_ctl(Tcp->Epoll, EPOLL_CTL_ADD, Line->Serial.Timer, &Event) != 0)
+    {
+      return (NOK);
+    }
+    Event.data.u64 = MDB_LINE_TAG(i, MDB_LINE_RESPONSE);
+    if (epoll_ctl(Tcp->Epoll, EPOLL_CTL_ADD, Line->Timer, &Event) != 0)
+    {
+      return (NOK);
+    }
+  }
+  Tcp->Gateway = Gateway;
+  return (OK);
+}
+
+//=============================================================================
+// Gateway functions
+//=============================================================================
+/**************************************************************************//**
+*   \brief      This function prepares a gateway to serial lines
+*
+*   Each line shall be opened (Modbus_SerialOpen or Modbus_SerialAttach) with the
+*   device given in Client, its Timeout being set. No unit is routed to the lines yet.
+*   \ingroup Gateway
+*   \param[out] Gateway Pointer to the gateway
+*   \param[in,out] Lines Pointer to the array of lines (kept by the gateway)
+*   \param[in]  Nb Number of lines
+*   \param[in]  Window Max delay between identical FC03 / FC04 reads answered by the bus 
+*               transaction already sent for the first one (s). Identical reads waiting 
+*               for the bus are always merged : 0 merges only them.
+*   \return     OK if the gateway is ready
+*   \return     NOK otherwise (errno gives the reason)
+******************************************************************************/
+t_status Modbus_GatewayInit(Modbus_Gateway* Gateway, Modbus_GatewayLine* Lines, int Nb, unsigned long Window)
+{
+  int i;
+
+  Gateway->Lines = Lines;
+  Gateway->Nb = Nb;
+  Gateway->Window = Window;
+  for (i = 0; i < 256; i++)
+  {
+    Gateway->Route[i] = -1;
+  }
+
+  for (i = 0; i < Nb; i++)
+  {
+    Lines[i].First = 0;
+    Lines[i].Nb = 0;
+    Lines[i].Sent = -1;
+    Lines[i].Events = EPOLLIN;
+    Lines[i].Transactions = 0;
+    Lines[i].Merged = 0;
+    Lines[i].Timeouts = 0;
+    Lines[i].Timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  }
+  for (i = 0; i < Nb; i++)
+  {
+    if (Lines[i].Timer < 0)
+    {
+      Modbus_GatewayClose(Gateway);
+      return (NOK);
+    }
+  }
+  return (OK);
+}
+
+/**************************************************************************//**
+*   \brief      This function routes the requests to a unit identifier
+*   \ingroup Gateway
+*   \param[in,out] Gateway Pointer to the gateway
+*   \param[in]  Unit Unit identifier (1 to 255)
+*   \param[in]  Line Index of the serial line of the unit, -1 for the data model of the 
+*               Modbus TCP server
+*   \return     OK if the route is set
+*   \return     NOK otherwise (unit or line out of range)
+******************************************************************************/
+t_status Modbus_GatewayRoute(Modbus_Gateway* Gateway, int Unit, int Line)
+{
+  if ((Unit < 1) || (Unit > 255) || (Line < -1) || (Line >= Gateway->Nb))
+  {
+    return (NOK);
+  }
+  Gateway->Route[Unit] = (short)Line;
+  return (OK);
+}
+
+/**************************************************************************//**
+*   \brief      This function closes the serial lines of a gateway
+*   \ingroup Gateway
+*   \param[in,out] Gateway Pointer to the gateway
+******************************************************************************/
+void Modbus_GatewayClose(Modbus_Gateway* Gateway)
+{
+  int i;
+
+  for (i = 0; i < Gateway->Nb; i++)
+  {
+    Modbus_SerialClose(&Gateway->Lines[i].Serial);
+    if (Gateway->Lines[i].Timer >= 0)
+    {
+      close(Gateway->Lines[i].Timer);
+      Gateway->Lines[i].Timer = -1;
+    }
+    Gateway->Lines[i].Nb = 0;
+  }
+}
+#endif
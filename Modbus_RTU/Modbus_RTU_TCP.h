@@ -0,0 +1,168 @@
+/*
+  Modbus_RTU_TCP.h - Modbus TCP server front-end of Modbus_RTU for Linux hosts
+  Copyright (c) 2012 Gilles De Vos.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/***********************************************************************//**
+* \defgroup TCP Modbus TCP server (Linux)
+* The data model of a server is made reachable by Modbus TCP clients. The
+* listening socket and all connections are watched by one epoll instance and
+* served by a single thread : requests are answered by Server_UpdateTCP as
+* soon as they are complete, so a client may send several requests without
+* waiting for their responses (pipelining).
+*
+* Example:
+* \code
+* Modbus_TCPConnection Connections[1000];
+* Modbus_TCPServer Tcp;
+*
+* if (Modbus_TCPOpen(&Tcp, &myServer, 0, MDB_TCP_PORT, Connections, 1000) == OK)
+* {
+*   while (1)
+*   {
+*     Modbus_TCPUpdate(&Tcp, -1);
+*   }
+* }
+* \endcode
+***************************************************************************/
+
+/***********************************************************************//**
+* \defgroup Gateway Modbus TCP to RTU gateway (Linux)
+* Requests received by a Modbus TCP server for some unit identifiers are
+* forwarded to the RTU servers of serial lines. Each line has a queue of bus
+* transactions sent one at a time, so TCP clients do not wait for each other
+* on the TCP side. Identical FC03 / FC04 reads from different clients
+* which arrive while the first one waits for the bus, or within a short
+* window once it is sent, are merged into one bus transaction, whose
+* response is sent to all of them. The responses of a connection may
+* then come in another order than its requests (see the transaction identifier).
+*
+* Example:
+* \code
+* Modbus_GatewayLine Lines[1];
+* Modbus_Gateway Gateway;
+*
+* Modbus_SerialOpen(&Lines[0].Serial, &myClient, "/dev/ttyUSB0", MDB_SERIAL_RS485);
+* Lines[0].Client = &myClient;
+* Lines[0].Timeout = 200;
+* Modbus_GatewayInit(&Gateway, Lines, 1, 50000);
+* Modbus_GatewayRoute(&Gateway, 17, 0);      // unit 17 is on the line 0
+* Modbus_TCPSetGateway(&Tcp, &Gateway);
+* \endcode
+***************************************************************************/
+
+#ifndef Modbus_RTU_TCP_h
+#define Modbus_RTU_TCP_h
+
+#if defined(__linux__)
+
+// Include files //////////////////////////////////////////////////////////////
+#include "Modbus_RTU.h"
+#include "Modbus_RTU_Serial.h"
+
+#define MDB_TCP_PORT  502           ///< Registered port of Modbus TCP
+#define MDB_TCP_EVENTS_MAX  64      ///< Max number of events handled by one call of Modbus_TCPUpdate
+
+#define MDB_GATEWAY_QUEUE_LENGTH  16  ///< Max number of transactions waiting on a serial line
+#define MDB_GATEWAY_WAITERS_MAX  8    ///< Max number of TCP requests answered by one transaction
+
+// Connection of a Modbus TCP client
+typedef struct
+{
+  int fd;                                 ///< File descriptor of the socket (-1 if the connection is free)
+  int Next;                               ///< Index of the next free connection
+  char Rx[2 * MDB_TCP_LENGTH_MAX];        ///< Received bytes not served yet
+  int RxLength;                           ///< Number of received bytes
+  char Tx[4 * MDB_TCP_LENGTH_MAX];        ///< Responses not written yet
+  int TxStart;                            ///< Index of the first byte to write
+  int TxLength;                           ///< Number of bytes to write
+  unsigned int Events;                    ///< Events of the socket watched by the server
+  int Pending;                            ///< Number of requests forwarded by the gateway, not answered yet
+} Modbus_TCPConnection;
+
+// TCP request waiting for a bus transaction
+typedef struct
+{
+  int Connection;                         ///< Index of the connection of the request
+  unsigned short Transaction;             ///< Transaction identifier of the request
+} Modbus_GatewayWaiter;
+
+// Bus transaction of a serial line
+typedef struct
+{
+  Modbus_Frame Request;                   ///< RTU request frame
+  unsigned short ResponseLength;          ///< Length of the expected response frame (0 if unknown)
+  unsigned long Time;                     ///< Reception time of the first TCP request (s)
+  int NbWaiters;                          ///< Number of TCP requests answered by the transaction
+  Modbus_GatewayWaiter Waiters[MDB_GATEWAY_WAITERS_MAX];  ///< TCP requests answered by the transaction
+} Modbus_GatewayTransaction;
+
+// Serial line of a gateway
+typedef struct
+{
+  Modbus_Serial Serial;                   ///< Serial port (opened before Modbus_GatewayInit)
+  Modbus_RTU* Client;                     ///< Client which builds the requests and checks the responses
+  int Timeout;                            ///< Max response time of the servers of the line (ms)
+  int Timer;                              ///< File descriptor of the timer of the response timeout
+  Modbus_GatewayTransaction Queue[MDB_GATEWAY_QUEUE_LENGTH];  ///< Transactions of the line (circular queue)
+  int First;                              ///< Index of the oldest transaction, the one on the bus
+  int Nb;                                 ///< Number of transactions in the queue
+  int Sent;                               ///< Number of bytes of the oldest transaction written (-1 if not sent yet)
+  unsigned int Events;                    ///< Events of the tty watched by the server
+  unsigned long Transactions;             ///< Number of transactions sent on the bus
+  unsigned long Merged;                   ///< Number of TCP requests answered by the transaction of another one
+  unsigned long Timeouts;                 ///< Number of transactions without valid response
+} Modbus_GatewayLine;
+
+// Modbus TCP to RTU gateway
+typedef struct
+{
+  Modbus_GatewayLine* Lines;              ///< Serial lines
+  int Nb;                                 ///< Number of serial lines
+  unsigned long Window;                   ///< Max delay between identical reads answered by a transaction on the bus (s)
+  short Route[256];                       ///< Line of each unit identifier (-1 if served by the TCP server)
+} Modbus_Gateway;
+
+// Modbus TCP server
+typedef struct
+{
+  int fd;                                 ///< File descriptor of the listening socket
+  int Epoll;                              ///< File descriptor of the epoll instance
+  unsigned short Port;                    ///< TCP port the server listens to
+  Modbus_RTU* Server;                     ///< Server whose data model is served
+  Modbus_TCPConnection* Connections;      ///< Connections of the clients
+  int Nb;                                 ///< Max number of connections
+  int Free;                               ///< Index of the first free connection (-1 if none)
+  unsigned long Accepted;                 ///< Number of accepted connections
+  unsigned long Refused;                  ///< Number of connections closed at once (no free connection)
+  Modbus_Gateway* Gateway;                ///< Gateway to serial lines, or 0
+} Modbus_TCPServer;
+
+// Modbus TCP server functions //////////////////////////////////////////////
+t_status Modbus_TCPOpen(Modbus_TCPServer* Tcp, Modbus_RTU* Server, const char* Address, unsigned short Port, Modbus_TCPConnection* Connections, int Nb);
+t_status Modbus_TCPUpdate(Modbus_TCPServer* Tcp, int Timeout);
+void Modbus_TCPClose(Modbus_TCPServer* Tcp);
+t_status Modbus_TCPSetGateway(Modbus_TCPServer* Tcp, Modbus_Gateway* Gateway);
+
+// Gateway functions ////////////////////////////////////////////////////////
+t_status Modbus_GatewayInit(Modbus_Gateway* Gateway, Modbus_GatewayLine* Lines, int Nb, unsigned long Window);
+t_status Modbus_GatewayRoute(Modbus_Gateway* Gateway, int Unit, int Line);
+void Modbus_GatewayClose(Modbus_Gateway* Gateway);
+
+#endif
+
+#endif
@@ -0,0 +1,155 @@
+/*
+  Modbus_RTU library
+  Example of Mobus RTU CRC16: compare the block CRC16 with a bitwise reference
+  Copyright (C) 2012  Gilles DE VOS
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <Modbus_RTU.h>
+
+// Longest block tested (blocks of 64 bytes or more use the folding kernel when available)
+#define MAX_LENGTH 512
+// Number of alignments tested for each block
+#define MAX_OFFSET 16
+
+Modbus_RTU myDevice = Modbus_RTU(0);
+
+// Test buffer
+unsigned char myBuffer[MAX_LENGTH + MAX_OFFSET];
+
+t_baud Baudrate;
+unsigned long Errors;
+unsigned long Tests;
+
+void setup()
+{
+  // Initialize serial line
+  myDevice.GetBaudrate(&Baudrate);
+  Serial.begin(Baudrate);
+
+  Serial.println("");
+  Serial.println("Test Modbus_RTU library");
+  Serial.println("=======================");
+
+  // Modbus test type
+  Serial.println("");
+  Serial.println("   Test CRC16: block computation against bitwise reference");
+  Serial.println("   -------------------------------------------------------");
+}
+
+void loop()
+{
+  int Length;
+  int Offset;
+  int Split;
+  int Bytes;
+  int i;
+  unsigned short Reference;
+  unsigned short Value;
+  Modbus_CRC16Context Context;
+
+  Serial.println("");
+  Serial.print("  --> Blocks of 0 to ");
+  Serial.print(MAX_LENGTH, DEC);
+  Serial.println(" bytes at random alignments, split across update calls");
+  Serial.println("      Result should be 0 error");
+
+  randomSeed(1);
+  Errors = 0;
+  Tests = 0;
+  for (Length = 0; Length <= MAX_LENGTH; Length++)
+  {
+    for (i = 0; i < Length + MAX_OFFSET; i++)
+    {
+      myBuffer[i] = random(256);
+    }
+    Offset = random(MAX_OFFSET);
+    Reference = ReferenceCRC16(&myBuffer[Offset], Length);
+
+    // Whole block in one call
+    Modbus_CRC16Init(&Context);
+    Modbus_CRC16UpdateBlock(&Context, (const char*)&myBuffer[Offset], Length);
+    Value = Modbus_CRC16Final(&Context);
+    CheckCRC16(Length, Offset, Value, Reference);
+
+    // Block, a few single bytes, then the rest of the block
+    Split = random(Length + 1);
+    Bytes = random(8);
+    if (Bytes > Length - Split)
+    {
+      Bytes = Length - Split;
+    }
+    Modbus_CRC16Init(&Context);
+    Modbus_CRC16UpdateBlock(&Context, (const char*)&myBuffer[Offset], Split);
+    for (i = Split; i < Split + Bytes; i++)
+    {
+      Modbus_CRC16Update(&Context, myBuffer[Offset + i]);
+    }
+    Modbus_CRC16UpdateBlock(&Context, (const char*)&myBuffer[Offset + Split + Bytes], Length - Split - Bytes);
+    Value = Modbus_CRC16Final(&Context);
+    CheckCRC16(Length, Offset, Value, Reference);
+  }
+
+  Serial.println("");
+  Serial.print("  --> ");
+  Serial.print(Tests, DEC);
+  Serial.print(" tests, ");
+  Serial.print(Errors, DEC);
+  Serial.println(" error");
+
+  while(1)
+  {
+  }
+}
+
+// Bitwise CRC16 (polynomial 0xA001, initial value 0xFFFF)
+unsigned short ReferenceCRC16(const unsigned char* Buffer, int Length)
+{
+  unsigned short CRC16 = 0xFFFF;
+  int i;
+  int Bit;
+
+  for (i = 0; i < Length; i++)
+  {
+    CRC16 ^= Buffer[i];
+    for (Bit = 0; Bit < 8; Bit++)
+    {
+      if (CRC16 & 1)
+        CRC16 = (CRC16 >> 1) ^ 0xA001;
+      else
+        CRC16 = CRC16 >> 1;
+    }
+  }
+  return (CRC16);
+}
+
+// Function to compare a CRC16 with the reference (Modbus_CRC16Final returns the CRC16 byte swapped)
+void CheckCRC16(int Length, int Offset, unsigned short Value, unsigned short Reference)
+{
+  Tests++;
+  if (Value != (unsigned short)((Reference << 8) | (Reference >> 8)))
+  {
+    Errors++;
+    Serial.print("  Error: length ");
+    Serial.print(Length, DEC);
+    Serial.print(" offset ");
+    Serial.print(Offset, DEC);
+    Serial.print(" CRC16 0x");
+    Serial.print(Value, HEX);
+    Serial.print(" reference 0x");
+    Serial.println(Reference, HEX);
+  }
+}
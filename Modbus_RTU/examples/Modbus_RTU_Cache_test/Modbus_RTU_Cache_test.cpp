@@ -0,0 +1,209 @@
+/*
+  Modbus_RTU library
+  Example of response cache: cached FC03 / FC04 responses against fresh ones
+  Copyright (C) 2012  Gilles DE VOS
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+  Host program, not a sketch. Build and run on Linux from this directory
+  (Modbus_RTU.cpp includes Arduino.h : an empty Arduino.h is enough on a host):
+
+  g++ -I../.. -I<dir of Arduino.h> Modbus_RTU_Cache_test.cpp ../../Modbus_RTU.cpp -o Modbus_RTU_Cache_test
+  ./Modbus_RTU_Cache_test
+
+  Two servers hold the same registers, only the first one caches its responses.
+  Their registers are edited the same way, then both answer the same reads :
+  the cached responses (patched values and CRC16) shall be the fresh ones.
+  The exit code is the number of errors.
+*/
+
+#include <Modbus_RTU.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NB_REGISTERS  200     // Number of holding and input registers of each server
+#define NB_ROUNDS     2000    // Number of edits of the registers
+#define NB_READS      6       // Number of reads answered after each edit
+
+// Server with a cache, and server answering from its registers only (unit 5)
+Modbus_RTU myServers[2] = {Modbus_RTU(MDB_SERVER), Modbus_RTU(MDB_SERVER)};
+unsigned short myHolding[2][NB_REGISTERS];
+unsigned short myInput[2][NB_REGISTERS];
+Modbus_CacheEntry myCache[8];
+
+Modbus_RTU myClient = Modbus_RTU(0);
+
+// Reads answered after each edit : function code, address, number of registers
+const int myReads[NB_READS][3] =
+{
+  {MDB_FC03, 0, 125},
+  {MDB_FC03, 10, 1},
+  {MDB_FC03, 120, 80},
+  {MDB_FC04, 0, 10},
+  {MDB_FC04, 5, 125},
+  {MDB_FC04, 199, 1}
+};
+
+int Errors;
+
+// Function to count an error
+void Check(bool Condition, const char* Text)
+{
+  if (!Condition)
+  {
+    Errors++;
+    printf("  Error: %s\n", Text);
+  }
+}
+
+// Function to answer all reads by both servers, returns the number of different responses
+int Compare(void)
+{
+  Modbus_Frame Frames[2];
+  unsigned short CRC16;
+  int Different = 0;
+  int Read;
+  int i;
+
+  for (Read = 0; Read < NB_READS; Read++)
+  {
+    for (i = 0; i < 2; i++)
+    {
+      if (myReads[Read][0] == MDB_FC03)
+        myClient.Client_ReadHoldingRegisters(5, myReads[Read][1], myReads[Read][2], &Frames[i]);
+      else
+        myClient.Client_ReadInputRegisters(5, myReads[Read][1], myReads[Read][2], &Frames[i]);
+      myServers[i].Server_Update(&Frames[i]);
+    }
+    if ((Frames[0].length != Frames[1].length) || (memcmp(Frames[0].data, Frames[1].data, Frames[0].length) != 0) ||
+        (Frames[0].length != 3 + 2 * myReads[Read][2] + 2) ||
+        !myServers[0].GetCRC16(&Frames[0], &CRC16) || (CRC16 != (unsigned short)((unsigned char)Frames[0].data[Frames[0].length - 2] << 8 | (unsigned char)Frames[0].data[Frames[0].length - 1])))
+    {
+      Different++;
+    }
+  }
+  return (Different);
+}
+
+int main(void)
+{
+  Modbus_Frame myFrame;
+  unsigned short Values[NB_REGISTERS];
+  unsigned short Addr;
+  int Different;
+  int Stored;
+  int Round;
+  int Nb;
+  int i;
+  int j;
+
+  for (i = 0; i < 2; i++)
+  {
+    for (j = 0; j < NB_REGISTERS; j++)
+    {
+      myHolding[i][j] = 0x1000 + j;
+      myInput[i][j] = 0x2000 + j;
+    }
+    myServers[i].Server_SetAddress(5);
+    myServers[i].Server_SetHoldingRegisters(myHolding[i], 0, NB_REGISTERS);
+    myServers[i].Server_SetInputRegisters(myInput[i], 0, NB_REGISTERS);
+  }
+  myServers[0].Server_SetCache(myCache, 8);
+  myClient.SetType(MDB_CLIENT);
+
+  printf("\nTest Modbus_RTU library\n");
+  printf("=======================\n");
+  printf("\n   Test response cache: cached FC03 / FC04 responses against fresh ones\n");
+  printf("   --------------------------------------------------------------------\n");
+
+  printf("\n  --> %d reads, twice\n", NB_READS);
+  printf("      Result should be the same responses, all stored in the cache\n");
+  Check(Compare() == 0, "first responses");
+  Check(Compare() == 0, "cached responses");
+  for (i = 0, Stored = 0; i < 8; i++)
+  {
+    Stored += (myCache[i].Nb != 0);
+  }
+  Check(Stored == NB_READS, "number of cached responses");
+
+  printf("\n  --> %d random edits (Server_Write..., Server_BeginWrite / Server_EndWrite, FC06, FC16), %d reads after each\n", NB_ROUNDS, NB_READS);
+  printf("      Result should be the same responses\n");
+  srand(1);
+  Different = 0;
+  for (Round = 0; Round < NB_ROUNDS; Round++)
+  {
+    Addr = rand() % NB_REGISTERS;
+    Nb = 1 + rand() % (NB_REGISTERS - Addr < 100 ? NB_REGISTERS - Addr : 100);
+    for (j = 0; j < Nb; j++)
+    {
+      // Same value sometimes : the response shall not change
+      Values[j] = (rand() % 4 == 0) ? myHolding[0][Addr + j] : rand();
+    }
+    for (i = 0; i < 2; i++)
+    {
+      switch (Round % 6)
+      {
+        case 0:
+          myServers[i].Server_WriteRegister(Addr, Values[0]);
+          break;
+        case 1:
+          myServers[i].Server_WriteRegisters(Addr, Nb, Values);
+          break;
+        case 2:
+          myServers[i].Server_WriteInputRegisters(Addr, Nb, Values);
+          break;
+        case 3:
+          // Registers edited in place by the application
+          myServers[i].Server_BeginWrite();
+          for (j = 0; j < Nb; j++)
+          {
+            myHolding[i][Addr + j] = Values[j];
+            myInput[i][NB_REGISTERS - 1 - Addr - j] ^= Values[j];
+          }
+          myServers[i].Server_EndWrite();
+          break;
+        case 4:
+          // Registers written by a client
+          myClient.Client_PresetSingleRegister(5, Addr, Values[0], &myFrame);
+          myServers[i].Server_Update(&myFrame);
+          break;
+        default:
+          {
+            Modbus_Data myData;
+
+            myData.length = (Nb > 123) ? 123 : Nb;
+            for (j = 0; j < myData.length; j++)
+            {
+              myData.data[j] = Values[j];
+            }
+            myClient.Client_PresetMultipleRegisters(5, Addr, &myData, &myFrame);
+            myServers[i].Server_Update(&myFrame);
+          }
+          break;
+      }
+    }
+    Different += Compare();
+  }
+  Check(memcmp(myHolding[0], myHolding[1], sizeof(myHolding[0])) == 0, "holding registers of both servers");
+  Check(memcmp(myInput[0], myInput[1], sizeof(myInput[0])) == 0, "input registers of both servers");
+  printf("      %d different responses\n", Different);
+  Check(Different == 0, "responses after edits");
+
+  printf("\n  --> %d error\n", Errors);
+  return (Errors);
+}
@@ -0,0 +1,302 @@
+/*
+  Modbus_RTU library
+  Example of Modbus TCP to RTU gateway (Linux): read coalescing on a pseudo terminal
+  Copyright (C) 2012  Gilles DE VOS
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+  Host program, not a sketch. Build and run on Linux from this directory
+  (Modbus_RTU.cpp includes Arduino.h : an empty Arduino.h is enough on a host):
+
+  g++ -I../.. -I<dir of Arduino.h> Modbus_RTU_Gateway_test.cpp ../../Modbus_RTU.cpp
+      ../../Modbus_RTU_Serial.cpp ../../Modbus_RTU_TCP.cpp -o Modbus_RTU_Gateway_test -lutil
+  ./Modbus_RTU_Gateway_test
+
+  The serial line is a pseudo terminal : the gateway is on the master side, an
+  RTU server (unit 17) on the slave side. The gateway, the RTU server and the
+  TCP clients run in the same thread. The exit code is the number of errors.
+*/
+
+#include <Modbus_RTU_TCP.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pty.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define NB_CLIENTS 3      // Number of clients sending the same read
+
+// RTU server of the serial line (unit 17)
+Modbus_RTU myRtuServer = Modbus_RTU(MDB_SERVER);
+unsigned short myRegisters[200];
+Modbus_SerialLoopPort myPorts[1];
+Modbus_SerialLoop myLoop;
+
+// Modbus TCP server (unit 7) and gateway to the serial line
+Modbus_RTU myServer = Modbus_RTU(MDB_SERVER);
+unsigned short myLocalRegisters[10];
+Modbus_RTU myClient = Modbus_RTU(0);
+Modbus_GatewayLine myLines[1];
+Modbus_Gateway myGateway;
+Modbus_TCPConnection myConnections[8];
+Modbus_TCPServer myTcp;
+
+int Errors;
+
+// Function to connect a client to the server on the loopback
+int Connect(unsigned short Port)
+{
+  int fd;
+  struct sockaddr_in Address;
+
+  fd = socket(AF_INET, SOCK_STREAM, 0);
+  memset(&Address, 0, sizeof(Address));
+  Address.sin_family = AF_INET;
+  Address.sin_port = htons(Port);
+  Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if ((fd >= 0) && (connect(fd, (struct sockaddr*)&Address, sizeof(Address)) != 0))
+  {
+    close(fd);
+    fd = -1;
+  }
+  return (fd);
+}
+
+// Function to build a Modbus TCP request (MBAP header + PDU)
+int BuildRequest(char* Buffer, unsigned short Transaction, unsigned char Unit, const char* Pdu, int Length)
+{
+  Buffer[0] = Transaction >> 8;
+  Buffer[1] = Transaction & 0xFF;
+  Buffer[2] = 0;                        // Protocol identifier
+  Buffer[3] = 0;
+  Buffer[4] = (Length + 1) >> 8;        // Length of the unit identifier and the PDU
+  Buffer[5] = (Length + 1) & 0xFF;
+  Buffer[6] = Unit;
+  memcpy(&Buffer[7], Pdu, Length);
+  return (7 + Length);
+}
+
+// Function to read the bytes received by a client, the gateway and the RTU server being updated meanwhile
+int Receive(int fd, char* Buffer, int Length)
+{
+  int Received = 0;
+  int Loops;
+  int n;
+
+  for (Loops = 0; (Loops < 1000) && (Received < Length); Loops++)
+  {
+    Modbus_TCPUpdate(&myTcp, 1);
+    Modbus_SerialLoopUpdate(&myLoop, 1);
+    n = recv(fd, &Buffer[Received], Length - Received, MSG_DONTWAIT);
+    if (n == 0)
+    {
+      break;
+    }
+    if (n > 0)
+    {
+      Received += n;
+    }
+  }
+  return (Received);
+}
+
+// Function to count an error
+void Check(bool Condition, const char* Text)
+{
+  if (!Condition)
+  {
+    Errors++;
+    printf("  Error: %s\n", Text);
+  }
+}
+
+// Function to write a request on a client connection
+void Send(int fd, const char* Buffer, int Length)
+{
+  Check(write(fd, Buffer, Length) == Length, "write of a request");
+}
+
+unsigned short GetWord(const char* Buffer)
+{
+  return ((unsigned short)((unsigned char)Buffer[0] << 8 | (unsigned char)Buffer[1]));
+}
+
+int main(void)
+{
+  char Request[5 * 12];
+  char Response[7 + 2 + 250];
+  int Clients[NB_CLIENTS];
+  unsigned long Transactions;
+  int Master;
+  int Slave;
+  int Length;
+  int i;
+
+  // RTU server on the slave side of the pseudo terminal
+  for (i = 0; i < 200; i++)
+  {
+    myRegisters[i] = 0x1000 + i;
+  }
+  if (openpty(&Master, &Slave, 0, 0, 0) != 0)
+  {
+    printf("openpty failed\n");
+    return (1);
+  }
+  myRtuServer.Server_SetAddress(17);
+  myRtuServer.Server_SetHoldingRegisters(myRegisters, 0, 200);
+  myRtuServer.SetBaudrate(MDB_BAUD_38400);
+  myRtuServer.SetParity(MDB_PARITY_NONE);
+  myPorts[0].Server = &myRtuServer;
+  if ((Modbus_SerialAttach(&myPorts[0].Serial, &myRtuServer, Slave, 0) != OK) || (Modbus_SerialLoopInit(&myLoop, myPorts, 1) != OK))
+  {
+    printf("RTU server failed\n");
+    return (1);
+  }
+
+  // Gateway on the master side : units 17 and 18 are on the line (18 does not answer)
+  myClient.SetType(MDB_CLIENT);
+  myClient.SetBaudrate(MDB_BAUD_38400);
+  myClient.SetParity(MDB_PARITY_NONE);
+  myLines[0].Client = &myClient;
+  myLines[0].Timeout = 100;
+  if ((Modbus_SerialAttach(&myLines[0].Serial, &myClient, Master, 0) != OK) || (Modbus_GatewayInit(&myGateway, myLines, 1, 200000) != OK))
+  {
+    printf("gateway failed\n");
+    return (1);
+  }
+  Modbus_GatewayRoute(&myGateway, 17, 0);
+  Modbus_GatewayRoute(&myGateway, 18, 0);
+
+  // Modbus TCP server : unit 7 is its own data model
+  for (i = 0; i < 10; i++)
+  {
+    myLocalRegisters[i] = 500 + i;
+  }
+  myServer.Server_SetAddress(7);
+  myServer.Server_SetHoldingRegisters(myLocalRegisters, 0, 10);
+  if ((Modbus_TCPOpen(&myTcp, &myServer, "127.0.0.1", 0, myConnections, 8) != OK) || (Modbus_TCPSetGateway(&myTcp, &myGateway) != OK))
+  {
+    printf("Modbus TCP server failed\n");
+    return (1);
+  }
+  for (i = 0; i < NB_CLIENTS; i++)
+  {
+    Clients[i] = Connect(myTcp.Port);
+    if (Clients[i] < 0)
+    {
+      printf("connect failed\n");
+      return (1);
+    }
+  }
+
+  printf("\nTest Modbus_RTU library\n");
+  printf("=======================\n");
+  printf("\n   Test Modbus TCP to RTU gateway: read coalescing\n");
+  printf("   -----------------------------------------------\n");
+
+  // Identical reads of several clients : one bus transaction
+  printf("\n  --> %d clients read 125 registers from address 10 of unit 17 at once\n", NB_CLIENTS);
+  printf("      Each client should get its response, from 1 bus transaction\n");
+  {
+    char Pdu[5] = {MDB_FC03, 0, 10, 0, 125};
+    for (i = 0; i < NB_CLIENTS; i++)
+    {
+      Length = BuildRequest(Request, 100 + i, 17, Pdu, 5);
+      Send(Clients[i], Request, Length);
+    }
+    for (i = 0; i < NB_CLIENTS; i++)
+    {
+      Length = Receive(Clients[i], Response, 7 + 2 + 250);
+      Check((Length == 7 + 2 + 250) && (GetWord(&Response[0]) == 100 + i) && (Response[6] == 17), "merged response");
+      Check((Response[7] == MDB_FC03) && ((unsigned char)Response[8] == 250), "PDU of a merged response");
+      Check((GetWord(&Response[9]) == myRegisters[10]) && (GetWord(&Response[257]) == myRegisters[134]), "values of a merged response");
+    }
+    Check(myLines[0].Transactions == 1, "number of bus transactions");
+    Check(myLines[0].Merged == NB_CLIENTS - 1, "number of merged requests");
+  }
+
+  // Window 0 : the reads which arrive while the first one is on the bus are merged together
+  printf("\n  --> Same reads with a merge window of 0\n");
+  printf("      Each client should get its response, from 2 bus transactions\n");
+  myGateway.Window = 0;
+  Transactions = myLines[0].Transactions;
+  {
+    char Pdu[5] = {MDB_FC03, 0, 10, 0, 125};
+    for (i = 0; i < NB_CLIENTS; i++)
+    {
+      Length = BuildRequest(Request, 150 + i, 17, Pdu, 5);
+      Send(Clients[i], Request, Length);
+    }
+    for (i = 0; i < NB_CLIENTS; i++)
+    {
+      Length = Receive(Clients[i], Response, 7 + 2 + 250);
+      Check((Length == 7 + 2 + 250) && (GetWord(&Response[0]) == 150 + i) && (GetWord(&Response[9]) == myRegisters[10]), "response with a window of 0");
+    }
+    Check(myLines[0].Transactions == Transactions + 2, "number of bus transactions with a window of 0");
+    Check(myLines[0].Merged == 2 * (NB_CLIENTS - 1) - 1, "number of merged requests with a window of 0");
+  }
+
+  // Different reads : one bus transaction each, answered in order
+  printf("\n  --> 5 different reads of unit 17 in one write\n");
+  printf("      Responses should come in order, from 5 bus transactions\n");
+  Transactions = myLines[0].Transactions;
+  Length = 0;
+  for (i = 0; i < 5; i++)
+  {
+    char Pdu[5] = {MDB_FC03, 0, (char)i, 0, 2};
+    Length += BuildRequest(&Request[Length], 200 + i, 17, Pdu, 5);
+  }
+  Send(Clients[0], Request, Length);
+  for (i = 0; i < 5; i++)
+  {
+    Length = Receive(Clients[0], Response, 13);
+    Check((Length == 13) && (GetWord(&Response[0]) == 200 + i), "pipelined response");
+    Check((GetWord(&Response[9]) == myRegisters[i]) && (GetWord(&Response[11]) == myRegisters[i + 1]), "values of a pipelined response");
+  }
+  Check(myLines[0].Transactions == Transactions + 5, "number of bus transactions");
+  Check(myLines[0].Merged == 2 * (NB_CLIENTS - 1) - 1, "number of merged requests");
+
+  // Unit without server on the line, unit of the TCP server
+  printf("\n  --> Read unit 18 (no server), then unit 7 (TCP server)\n");
+  printf("      Responses should be exception 11, then 500, 501\n");
+  {
+    char Pdu[5] = {MDB_FC03, 0, 0, 0, 2};
+    Length = BuildRequest(Request, 300, 18, Pdu, 5);
+    Send(Clients[1], Request, Length);
+    Length = Receive(Clients[1], Response, 9);
+    Check((Length == 9) && ((unsigned char)Response[7] == 0x83) && (Response[8] == 11), "exception of a unit without server");
+
+    Length = BuildRequest(Request, 301, 7, Pdu, 5);
+    Send(Clients[1], Request, Length);
+    Length = Receive(Clients[1], Response, 13);
+    Check((Length == 13) && (GetWord(&Response[9]) == 500) && (GetWord(&Response[11]) == 501), "response of the TCP server");
+  }
+
+  printf("\n  Bus transactions %lu, merged requests %lu, timeouts %lu\n", myLines[0].Transactions, myLines[0].Merged, myLines[0].Timeouts);
+
+  for (i = 0; i < NB_CLIENTS; i++)
+  {
+    close(Clients[i]);
+  }
+  Modbus_GatewayClose(&myGateway);
+  Modbus_TCPClose(&myTcp);
+  Modbus_SerialLoopClose(&myLoop);
+  printf("\n  --> %d error\n", Errors);
+  return (Errors);
+}
@@ -0,0 +1,188 @@
+/*
+  Modbus_RTU library
+  Example of compile-time register map: blocks, scaled and 32-bit variables, gaps
+  Copyright (C) 2012  Gilles DE VOS
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+  Host program, not a sketch. Build and run on Linux from this directory
+  (Modbus_RTU.cpp includes Arduino.h : an empty Arduino.h is enough on a host):
+
+  g++ -I../.. -I<dir of Arduino.h> Modbus_RTU_Map_test.cpp ../../Modbus_RTU.cpp -o Modbus_RTU_Map_test
+  ./Modbus_RTU_Map_test
+
+  The requests of the client are given to the server in memory. On a 64-bit
+  host, long is 64-bit wide : its variables shall still be mapped as 32-bit
+  values. The exit code is the number of errors.
+*/
+
+#include <Modbus_RTU_Map.h>
+#include <stdio.h>
+
+// Variables of the server
+unsigned short Setpoints[4] = {0x1111, 0x2222, 0x3333, 0x4444};
+short Offset = -12;
+float Temperature = 21.5;
+long Counter = -2;
+unsigned long Total = 0x12345678;
+
+// Register map (gaps at 4..9 and 13..19)
+typedef Modbus_StaticMap<
+  Modbus_Block<0, 4, Setpoints>,                            // 0..3 read/write
+  Modbus_Var<10, short, &Offset, 10>,                       // 10 = Offset * 10 (signed)
+  Modbus_Var<11, float, &Temperature, 10, MDB_ACCESS_RO>,   // 11..12 = Temperature * 10, read only
+  Modbus_Var<20, long, &Counter>,                           // 20..21 (signed 32-bit)
+  Modbus_Var<22, unsigned long, &Total>                     // 22..23 (unsigned 32-bit)
+> MyMap;
+
+Modbus_RTU myServer = Modbus_RTU(MDB_SERVER);
+Modbus_RTU myClient = Modbus_RTU(0);
+
+Modbus_Frame myFrame;
+Modbus_Data myData;
+
+int Errors;
+
+// Function to count an error
+void Check(bool Condition, const char* Text)
+{
+  if (!Condition)
+  {
+    Errors++;
+    printf("  Error: %s\n", Text);
+  }
+}
+
+unsigned short GetWord(const char* Buffer)
+{
+  return ((unsigned short)((unsigned char)Buffer[0] << 8 | (unsigned char)Buffer[1]));
+}
+
+// Function to check that the response of the server is an exception
+void CheckException(unsigned char Code, const char* Text)
+{
+  Check((myServer.Server_Update(&myFrame) == OK) && (myFrame.length == 5) && (myFrame.data[1] & MDB_EXCEPTION_MASK) && (myFrame.data[2] == Code), Text);
+}
+
+// Function to read registers, returns true if the response is the one expected
+bool Read(unsigned short Addr, int Nb, const unsigned short* Values)
+{
+  int i;
+
+  myClient.Client_ReadHoldingRegisters(5, Addr, Nb, &myFrame);
+  if ((myServer.Server_Update(&myFrame) != OK) || (myFrame.length != 3 + 2 * Nb + 2) || (myFrame.data[1] != MDB_FC03))
+  {
+    return (false);
+  }
+  for (i = 0; i < Nb; i++)
+  {
+    if (GetWord(&myFrame.data[3 + 2 * i]) != Values[i])
+    {
+      return (false);
+    }
+  }
+  return (true);
+}
+
+// Function to write registers (FC16), returns true if the response is not an exception
+bool Write(unsigned short Addr, int Nb, const unsigned short* Values)
+{
+  int i;
+
+  myData.length = Nb;
+  for (i = 0; i < Nb; i++)
+  {
+    myData.data[i] = Values[i];
+  }
+  myClient.Client_PresetMultipleRegisters(5, Addr, &myData, &myFrame);
+  return ((myServer.Server_Update(&myFrame) == OK) && (myFrame.data[1] == MDB_FC16));
+}
+
+int main(void)
+{
+  myServer.Server_SetAddress(5);
+  myServer.Server_SetHoldingRegisterMap(MyMap::Range, 1);
+  myClient.SetType(MDB_CLIENT);
+
+  printf("\nTest Modbus_RTU library\n");
+  printf("=======================\n");
+  printf("\n   Test compile-time register map\n");
+  printf("   ------------------------------\n");
+
+  // Scaled variables
+  printf("\n  --> Read 3 registers from address 10 (Offset -12 * 10, Temperature 21.5 * 10)\n");
+  printf("      Result should be 0xFF88, 0x0000, 0x00D7\n");
+  {
+    const unsigned short Values[3] = {0xFF88, 0x0000, 0x00D7};
+    Check(Read(10, 3, Values), "read of scaled variables");
+  }
+  printf("\n  --> Write 0xFF38 (-200) in register 10\n");
+  printf("      Result should be Offset = -20\n");
+  myClient.Client_PresetSingleRegister(5, 10, 0xFF38, &myFrame);
+  Check((myServer.Server_Update(&myFrame) == OK) && (myFrame.data[1] == MDB_FC06), "response to a write of a scaled variable");
+  Check(Offset == -20, "value of a scaled signed variable");
+
+  // 32-bit variables
+  printf("\n  --> Read 4 registers from address 20 (Counter -2, Total 0x12345678)\n");
+  printf("      Result should be 0xFFFF, 0xFFFE, 0x1234, 0x5678\n");
+  {
+    const unsigned short Values[4] = {0xFFFF, 0xFFFE, 0x1234, 0x5678};
+    Check(Read(20, 4, Values), "read of 32-bit variables");
+  }
+  printf("\n  --> Write 0xFFFF, 0xFFFD, 0x8000, 0x0001 from address 20\n");
+  printf("      Result should be Counter = -3, Total = 0x80000001\n");
+  {
+    const unsigned short Values[4] = {0xFFFF, 0xFFFD, 0x8000, 0x0001};
+    Check(Write(20, 4, Values), "response to a write of 32-bit variables");
+    Check(Counter == -3, "value of a signed 32-bit variable");
+    Check(Total == 0x80000001UL, "value of an unsigned 32-bit variable");
+  }
+  printf("\n  --> Write 0x0000 in register 20 only (half of Counter)\n");
+  printf("      Result should be exception 02, Counter unchanged\n");
+  myClient.Client_PresetSingleRegister(5, 20, 0, &myFrame);
+  CheckException(MDB_EXCEPTION_ILLEGAL_DATA_ADDRESS, "exception of a half 32-bit write");
+  Check(Counter == -3, "value of a variable half written");
+
+  // Read only variable
+  printf("\n  --> Write 0, 100 from address 11 (Temperature, read only)\n");
+  printf("      Result should be exception 02, Temperature unchanged\n");
+  {
+    const unsigned short Values[2] = {0, 100};
+    Check(!Write(11, 2, Values), "write of a read only variable");
+    Check((myFrame.length == 5) && (myFrame.data[2] == MDB_EXCEPTION_ILLEGAL_DATA_ADDRESS), "exception of a read only variable");
+    Check(Temperature == 21.5, "value of a read only variable");
+  }
+
+  // Gaps between items
+  printf("\n  --> Read 3 registers from address 2, then 1 register from address 15\n");
+  printf("      Result should be exception 02 (gaps at 4..9 and 13..19)\n");
+  myClient.Client_ReadHoldingRegisters(5, 2, 3, &myFrame);
+  CheckException(MDB_EXCEPTION_ILLEGAL_DATA_ADDRESS, "exception of a read across a gap");
+  myClient.Client_ReadHoldingRegisters(5, 15, 1, &myFrame);
+  CheckException(MDB_EXCEPTION_ILLEGAL_DATA_ADDRESS, "exception of a read in a gap");
+  printf("\n  --> Write 0x5555, 0x6666, 0x7777 from address 2\n");
+  printf("      Result should be exception 02, nothing written\n");
+  {
+    const unsigned short Values[3] = {0x5555, 0x6666, 0x7777};
+    const unsigned short Block[4] = {0x1111, 0x2222, 0x3333, 0x4444};
+    Check(!Write(2, 3, Values), "write across a gap");
+    Check(Read(0, 4, Block), "block after a write across a gap");
+  }
+
+  printf("\n  --> %d error\n", Errors);
+  return (Errors);
+}
@@ -0,0 +1,180 @@
+/*
+  Modbus_RTU library
+  Example of RTU receiver: frames assembled from timestamped bytes (t1.5 / t3.5 silences)
+  Copyright (C) 2012  Gilles DE VOS
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+  Host program, not a sketch. Build and run on Linux from this directory
+  (Modbus_RTU.cpp includes Arduino.h : an empty Arduino.h is enough on a host):
+
+  g++ -I../.. -I<dir of Arduino.h> Modbus_RTU_Receiver_test.cpp ../../Modbus_RTU.cpp -o Modbus_RTU_Receiver_test
+  ./Modbus_RTU_Receiver_test
+
+  No serial line is used : the bytes are given to the receiver with the time
+  they would be received at 9600 bauds, starting just before the wrap of the
+  time counter. The exit code is the number of errors.
+*/
+
+#include <Modbus_RTU.h>
+#include <stdio.h>
+#include <string.h>
+
+Modbus_RTU myDevice = Modbus_RTU(0);
+Modbus_Receiver myReceiver;
+// Receive buffer of MDB_MSG_LENGTH_MAX bytes, followed by room to observe an overflow
+char myBuffer[MDB_MSG_LENGTH_MAX + 16];
+
+// Reception time of the last byte given to the receiver (us)
+unsigned long Now = (unsigned long)-20000;
+
+int Errors;
+
+// Function to count an error
+void Check(bool Condition, const char* Text)
+{
+  if (!Condition)
+  {
+    Errors++;
+    printf("  Error: %s\n", Text);
+  }
+}
+
+// Function to give bytes to the receiver, received back to back after a silence (us)
+t_status Put(const char* Data, int Length, unsigned long Silence)
+{
+  Now += Silence + Length * myReceiver.CharTime;
+  return (Modbus_ReceiverPut(&myReceiver, Data, Length, Now));
+}
+
+// Function to check that the receiver holds a complete frame, with a correct CRC16
+bool IsFrame(Modbus_Frame* Frame)
+{
+  return ((Modbus_ReceiverPoll(&myReceiver, Now + myReceiver.FrameTimeout + 1) == OK) &&
+          (myReceiver.Frame.length == Frame->length) && (memcmp(myReceiver.Frame.data, Frame->data, Frame->length) == 0) &&
+          (Modbus_CRC16Final(&myReceiver.Context) == 0));
+}
+
+int main(void)
+{
+  Modbus_Frame Request;
+  Modbus_Frame Next;
+  unsigned short Errors0;
+  int i;
+
+  myDevice.SetBaudrate(MDB_BAUD_9600);
+  myDevice.ReceiverInit(&myReceiver, myBuffer, MDB_MSG_LENGTH_MAX);
+  myDevice.SetType(MDB_CLIENT);
+  myDevice.Client_ReadHoldingRegisters(5, 10, 4, &Request);
+  myDevice.Client_ReadInputRegisters(6, 20, 2, &Next);
+
+  printf("\nTest Modbus_RTU library\n");
+  printf("=======================\n");
+  printf("\n   Test RTU receiver: char time %lu us, t1.5 %lu us, t3.5 %lu us\n",
+         myReceiver.CharTime, myReceiver.CharTimeout, myReceiver.FrameTimeout);
+  printf("   ----------------------------------------------------------------\n");
+
+  // Frame received byte by byte
+  printf("\n  --> Request received byte by byte, t1.5 between the last 2 bytes\n");
+  printf("      Result should be the request after a t3.5 silence only\n");
+  for (i = 0; i < Request.length; i++)
+  {
+    Check(Put(&Request.data[i], 1, (i == Request.length - 1) ? myReceiver.CharTimeout : 0) == OK, "byte taken");
+  }
+  Check(Modbus_ReceiverPoll(&myReceiver, Now + myReceiver.FrameTimeout) == NOK, "frame before the end of t3.5");
+  Check(IsFrame(&Request), "frame after t3.5");
+
+  // Frame kept until it is released
+  printf("\n  --> Next request given before the first one is released\n");
+  printf("      Result should be NOK until the release, the first request unchanged\n");
+  Check(Put(Next.data, Next.length, myReceiver.FrameTimeout + 1) == NOK, "bytes given to a complete frame");
+  Check(IsFrame(&Request), "complete frame after NOK");
+  Check(Modbus_ReceiverPut(&myReceiver, Next.data, Next.length, Now) == NOK, "bytes given again to a complete frame");
+  Modbus_ReceiverRelease(&myReceiver);
+  Check(Modbus_ReceiverPut(&myReceiver, Next.data, Next.length, Now) == OK, "bytes given after the release");
+  Check(IsFrame(&Next), "next frame");
+  Modbus_ReceiverRelease(&myReceiver);
+
+  // Back to back frames
+  printf("\n  --> 2 requests in chunks, separated by t3.5 + 1 us only\n");
+  printf("      Result should be 2 frames, the second one taken once the first one is released\n");
+  Check(Put(Request.data, 3, myReceiver.FrameTimeout + 1) == OK, "first chunk of the first frame");
+  Check(Put(&Request.data[3], Request.length - 3, 0) == OK, "second chunk of the first frame");
+  Check(Put(Next.data, Next.length, myReceiver.FrameTimeout + 1) == NOK, "second frame before the release");
+  Check(IsFrame(&Request), "first of back to back frames");
+  Modbus_ReceiverRelease(&myReceiver);
+  Check(Modbus_ReceiverPut(&myReceiver, Next.data, Next.length, Now) == OK, "second frame after the release");
+  Check(IsFrame(&Next), "second of back to back frames");
+  Modbus_ReceiverRelease(&myReceiver);
+
+  // Silence violation
+  printf("\n  --> Request with a silence of t1.5 + 1 us, then a request after t3.5\n");
+  printf("      Result should be the first request discarded, the second one received\n");
+  Errors0 = myReceiver.Errors;
+  Check(Put(Request.data, 4, myReceiver.FrameTimeout + 1) == OK, "first part of a frame");
+  Check(Put(&Request.data[4], Request.length - 4, myReceiver.CharTimeout + 1) == OK, "bytes after a t1.5 violation");
+  Check(myReceiver.Errors == Errors0 + 1, "error count of a t1.5 violation");
+  Check(Modbus_ReceiverPoll(&myReceiver, Now + myReceiver.FrameTimeout + 1) == NOK, "frame with a t1.5 violation");
+  Check(Put(Next.data, Next.length, myReceiver.FrameTimeout + 1) == OK, "frame after a t1.5 violation");
+  Check(IsFrame(&Next), "frame received after a discarded one");
+  Modbus_ReceiverRelease(&myReceiver);
+
+  // Silence violation, the rest of the frame being received before t3.5
+  printf("\n  --> Silence of t1.5 + 1 us, then bytes separated by less than t3.5\n");
+  printf("      Result should be all bytes discarded up to the next t3.5 silence\n");
+  Check(Put(Request.data, 4, myReceiver.FrameTimeout + 1) == OK, "first part of a frame");
+  Check(Put(&Request.data[4], 2, myReceiver.CharTimeout + 1) == OK, "bytes after a t1.5 violation");
+  Check(Put(Next.data, Next.length, myReceiver.FrameTimeout - 1) == OK, "bytes before the end of t3.5");
+  Check(Modbus_ReceiverPoll(&myReceiver, Now + myReceiver.FrameTimeout + 1) == NOK, "bytes received during t3.5");
+
+  // Frame too short
+  printf("\n  --> Frame of %d bytes, then a request after t3.5\n", MDB_MSG_LENGTH_MIN - 1);
+  printf("      Result should be the short frame discarded, the request received\n");
+  Errors0 = myReceiver.Errors;
+  Check(Put(Request.data, MDB_MSG_LENGTH_MIN - 1, myReceiver.FrameTimeout + 1) == OK, "short frame");
+  Check(Modbus_ReceiverPoll(&myReceiver, Now + myReceiver.FrameTimeout + 1) == NOK, "short frame after t3.5");
+  Check(myReceiver.Errors == Errors0 + 1, "error count of a short frame");
+  Check(Put(Next.data, Next.length, myReceiver.FrameTimeout + 1) == OK, "frame after a short frame");
+  Check(IsFrame(&Next), "frame received after a short frame");
+  Modbus_ReceiverRelease(&myReceiver);
+
+  // Short frame followed by a request, without polling the receiver meanwhile
+  printf("\n  --> Frame of %d bytes followed by a request after t3.5, no poll between them\n", MDB_MSG_LENGTH_MIN - 1);
+  printf("      Result should be the request received\n");
+  Check(Put(Request.data, MDB_MSG_LENGTH_MIN - 1, myReceiver.FrameTimeout + 1) == OK, "short frame");
+  Check(Put(Next.data, Next.length, myReceiver.FrameTimeout + 1) == OK, "frame after a short frame not polled");
+  Check(IsFrame(&Next), "frame received after a short frame not polled");
+  Modbus_ReceiverRelease(&myReceiver);
+
+  // Buffer overflow
+  printf("\n  --> %d bytes received back to back, then a request after t3.5\n", MDB_MSG_LENGTH_MAX + 10);
+  printf("      Result should be the long frame discarded, the request received\n");
+  Errors0 = myReceiver.Errors;
+  Check(Put(Request.data, Request.length, myReceiver.FrameTimeout + 1) == OK, "first bytes of a long frame");
+  for (i = Request.length; i < MDB_MSG_LENGTH_MAX + 10; i += 2)
+  {
+    Check(Put(Next.data, 2, 0) == OK, "bytes of a long frame");
+  }
+  Check(myReceiver.Errors == Errors0 + 1, "error count of an overflow");
+  Check(Modbus_ReceiverPoll(&myReceiver, Now + myReceiver.FrameTimeout + 1) == NOK, "long frame after t3.5");
+  Check(Put(Next.data, Next.length, myReceiver.FrameTimeout + 1) == OK, "frame after an overflow");
+  Check(IsFrame(&Next), "frame received after an overflow");
+  Modbus_ReceiverRelease(&myReceiver);
+
+  printf("\n  --> %d error\n", Errors);
+  return (Errors);
+}
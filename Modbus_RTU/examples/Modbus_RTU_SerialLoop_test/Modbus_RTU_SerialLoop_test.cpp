@@ -0,0 +1,272 @@
+/*
+  Modbus_RTU library
+  Example of multi-port server loop (Linux): several servers on pseudo terminals
+  Copyright (C) 2012  Gilles DE VOS
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+  Host program, not a sketch. Build and run on Linux from this directory
+  (Modbus_RTU.cpp includes Arduino.h : an empty Arduino.h is enough on a host):
+
+  g++ -O2 -I../.. -I<dir of Arduino.h> Modbus_RTU_SerialLoop_test.cpp ../../Modbus_RTU.cpp
+      ../../Modbus_RTU_Serial.cpp -o Modbus_RTU_SerialLoop_test -lutil
+  ./Modbus_RTU_SerialLoop_test [number of polls of the benchmark]
+
+  Each server uses the slave side of a pseudo terminal, its client writes the
+  requests on the master side. The loop and the clients run in the same thread :
+  the loop is updated while the clients wait for their responses.
+  The exit code is the number of errors.
+*/
+
+#include <Modbus_RTU_Serial.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pty.h>
+
+#define NB_PORTS      4       // Number of ports of the loop
+#define NB_POLLS      1000    // Default number of polls of each port in the benchmark
+#define NB_OVERRUN    20000   // Max number of requests sent to fill a tty
+
+// Server of each port (unit 1 + index) with 200 holding registers
+Modbus_RTU myServers[NB_PORTS] = {Modbus_RTU(MDB_SERVER), Modbus_RTU(MDB_SERVER), Modbus_RTU(MDB_SERVER), Modbus_RTU(MDB_SERVER)};
+unsigned short myRegisters[NB_PORTS][200];
+
+Modbus_RTU myClient = Modbus_RTU(0);
+Modbus_SerialLoopPort myPorts[NB_PORTS];
+Modbus_SerialLoop myLoop;
+int myMasters[NB_PORTS];
+
+int Errors;
+
+// Function to count an error
+void Check(bool Condition, const char* Text)
+{
+  if (!Condition)
+  {
+    Errors++;
+    printf("  Error: %s\n", Text);
+  }
+}
+
+// Function to write a request on the master side of a port
+void Send(int Index, Modbus_Frame* Frame)
+{
+  Check(write(myMasters[Index], Frame->data, Frame->length) == Frame->length, "write of a request");
+}
+
+// Function to read the bytes received by the clients of all ports, the loop being updated meanwhile
+// Returns when Length bytes are received on each port, or after Loops updates without any byte
+void Receive(char Buffer[NB_PORTS][MDB_MSG_LENGTH_MAX], int Received[NB_PORTS], int Length, int Loops)
+{
+  bool Done = false;
+  int Idle;
+  int n;
+  int i;
+
+  for (i = 0; i < NB_PORTS; i++)
+  {
+    Received[i] = 0;
+  }
+  for (Idle = 0; (Idle < Loops) && !Done; Idle++)
+  {
+    Modbus_SerialLoopUpdate(&myLoop, 10);
+    Done = true;
+    for (i = 0; i < NB_PORTS; i++)
+    {
+      n = read(myMasters[i], &Buffer[i][Received[i]], MDB_MSG_LENGTH_MAX - Received[i]);
+      if (n > 0)
+      {
+        Received[i] += n;
+        Idle = 0;
+      }
+      Done = Done && (Received[i] >= Length);
+    }
+  }
+}
+
+unsigned short GetWord(const char* Buffer)
+{
+  return ((unsigned short)((unsigned char)Buffer[0] << 8 | (unsigned char)Buffer[1]));
+}
+
+int main(int argc, char* argv[])
+{
+  char Response[NB_PORTS][MDB_MSG_LENGTH_MAX];
+  int Received[NB_PORTS];
+  Modbus_Frame myFrame;
+  unsigned short CRC16;
+  unsigned long Requests;
+  unsigned long Time;
+  long Total;
+  long Polls = (argc > 1) ? atol(argv[1]) : NB_POLLS;
+  int Slave;
+  int n;
+  int i;
+  long j;
+
+  // One pseudo terminal per port
+  for (i = 0; i < NB_PORTS; i++)
+  {
+    for (j = 0; j < 200; j++)
+    {
+      myRegisters[i][j] = (i << 12) + j;
+    }
+    myServers[i].Server_SetAddress(1 + i);
+    myServers[i].Server_SetHoldingRegisters(myRegisters[i], 0, 200);
+    myServers[i].SetBaudrate(MDB_BAUD_38400);
+    myServers[i].SetParity(MDB_PARITY_NONE);
+    if ((openpty(&myMasters[i], &Slave, 0, 0, 0) != 0)
+        || (Modbus_SerialAttach(&myPorts[i].Serial, &myServers[i], Slave, 0) != OK))
+    {
+      printf("pseudo terminal %d failed\n", i);
+      return (1);
+    }
+    fcntl(myMasters[i], F_SETFL, fcntl(myMasters[i], F_GETFL) | O_NONBLOCK);
+    myPorts[i].Server = &myServers[i];
+  }
+  if (Modbus_SerialLoopInit(&myLoop, myPorts, NB_PORTS) != OK)
+  {
+    printf("Modbus_SerialLoopInit failed\n");
+    return (1);
+  }
+  myClient.SetType(MDB_CLIENT);
+
+  printf("\nTest Modbus_RTU library\n");
+  printf("=======================\n");
+  printf("\n   Test multi-port server loop: %d servers on pseudo terminals\n", NB_PORTS);
+  printf("   ----------------------------------------------------------\n");
+
+  // One request on each port at the same time
+  printf("\n  --> Read 4 registers from address 10 on each port at once\n");
+  printf("      Result should be 0xP00A, 0xP00B, 0xP00C, 0xP00D on port P\n");
+  for (i = 0; i < NB_PORTS; i++)
+  {
+    myClient.Client_ReadHoldingRegisters(1 + i, 10, 4, &myFrame);
+    Send(i, &myFrame);
+  }
+  Receive(Response, Received, 3 + 8 + 2, 100);
+  for (i = 0; i < NB_PORTS; i++)
+  {
+    Check((Received[i] == 3 + 8 + 2) && (Response[i][0] == 1 + i) && (Response[i][1] == MDB_FC03), "response of each port");
+    Check((GetWord(&Response[i][3]) == (i << 12) + 10) && (GetWord(&Response[i][9]) == (i << 12) + 13), "values of each port");
+    Check(myPorts[i].Requests == 1, "number of answered requests of each port");
+  }
+
+  // Request to another unit : no response on the port
+  printf("\n  --> Read 1 register of unit 9 on port 0\n");
+  printf("      Result should be no response\n");
+  myClient.Client_ReadHoldingRegisters(9, 0, 1, &myFrame);
+  Send(0, &myFrame);
+  Receive(Response, Received, 1, 10);
+  Check(Received[0] == 0, "response of an unknown unit");
+  Check(myPorts[0].Requests == 1, "number of answered requests of an unknown unit");
+
+  // Broadcast write : served on each port, never answered nor queued
+  printf("\n  --> Write 0x4242 in register 0 of all units (broadcast) on each port, then read it\n");
+  printf("      Result should be no response, then 0x4242 on each port\n");
+  myClient.Client_PresetSingleRegister(MDB_ADDRESS_BROADCAST, 0, 0x4242, &myFrame);
+  for (i = 0; i < NB_PORTS; i++)
+  {
+    Send(i, &myFrame);
+  }
+  Receive(Response, Received, 1, 10);
+  for (i = 0; i < NB_PORTS; i++)
+  {
+    Check((Received[i] == 0) && (myPorts[i].QueueLength == 0) && (myPorts[i].Requests == 1), "response to a broadcast");
+    myClient.Client_ReadHoldingRegisters(1 + i, 0, 1, &myFrame);
+    Send(i, &myFrame);
+  }
+  Receive(Response, Received, 3 + 2 + 2, 100);
+  for (i = 0; i < NB_PORTS; i++)
+  {
+    Check((Received[i] == 3 + 2 + 2) && (GetWord(&Response[i][3]) == 0x4242), "register written by a broadcast");
+  }
+
+  // Tty not read by the client : the responses stay in the queue, then are dropped
+  printf("\n  --> Read 125 registers on port 1 until its tty and its queue are full, then read all responses\n");
+  printf("      Result should be overruns, and every response queued received whole\n");
+  myClient.Client_ReadHoldingRegisters(2, 0, 125, &myFrame);
+  Requests = myPorts[1].Requests;
+  for (j = 0; (j < NB_OVERRUN) && (myPorts[1].Overruns == 0); j++)
+  {
+    Send(1, &myFrame);
+    // Request answered (or dropped) once the silence after it has elapsed
+    for (n = 0; (n < 100) && (myPorts[1].Requests + myPorts[1].Overruns == Requests + j); n++)
+    {
+      Modbus_SerialLoopUpdate(&myLoop, 10);
+    }
+  }
+  Check(myPorts[1].Overruns > 0, "overrun of a full queue");
+  Check(myPorts[1].QueueLength > 0, "responses waiting in the queue");
+  Requests = myPorts[1].Requests - Requests;
+  Total = 0;
+  do
+  {
+    Receive(Response, Received, MDB_MSG_LENGTH_MAX, 1);
+    Total += Received[1];
+    if ((Received[1] >= 5) && (Total == Received[1]))
+    {
+      myFrame.length = 3 + 250 + 2;
+      memcpy(myFrame.data, Response[1], myFrame.length);
+      Check(myServers[1].GetCRC16(&myFrame, &CRC16) && (CRC16 == GetWord(&myFrame.data[myFrame.length - 2])), "CRC16 of the first response");
+      Check((Response[1][0] == 2) && (Response[1][2] == (char)250) && (GetWord(&Response[1][3]) == 0x4242), "first response");
+    }
+  } while ((Received[1] > 0) || (myPorts[1].QueueLength > 0));
+  printf("      %lu responses queued (%ld bytes), %lu dropped\n", Requests, Total, myPorts[1].Overruns);
+  Check(Total == (long)Requests * (3 + 250 + 2), "bytes of the queued responses");
+
+  // Port served again once its tty has been read
+  printf("\n  --> Read 4 registers from address 10 on port 1\n");
+  printf("      Result should be 0x100A, 0x100B, 0x100C, 0x100D\n");
+  myClient.Client_ReadHoldingRegisters(2, 10, 4, &myFrame);
+  Send(1, &myFrame);
+  Receive(Response, Received, 3 + 8 + 2, 100);
+  Check((Received[1] == 3 + 8 + 2) && (GetWord(&Response[1][3]) == 0x100A) && (GetWord(&Response[1][9]) == 0x100D), "response after an overrun");
+
+  // Benchmark : all ports polled at the same time
+  printf("\n  --> %ld polls of 10 registers on each port at once\n", Polls);
+  printf("      Result should be all responses received\n");
+  Total = 0;
+  Time = Modbus_SerialTime();
+  for (j = 0; j < Polls; j++)
+  {
+    for (i = 0; i < NB_PORTS; i++)
+    {
+      myClient.Client_ReadHoldingRegisters(1 + i, 20, 10, &myFrame);
+      Send(i, &myFrame);
+    }
+    Receive(Response, Received, 3 + 20 + 2, 100);
+    for (i = 0; i < NB_PORTS; i++)
+    {
+      Total += (Received[i] == 3 + 20 + 2) && (GetWord(&Response[i][3]) == (i << 12) + 20);
+    }
+  }
+  Time = Modbus_SerialTime() - Time;
+  Check(Total == Polls * NB_PORTS, "responses of the benchmark");
+  printf("      %ld responses in %lu ms : %.0f requests/s\n", Total, Time / 1000, Time ? Total * 1e6 / Time : 0.0);
+
+  Modbus_SerialLoopClose(&myLoop);
+  for (i = 0; i < NB_PORTS; i++)
+  {
+    close(myMasters[i]);
+  }
+  printf("\n  --> %d error\n", Errors);
+  return (Errors);
+}
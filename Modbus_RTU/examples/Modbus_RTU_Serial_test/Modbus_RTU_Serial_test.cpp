@@ -0,0 +1,175 @@
+/*
+  Modbus_RTU library
+  Example of serial transport (Linux): client and server on a pseudo terminal
+  Copyright (C) 2012  Gilles DE VOS
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+  Host program, not a sketch. Build and run on Linux from this directory
+  (Modbus_RTU.cpp includes Arduino.h : an empty Arduino.h is enough on a host):
+
+  g++ -I../.. -I<dir of Arduino.h> Modbus_RTU_Serial_test.cpp ../../Modbus_RTU.cpp
+      ../../Modbus_RTU_Serial.cpp -o Modbus_RTU_Serial_test -lutil
+  ./Modbus_RTU_Serial_test
+
+  The client uses the master side of the pseudo terminal, the server (unit 17)
+  runs in a child process on the slave side. The exit code is the number of errors.
+*/
+
+#include <Modbus_RTU_Serial.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <pty.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+// Server of the serial line (unit 17) with 200 holding registers
+Modbus_RTU myServer = Modbus_RTU(MDB_SERVER);
+unsigned short myRegisters[200];
+
+Modbus_RTU myClient = Modbus_RTU(0);
+Modbus_Serial myPort;
+
+int Errors;
+
+// Function to count an error
+void Check(bool Condition, const char* Text)
+{
+  if (!Condition)
+  {
+    Errors++;
+    printf("  Error: %s\n", Text);
+  }
+}
+
+// Function to get a register of the data received (one byte per item)
+unsigned short GetRegister(Modbus_Data* Data, int Index)
+{
+  return ((unsigned short)((Data->data[2 * Index] & 0xFF) << 8 | (Data->data[2 * Index + 1] & 0xFF)));
+}
+
+int main(void)
+{
+  Modbus_Frame myFrame;
+  Modbus_Data myData;
+  unsigned short Values[100];
+  Modbus_Serial ServerPort;
+  unsigned long Time;
+  t_status Status;
+  pid_t Server;
+  int Master;
+  int Slave;
+  int i;
+
+  for (i = 0; i < 200; i++)
+  {
+    myRegisters[i] = 0x1000 + i;
+  }
+  if (openpty(&Master, &Slave, 0, 0, 0) != 0)
+  {
+    printf("openpty failed\n");
+    return (1);
+  }
+
+  // Server on the slave side (child process)
+  Server = fork();
+  if (Server == 0)
+  {
+    close(Master);
+    myServer.Server_SetAddress(17);
+    myServer.Server_SetHoldingRegisters(myRegisters, 0, 200);
+    myServer.SetBaudrate(MDB_BAUD_38400);
+    myServer.SetParity(MDB_PARITY_NONE);
+    if (Modbus_SerialAttach(&ServerPort, &myServer, Slave, 0) != OK)
+    {
+      _exit(1);
+    }
+    while (1)
+    {
+      Modbus_SerialServer(&ServerPort, &myServer, -1);
+    }
+  }
+  close(Slave);
+
+  // Client on the master side
+  myClient.SetType(MDB_CLIENT);
+  myClient.SetBaudrate(MDB_BAUD_38400);
+  myClient.SetParity(MDB_PARITY_NONE);
+  if (Modbus_SerialAttach(&myPort, &myClient, Master, 0) != OK)
+  {
+    printf("Modbus_SerialAttach failed\n");
+    return (1);
+  }
+
+  printf("\nTest Modbus_RTU library\n");
+  printf("=======================\n");
+  printf("\n   Test serial transport: client and server on a pseudo terminal\n");
+  printf("   -------------------------------------------------------------\n");
+
+  // Normal response
+  printf("\n  --> Read 4 registers from address 10 of unit 17\n");
+  printf("      Result should be 0x100A, 0x100B, 0x100C, 0x100D\n");
+  myClient.Client_ReadHoldingRegisters(17, 10, 4, &myFrame);
+  Status = Modbus_SerialClient(&myPort, &myClient, &myFrame, &myData, 200);
+  Check(Status == OK, "status of a normal response");
+  Check((myData.length == 4) && (GetRegister(&myData, 0) == 0x100A) && (GetRegister(&myData, 3) == 0x100D), "values of a normal response");
+
+  // Response of more than 62 registers : does not fit in Data
+  printf("\n  --> Read 100 registers from address 20 of unit 17, with then without Data\n");
+  printf("      Result should be NOK, then OK and 0x1014 .. 0x1077 decoded by Client_DecodeRegisters\n");
+  myClient.Client_ReadHoldingRegisters(17, 20, 100, &myFrame);
+  Status = Modbus_SerialClient(&myPort, &myClient, &myFrame, &myData, 200);
+  Check((Status == NOK) && (myData.length == 0), "status of a response which does not fit in Data");
+  Status = Modbus_SerialClient(&myPort, &myClient, &myFrame, 0, 200);
+  Check(Status == OK, "status of a response of 100 registers");
+  Check((myClient.Client_DecodeRegisters(&myPort.Receiver.Frame, Values, 100, &myPort.Receiver.Context) == OK) &&
+        (Values[0] == 0x1014) && (Values[99] == 0x1077), "values of a response of 100 registers");
+
+  // Exception response
+  printf("\n  --> Read 10 registers from address 250 of unit 17\n");
+  printf("      Result should be an exception response 0x83 02\n");
+  myClient.Client_ReadHoldingRegisters(17, 250, 10, &myFrame);
+  Status = Modbus_SerialClient(&myPort, &myClient, &myFrame, &myData, 200);
+  Check(Status == OK, "status of an exception response");
+  Check(((unsigned char)myPort.Receiver.Frame.data[1] == (MDB_FC03 | MDB_EXCEPTION_MASK)) && (myPort.Receiver.Frame.data[2] == 2), "exception response");
+
+  // No server
+  printf("\n  --> Read 1 register of unit 18 (no server), timeout 100 ms\n");
+  printf("      Result should be NOK after 100 ms\n");
+  myClient.Client_ReadHoldingRegisters(18, 0, 1, &myFrame);
+  Time = Modbus_SerialTime();
+  Status = Modbus_SerialClient(&myPort, &myClient, &myFrame, &myData, 100);
+  Time = Modbus_SerialTime() - Time;
+  Check(Status == NOK, "status of a timeout");
+  Check((Time >= 90000) && (Time < 1000000), "duration of a timeout");
+
+  // Broadcast write : no response, but the register is written
+  printf("\n  --> Write 0x4242 in register 0 of all units (broadcast), then read it from unit 17\n");
+  printf("      Result should be no response, then 0x4242\n");
+  myClient.Client_PresetSingleRegister(MDB_ADDRESS_BROADCAST, 0, 0x4242, &myFrame);
+  Check(Modbus_SerialClient(&myPort, &myClient, &myFrame, 0, 200) == OK, "status of a broadcast");
+  Check(Modbus_SerialReceive(&myPort, 100) == NOK, "response to a broadcast");
+  myClient.Client_ReadHoldingRegisters(17, 0, 1, &myFrame);
+  Status = Modbus_SerialClient(&myPort, &myClient, &myFrame, &myData, 200);
+  Check((Status == OK) && (myData.length == 1) && (GetRegister(&myData, 0) == 0x4242), "register written by a broadcast");
+
+  kill(Server, SIGTERM);
+  waitpid(Server, 0, 0);
+  Modbus_SerialClose(&myPort);
+  printf("\n  --> %d error\n", Errors);
+  return (Errors);
+}
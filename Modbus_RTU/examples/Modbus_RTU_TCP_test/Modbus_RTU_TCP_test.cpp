@@ -0,0 +1,259 @@
+/*
+  Modbus_RTU library
+  Example of Modbus TCP server (Linux): MBAP framing and pipelined requests on the loopback
+  Copyright (C) 2012  Gilles DE VOS
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+  Host program, not a sketch. Build and run on Linux from this directory
+  (Modbus_RTU.cpp includes Arduino.h : an empty Arduino.h is enough on a host):
+
+  g++ -I../.. -I<dir of Arduino.h> Modbus_RTU_TCP_test.cpp ../../Modbus_RTU.cpp
+      ../../Modbus_RTU_Serial.cpp ../../Modbus_RTU_TCP.cpp -o Modbus_RTU_TCP_test
+  ./Modbus_RTU_TCP_test
+
+  The server and its clients run in the same thread : the server is updated
+  while the clients wait for their responses. The exit code is the number of errors.
+*/
+
+#include <Modbus_RTU_TCP.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define NB_PIPELINED 50     // Number of requests sent in one write
+
+// Server with 200 holding registers, reachable as unit 7 or 255
+Modbus_RTU myServer = Modbus_RTU(MDB_SERVER);
+Modbus_RTU myClient = Modbus_RTU(0);
+unsigned short myRegisters[200];
+Modbus_CacheEntry myCache[4];
+
+Modbus_TCPConnection myConnections[4];
+Modbus_TCPServer myTcp;
+
+int Errors;
+
+// Function to connect a client to the server on the loopback
+int Connect(unsigned short Port)
+{
+  int fd;
+  struct sockaddr_in Address;
+
+  fd = socket(AF_INET, SOCK_STREAM, 0);
+  memset(&Address, 0, sizeof(Address));
+  Address.sin_family = AF_INET;
+  Address.sin_port = htons(Port);
+  Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if ((fd >= 0) && (connect(fd, (struct sockaddr*)&Address, sizeof(Address)) != 0))
+  {
+    close(fd);
+    fd = -1;
+  }
+  return (fd);
+}
+
+// Function to build a Modbus TCP request (MBAP header + PDU)
+int BuildRequest(char* Buffer, unsigned short Transaction, unsigned char Unit, const char* Pdu, int Length)
+{
+  Buffer[0] = Transaction >> 8;
+  Buffer[1] = Transaction & 0xFF;
+  Buffer[2] = 0;                        // Protocol identifier
+  Buffer[3] = 0;
+  Buffer[4] = (Length + 1) >> 8;        // Length of the unit identifier and the PDU
+  Buffer[5] = (Length + 1) & 0xFF;
+  Buffer[6] = Unit;
+  memcpy(&Buffer[7], Pdu, Length);
+  return (7 + Length);
+}
+
+// Function to read the bytes received by a client, the server being updated meanwhile
+// Returns the number of bytes received, -1 if the connection was closed by the server
+int Receive(int fd, char* Buffer, int Length)
+{
+  int Received = 0;
+  int Loops;
+  int n;
+
+  for (Loops = 0; (Loops < 200) && (Received < Length); Loops++)
+  {
+    Modbus_TCPUpdate(&myTcp, 10);
+    n = recv(fd, &Buffer[Received], Length - Received, MSG_DONTWAIT);
+    if (n == 0)
+    {
+      return (-1);
+    }
+    if (n > 0)
+    {
+      Received += n;
+    }
+  }
+  return (Received);
+}
+
+// Function to count an error
+void Check(bool Condition, const char* Text)
+{
+  if (!Condition)
+  {
+    Errors++;
+    printf("  Error: %s\n", Text);
+  }
+}
+
+// Function to write a request (or a part of it) on a client connection
+void Send(int fd, const char* Buffer, int Length)
+{
+  Check(write(fd, Buffer, Length) == Length, "write of a request");
+}
+
+unsigned short GetWord(const char* Buffer)
+{
+  return ((unsigned short)((unsigned char)Buffer[0] << 8 | (unsigned char)Buffer[1]));
+}
+
+int main(void)
+{
+  Modbus_Frame myFrame;
+  unsigned short CRC16;
+  char Request[NB_PIPELINED * 12];
+  char Response[NB_PIPELINED * 13];
+  int Length;
+  int fd;
+  int i;
+
+  for (i = 0; i < 200; i++)
+  {
+    myRegisters[i] = 0x1000 + i;
+  }
+  myServer.Server_SetAddress(7);
+  myServer.Server_SetHoldingRegisters(myRegisters, 0, 200);
+  myServer.Server_SetCache(myCache, 4);
+  myClient.SetType(MDB_CLIENT);
+
+  // Listen on a free port of the loopback
+  if (Modbus_TCPOpen(&myTcp, &myServer, "127.0.0.1", 0, myConnections, 4) != OK)
+  {
+    printf("Modbus_TCPOpen failed\n");
+    return (1);
+  }
+  fd = Connect(myTcp.Port);
+  if (fd < 0)
+  {
+    printf("connect failed\n");
+    return (1);
+  }
+
+  printf("\nTest Modbus_RTU library\n");
+  printf("=======================\n");
+  printf("\n   Test Modbus TCP server: MBAP framing and pipelined requests\n");
+  printf("   -----------------------------------------------------------\n");
+
+  // MBAP framing: the PDU of the response is the one of the RTU response
+  printf("\n  --> Read 125 registers from address 10 (unit 7, transaction 0x1234)\n");
+  printf("      Response should be the RTU response in an MBAP header\n");
+  myClient.Client_ReadHoldingRegisters(7, 10, 125, &myFrame);
+  Length = BuildRequest(Request, 0x1234, 7, &myFrame.data[1], myFrame.length - 3);
+  Send(fd, Request, Length);
+  Length = Receive(fd, Response, 7 + 2 + 250);
+  myServer.Server_Update(&myFrame);
+  Check(Length == 7 + 2 + 250, "length of the response");
+  Check(GetWord(&Response[0]) == 0x1234, "transaction identifier");
+  Check(GetWord(&Response[2]) == 0, "protocol identifier");
+  Check(GetWord(&Response[4]) == 1 + 2 + 250, "length field");
+  Check(Response[6] == 7, "unit identifier");
+  Check(memcmp(&Response[7], &myFrame.data[1], myFrame.length - 3) == 0, "PDU of the response");
+  Check(myServer.GetCRC16(&myFrame, &CRC16) && (CRC16 == GetWord(&myFrame.data[myFrame.length - 2])), "CRC16 of the RTU response");
+
+  // MBAP header received in several parts
+  printf("\n  --> Same request written in 3 parts (header split)\n");
+  printf("      Response should be the same\n");
+  myClient.Client_ReadHoldingRegisters(7, 10, 125, &myFrame);
+  Length = BuildRequest(Request, 0x1235, 7, &myFrame.data[1], myFrame.length - 3);
+  Send(fd, Request, 3);
+  Check(Receive(fd, Response, 1) == 0, "response to an incomplete header");
+  Send(fd, &Request[3], 5);
+  Check(Receive(fd, Response, 1) == 0, "response to an incomplete PDU");
+  Send(fd, &Request[8], Length - 8);
+  Length = Receive(fd, Response, 7 + 2 + 250);
+  Check((Length == 7 + 2 + 250) && (GetWord(&Response[0]) == 0x1235), "response to a split request");
+  Check((GetWord(&Response[9]) == 0x100A) && (GetWord(&Response[257]) == 0x1086), "values of a split request");
+
+  // Pipelined requests: all written at once, answered in order
+  printf("\n  --> %d requests of 2 registers in one write (unit 255)\n", NB_PIPELINED);
+  printf("      Responses should come in order of the requests\n");
+  Length = 0;
+  for (i = 0; i < NB_PIPELINED; i++)
+  {
+    char Pdu[5] = {MDB_FC03, 0, (char)i, 0, 2};
+    Length += BuildRequest(&Request[Length], 1000 + i, 255, Pdu, 5);
+  }
+  Send(fd, Request, Length);
+  Length = Receive(fd, Response, NB_PIPELINED * 13);
+  Check(Length == NB_PIPELINED * 13, "number of bytes of the responses");
+  for (i = 0; (i < NB_PIPELINED) && (Length == NB_PIPELINED * 13); i++)
+  {
+    char* p = &Response[i * 13];
+    if ((GetWord(&p[0]) != 1000 + i) || (p[6] != (char)255) || (p[8] != 4) || (GetWord(&p[9]) != myRegisters[i]) || (GetWord(&p[11]) != myRegisters[i + 1]))
+    {
+      Check(false, "pipelined response");
+      break;
+    }
+  }
+
+  // Exceptions
+  printf("\n  --> Unknown unit, unknown function, truncated PDU\n");
+  printf("      Responses should be exceptions 10, 1, 3\n");
+  {
+    char Pdu[5] = {MDB_FC03, 0, 0, 0, 1};
+    Length = BuildRequest(Request, 1, 42, Pdu, 5);
+    Send(fd, Request, Length);
+    Length = Receive(fd, Response, 9);
+    Check((Length == 9) && ((unsigned char)Response[7] == 0x83) && (Response[8] == 10), "exception of an unknown unit");
+
+    Pdu[0] = 0x2B;
+    Length = BuildRequest(Request, 2, 7, Pdu, 1);
+    Send(fd, Request, Length);
+    Length = Receive(fd, Response, 9);
+    Check((Length == 9) && ((unsigned char)Response[7] == 0xAB) && (Response[8] == 1), "exception of an unknown function");
+
+    Pdu[0] = MDB_FC03;
+    Length = BuildRequest(Request, 3, 7, Pdu, 3);
+    Send(fd, Request, Length);
+    Length = Receive(fd, Response, 9);
+    Check((Length == 9) && ((unsigned char)Response[7] == 0x83) && (Response[8] == 3), "exception of a truncated PDU");
+  }
+
+  // Malformed MBAP header
+  printf("\n  --> Protocol identifier 1\n");
+  printf("      Connection should be closed by the server\n");
+  {
+    char Pdu[5] = {MDB_FC03, 0, 0, 0, 1};
+    Length = BuildRequest(Request, 4, 7, Pdu, 5);
+    Request[3] = 1;
+    Send(fd, Request, Length);
+    Check(Receive(fd, Response, 1) == -1, "connection closed");
+  }
+
+  close(fd);
+  Modbus_TCPClose(&myTcp);
+  printf("\n  --> %d error\n", Errors);
+  return (Errors);
+}